@@ -4,6 +4,7 @@
 // TargetApp.cpp : Example application which will be debuggeed
 
 #include <iostream>
+#include <vector>
 #include <windows.h>
 
 class MyClass
@@ -35,7 +36,19 @@ int wmain(int argc, WCHAR* argv[])
 
     FILETIME FTZero = {};
 
-    __debugbreak(); // program will stop here. Evaluate one of the local variables (ex: 'creationTime') in the locals or watch window.
+    // A log-sized array of timestamps, one second apart
+    std::vector<FILETIME> logTimes(50000);
+    ULARGE_INTEGER ticks;
+    ticks.LowPart = creationTime.dwLowDateTime;
+    ticks.HighPart = creationTime.dwHighDateTime;
+    for (FILETIME& logTime : logTimes)
+    {
+        logTime.dwLowDateTime = ticks.LowPart;
+        logTime.dwHighDateTime = ticks.HighPart;
+        ticks.QuadPart += 10000000;
+    }
+
+    __debugbreak(); // program will stop here. Evaluate one of the local variables (ex: 'creationTime' or 'logTimes') in the locals or watch window.
     std::cout << "Test complete\n";
 
     return 0;
@@ -0,0 +1,82 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+// CivilTime.cpp : FILETIME to civil date conversion. Uses the days-from-civil algorithm described
+// at http://howardhinnant.github.io/date_algorithms.html. This file doesn't use the precompiled
+// header so that it stays portable.
+
+#include "CivilTime.h"
+#include <string.h>
+
+namespace
+{
+    const uint64_t TicksPerMillisecond = 10000;
+    const uint64_t TicksPerDay = 24ull * 60 * 60 * 1000 * TicksPerMillisecond;
+
+    // 1601-01-01 as a day count relative to 0000-03-01, which is the epoch the algorithm uses
+    const uint32_t FileTimeEpochShift = 584694;
+
+    // Splits a FILETIME into whole days since 1601-01-01 and milliseconds into that day. Both fit
+    // in 32 bits for any ticks below MaxFileTimeTicks.
+    inline void SplitTicks(uint64_t ticks, uint32_t* pDays, uint32_t* pMsOfDay)
+    {
+        *pDays = (uint32_t)(ticks / TicksPerDay);
+        *pMsOfDay = (uint32_t)((ticks % TicksPerDay) / TicksPerMillisecond);
+    }
+
+    void DaysToCivil(uint32_t days, uint32_t msOfDay, CivilTime* pResult)
+    {
+        // 1601-01-01 was a Monday
+        pResult->DayOfWeek = (uint16_t)((days + 1) % 7);
+
+        // FILETIMEs never precede the epoch, so 'z' (and everything derived from it) is unsigned
+        uint32_t z = days + FileTimeEpochShift;
+        uint32_t era = z / 146097;
+        uint32_t doe = z - era * 146097;                                        // [0, 146096]
+        uint32_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;   // [0, 399]
+        uint32_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);                 // [0, 365]
+        uint32_t mp = (5 * doy + 2) / 153;                                      // [0, 11]
+        uint32_t month = mp < 10 ? mp + 3 : mp - 9;
+
+        pResult->Year = (uint16_t)(yoe + era * 400 + (month <= 2 ? 1 : 0));
+        pResult->Month = (uint16_t)month;
+        pResult->Day = (uint16_t)(doy - (153 * mp + 2) / 5 + 1);
+
+        pResult->Hour = (uint16_t)(msOfDay / 3600000);
+        pResult->Minute = (uint16_t)(msOfDay / 60000 % 60);
+        pResult->Second = (uint16_t)(msOfDay / 1000 % 60);
+        pResult->Milliseconds = (uint16_t)(msOfDay % 1000);
+    }
+}
+
+bool FileTimeTicksToCivil(uint64_t ticks, CivilTime* pResult)
+{
+    if (ticks >= MaxFileTimeTicks)
+    {
+        return false;
+    }
+
+    uint32_t days;
+    uint32_t msOfDay;
+    SplitTicks(ticks, &days, &msOfDay);
+    DaysToCivil(days, msOfDay, pResult);
+    return true;
+}
+
+size_t FileTimeTicksToCivil(const uint64_t* pTicks, size_t count, CivilTime* pResults)
+{
+    size_t validCount = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        if (FileTimeTicksToCivil(pTicks[i], &pResults[i]))
+        {
+            validCount++;
+        }
+        else
+        {
+            memset(&pResults[i], 0, sizeof(pResults[i]));
+        }
+    }
+
+    return validCount;
+}
@@ -0,0 +1,34 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+#pragma once
+
+// This file declares an allocation-free replacement for FileTimeToSystemTime. It only depends on
+// the C++ standard library (CivilTime.cpp is built without the precompiled header), so it can
+// also be compiled and checked outside of Windows.
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Broken down UTC time. The fields have the same order and width as SYSTEMTIME.
+struct CivilTime
+{
+    uint16_t Year;
+    uint16_t Month;         // 1 - 12
+    uint16_t DayOfWeek;     // 0 (Sunday) - 6
+    uint16_t Day;           // 1 - 31
+    uint16_t Hour;
+    uint16_t Minute;
+    uint16_t Second;
+    uint16_t Milliseconds;
+};
+
+// Number of 100ns ticks in a FILETIME at which FileTimeToSystemTime starts failing
+const uint64_t MaxFileTimeTicks = 0x8000000000000000ull;
+
+// Converts a FILETIME (100ns ticks since 1601-01-01 UTC) to a civil date and time. Returns false,
+// like FileTimeToSystemTime, if 'ticks' is not below MaxFileTimeTicks.
+bool FileTimeTicksToCivil(uint64_t ticks, CivilTime* pResult);
+
+// Converts 'count' FILETIMEs at once. Entries which cannot be converted are zeroed, so they can
+// be told apart by a Year of 0. Returns the number of entries which were converted.
+size_t FileTimeTicksToCivil(const uint64_t* pTicks, size_t count, CivilTime* pResults);
@@ -0,0 +1,354 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+// DateTimePattern.cpp : Compiles the format pictures described at
+// https://docs.microsoft.com/en-us/windows/win32/intl/day--month--year--and-era-format-pictures and
+// https://docs.microsoft.com/en-us/windows/win32/intl/hour--minute--and-second-format-pictures
+
+#include "stdafx.h"
+#include "DateTimePattern.h"
+
+namespace
+{
+    typedef CAtlMap<LCID, CAutoPtr<DateTimePattern>, CElementTraits<LCID>, CAutoPtrElementTraits<DateTimePattern>> PatternMap;
+
+    // Locales which failed to compile are stored with a null pattern, so they are only tried once
+    CComAutoCriticalSection s_patternsLock;
+    PatternMap s_patterns;
+
+    HRESULT GetLocaleString(LCID locale, LCTYPE type, CString& value)
+    {
+        int cch = GetLocaleInfoW(locale, type, nullptr, 0);
+        if (cch == 0)
+        {
+            return WIN32_LAST_ERROR();
+        }
+
+        LPWSTR pBuffer = value.GetBuffer(cch);
+        cch = GetLocaleInfoW(locale, type, pBuffer, cch);
+        value.ReleaseBuffer();
+        if (cch == 0)
+        {
+            return WIN32_LAST_ERROR();
+        }
+
+        return S_OK;
+    }
+
+    // Appends text to a fixed size buffer, remembering whether it overflowed
+    class BufferWriter
+    {
+    public:
+        BufferWriter(WCHAR* pBuffer, size_t cchBuffer) :
+            m_pBuffer(pBuffer),
+            m_cchBuffer(cchBuffer),
+            m_length(0),
+            m_fOverflow(cchBuffer == 0)
+        {
+        }
+
+        void Append(LPCWSTR text, size_t length)
+        {
+            // Keep one character for the null terminator
+            if (m_fOverflow || length >= m_cchBuffer - m_length)
+            {
+                m_fOverflow = true;
+                return;
+            }
+
+            memcpy(m_pBuffer + m_length, text, length * sizeof(WCHAR));
+            m_length += length;
+        }
+
+        void Append(const CString& text)
+        {
+            Append(text, text.GetLength());
+        }
+
+        void AppendNumber(unsigned int value, unsigned int minDigits)
+        {
+            WCHAR digits[10];
+            size_t count = 0;
+            do
+            {
+                digits[_countof(digits) - 1 - count] = static_cast<WCHAR>(L'0' + value % 10);
+                value /= 10;
+                count++;
+            } while (value != 0 || count < minDigits);
+
+            Append(digits + _countof(digits) - count, count);
+        }
+
+        // Returns the length of the text, or 0 if it didn't fit
+        size_t Finish()
+        {
+            if (m_fOverflow)
+            {
+                return 0;
+            }
+
+            m_pBuffer[m_length] = L'\0';
+            return m_length;
+        }
+
+    private:
+        WCHAR* m_pBuffer;
+        size_t m_cchBuffer;
+        size_t m_length;
+        bool m_fOverflow;
+    };
+}
+
+//static
+const DateTimePattern* DateTimePattern::Get(LCID locale)
+{
+    CComCritSecLock<CComAutoCriticalSection> lock(s_patternsLock);
+
+    const PatternMap::CPair* pPair = s_patterns.Lookup(locale);
+    if (pPair != nullptr)
+    {
+        return pPair->m_value;
+    }
+
+    // Compiling does a few dozen GetLocaleInfoW calls. That only happens once per locale, so it
+    // isn't worth compiling outside of the lock.
+    CAutoPtr<DateTimePattern> pPattern(new (std::nothrow) DateTimePattern());
+    if (pPattern != nullptr && !pPattern->Compile(locale))
+    {
+        pPattern.Free();
+    }
+
+    const DateTimePattern* pResult = pPattern;
+    s_patterns.SetAt(locale, pPattern);
+    return pResult;
+}
+
+bool DateTimePattern::Compile(LCID locale)
+{
+    // Only the Gregorian calendars format years and months as plain numbers
+    DWORD calendarType;
+    if (GetLocaleInfoW(locale, LOCALE_ICALENDARTYPE | LOCALE_RETURN_NUMBER, reinterpret_cast<LPWSTR>(&calendarType), sizeof(calendarType) / sizeof(WCHAR)) == 0 ||
+        (calendarType != CAL_GREGORIAN && calendarType != CAL_GREGORIAN_US))
+    {
+        return false;
+    }
+
+    CString datePicture;
+    CString timePicture;
+    if (FAILED(GetLocaleString(locale, LOCALE_SSHORTDATE, datePicture)) ||
+        FAILED(GetLocaleString(locale, LOCALE_STIMEFORMAT, timePicture)) ||
+        FAILED(GetLocaleString(locale, LOCALE_S1159, m_am)) ||
+        FAILED(GetLocaleString(locale, LOCALE_S2359, m_pm)))
+    {
+        return false;
+    }
+
+    // LOCALE_SDAYNAME1 is Monday, while SYSTEMTIME::wDayOfWeek starts with Sunday
+    for (int i = 0; i < 7; i++)
+    {
+        int nameIndex = (i + 6) % 7;
+        if (FAILED(GetLocaleString(locale, LOCALE_SDAYNAME1 + nameIndex, m_dayNames[i])) ||
+            FAILED(GetLocaleString(locale, LOCALE_SABBREVDAYNAME1 + nameIndex, m_abbrevDayNames[i])))
+        {
+            return false;
+        }
+    }
+
+    for (int i = 0; i < 12; i++)
+    {
+        if (FAILED(GetLocaleString(locale, LOCALE_SMONTHNAME1 + i, m_monthNames[i])) ||
+            FAILED(GetLocaleString(locale, LOCALE_SABBREVMONTHNAME1 + i, m_abbrevMonthNames[i])))
+        {
+            return false;
+        }
+    }
+
+    if (!CompilePicture(datePicture, /*isDate*/true))
+    {
+        return false;
+    }
+
+    AddLiteral(L" ", 1);
+
+    return CompilePicture(timePicture, /*isDate*/false);
+}
+
+bool DateTimePattern::CompilePicture(LPCWSTR picture, bool isDate)
+{
+    bool hasDayOfMonth = false;
+    bool hasMonthName = false;
+
+    const WCHAR* pCurrent = picture;
+    while (*pCurrent != L'\0')
+    {
+        WCHAR ch = *pCurrent;
+
+        // Text in single quotes is copied as is. Two single quotes in a row stand for one.
+        if (ch == L'\'')
+        {
+            pCurrent++;
+            while (*pCurrent != L'\0')
+            {
+                if (*pCurrent == L'\'')
+                {
+                    if (pCurrent[1] != L'\'')
+                    {
+                        pCurrent++;
+                        break;
+                    }
+                    pCurrent++;
+                }
+                AddLiteral(pCurrent, 1);
+                pCurrent++;
+            }
+            continue;
+        }
+
+        bool isField = isDate ?
+            (ch == L'd' || ch == L'M' || ch == L'y' || ch == L'g') :
+            (ch == L'h' || ch == L'H' || ch == L'm' || ch == L's' || ch == L't');
+        if (!isField)
+        {
+            AddLiteral(pCurrent, 1);
+            pCurrent++;
+            continue;
+        }
+
+        size_t count = 0;
+        while (pCurrent[count] == ch)
+        {
+            count++;
+        }
+        pCurrent += count;
+
+        Token token = {};
+        switch (ch)
+        {
+        case L'd':
+            token.Kind = count == 1 ? TokenKind::Day : count == 2 ? TokenKind::Day2 : count == 3 ? TokenKind::DayAbbrev : TokenKind::DayName;
+            hasDayOfMonth |= count <= 2;
+            break;
+        case L'M':
+            token.Kind = count == 1 ? TokenKind::Month : count == 2 ? TokenKind::Month2 : count == 3 ? TokenKind::MonthAbbrev : TokenKind::MonthName;
+            hasMonthName |= count >= 3;
+            break;
+        case L'y':
+            token.Kind = count == 1 ? TokenKind::Year : count == 2 ? TokenKind::Year2 : TokenKind::YearFull;
+            break;
+        case L'h':
+            token.Kind = count == 1 ? TokenKind::Hour12 : TokenKind::Hour12_2;
+            break;
+        case L'H':
+            token.Kind = count == 1 ? TokenKind::Hour24 : TokenKind::Hour24_2;
+            break;
+        case L'm':
+            token.Kind = count == 1 ? TokenKind::Minute : TokenKind::Minute2;
+            break;
+        case L's':
+            token.Kind = count == 1 ? TokenKind::Second : TokenKind::Second2;
+            break;
+        case L't':
+            token.Kind = count == 1 ? TokenKind::AmPmFirstChar : TokenKind::AmPm;
+            break;
+        default:
+            // Eras ('g') are left to GetDateFormatW
+            return false;
+        }
+
+        m_tokens.Add(token);
+    }
+
+    // Some languages use the genitive form of month names when the day is also shown. GetDateFormatW
+    // knows which, so leave those pictures to it.
+    return !(hasDayOfMonth && hasMonthName);
+}
+
+void DateTimePattern::AddLiteral(LPCWSTR text, size_t length)
+{
+    // Merge adjacent literals into one token
+    size_t count = m_tokens.GetCount();
+    if (count != 0 && m_tokens[count - 1].Kind == TokenKind::Literal)
+    {
+        m_tokens[count - 1].LiteralLength += static_cast<UINT32>(length);
+    }
+    else
+    {
+        Token token = {};
+        token.Kind = TokenKind::Literal;
+        token.LiteralStart = static_cast<UINT32>(m_literals.GetLength());
+        token.LiteralLength = static_cast<UINT32>(length);
+        m_tokens.Add(token);
+    }
+
+    m_literals.Append(text, static_cast<int>(length));
+}
+
+size_t DateTimePattern::Format(const SYSTEMTIME& systemTime, _Out_writes_(cchBuffer) WCHAR* pBuffer, size_t cchBuffer) const
+{
+    BufferWriter writer(pBuffer, cchBuffer);
+
+    unsigned int hour12 = systemTime.wHour % 12 == 0 ? 12 : systemTime.wHour % 12;
+    const CString& amPm = systemTime.wHour < 12 ? m_am : m_pm;
+
+    for (size_t i = 0; i < m_tokens.GetCount(); i++)
+    {
+        const Token& token = m_tokens[i];
+        switch (token.Kind)
+        {
+        case TokenKind::Literal:
+            writer.Append(static_cast<LPCWSTR>(m_literals) + token.LiteralStart, token.LiteralLength);
+            break;
+        case TokenKind::Day:
+        case TokenKind::Day2:
+            writer.AppendNumber(systemTime.wDay, token.Kind == TokenKind::Day2 ? 2 : 1);
+            break;
+        case TokenKind::DayAbbrev:
+            writer.Append(m_abbrevDayNames[systemTime.wDayOfWeek % 7]);
+            break;
+        case TokenKind::DayName:
+            writer.Append(m_dayNames[systemTime.wDayOfWeek % 7]);
+            break;
+        case TokenKind::Month:
+        case TokenKind::Month2:
+            writer.AppendNumber(systemTime.wMonth, token.Kind == TokenKind::Month2 ? 2 : 1);
+            break;
+        case TokenKind::MonthAbbrev:
+            writer.Append(m_abbrevMonthNames[(systemTime.wMonth + 11) % 12]);
+            break;
+        case TokenKind::MonthName:
+            writer.Append(m_monthNames[(systemTime.wMonth + 11) % 12]);
+            break;
+        case TokenKind::Year:
+        case TokenKind::Year2:
+            writer.AppendNumber(systemTime.wYear % 100, token.Kind == TokenKind::Year2 ? 2 : 1);
+            break;
+        case TokenKind::YearFull:
+            writer.AppendNumber(systemTime.wYear, 4);
+            break;
+        case TokenKind::Hour12:
+        case TokenKind::Hour12_2:
+            writer.AppendNumber(hour12, token.Kind == TokenKind::Hour12_2 ? 2 : 1);
+            break;
+        case TokenKind::Hour24:
+        case TokenKind::Hour24_2:
+            writer.AppendNumber(systemTime.wHour, token.Kind == TokenKind::Hour24_2 ? 2 : 1);
+            break;
+        case TokenKind::Minute:
+        case TokenKind::Minute2:
+            writer.AppendNumber(systemTime.wMinute, token.Kind == TokenKind::Minute2 ? 2 : 1);
+            break;
+        case TokenKind::Second:
+        case TokenKind::Second2:
+            writer.AppendNumber(systemTime.wSecond, token.Kind == TokenKind::Second2 ? 2 : 1);
+            break;
+        case TokenKind::AmPmFirstChar:
+            writer.Append(amPm, amPm.IsEmpty() ? 0 : 1);
+            break;
+        case TokenKind::AmPm:
+            writer.Append(amPm);
+            break;
+        }
+    }
+
+    return writer.Finish();
+}
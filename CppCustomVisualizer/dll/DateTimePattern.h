@@ -0,0 +1,79 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+#pragma once
+
+// DateTimePattern is a locale's short date and time format pictures (LOCALE_SSHORTDATE and
+// LOCALE_STIMEFORMAT) compiled into a list of field and literal tokens. Formatting with it produces
+// the same text as GetDateFormatW(DATE_SHORTDATE) + ' ' + GetTimeFormatW(0), but doesn't need to
+// look up and parse the pictures for every value.
+class DateTimePattern
+{
+public:
+    // Returns the compiled pattern for 'locale', compiling it the first time that locale is seen.
+    // Compiled patterns live until the dll is unloaded. Returns nullptr if the locale's pictures use
+    // something which is not supported here (ex: a non-Gregorian calendar or genitive month names).
+    // The caller should then fall back to GetDateFormatW/GetTimeFormatW.
+    static const DateTimePattern* Get(LCID locale);
+
+    // Formats 'systemTime' into 'pBuffer' and null terminates it. Returns the number of characters
+    // written, not counting the terminator, or 0 if 'pBuffer' is too small.
+    size_t Format(const SYSTEMTIME& systemTime, _Out_writes_(cchBuffer) WCHAR* pBuffer, size_t cchBuffer) const;
+
+private:
+    struct TokenKind
+    {
+        enum e
+        {
+            Literal,
+            Day,            // d
+            Day2,           // dd
+            DayAbbrev,      // ddd
+            DayName,        // dddd
+            Month,          // M
+            Month2,         // MM
+            MonthAbbrev,    // MMM
+            MonthName,      // MMMM
+            Year,           // y
+            Year2,          // yy
+            YearFull,       // yyyy
+            Hour12,         // h
+            Hour12_2,       // hh
+            Hour24,         // H
+            Hour24_2,       // HH
+            Minute,         // m
+            Minute2,        // mm
+            Second,         // s
+            Second2,        // ss
+            AmPmFirstChar,  // t
+            AmPm            // tt
+        };
+    };
+
+    struct Token
+    {
+        TokenKind::e Kind;
+
+        // Range of m_literals which holds the text of a Literal token
+        UINT32 LiteralStart;
+        UINT32 LiteralLength;
+    };
+
+    DateTimePattern()
+    {
+    }
+
+    bool Compile(LCID locale);
+    bool CompilePicture(LPCWSTR picture, bool isDate);
+    void AddLiteral(LPCWSTR text, size_t length);
+
+    CAtlArray<Token> m_tokens;
+    CString m_literals;
+
+    // Indexed by SYSTEMTIME::wDayOfWeek (0 is Sunday) and SYSTEMTIME::wMonth - 1
+    CString m_dayNames[7];
+    CString m_abbrevDayNames[7];
+    CString m_monthNames[12];
+    CString m_abbrevMonthNames[12];
+    CString m_am;
+    CString m_pm;
+};
@@ -0,0 +1,82 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+#include "stdafx.h"
+#include "DefaultEvaluationDataItem.h"
+
+//static
+HRESULT CDefaultEvaluationDataItem::GetInstance(
+    _In_ DkmInspectionSession* pInspectionSession,
+    _Deref_out_ CDefaultEvaluationDataItem** ppDataItem
+)
+{
+    HRESULT hr;
+
+    // If there is already an associated item, return it.
+    hr = pInspectionSession->GetDataItem(ppDataItem);
+    if (hr == S_OK)
+    {
+        return hr;
+    }
+
+    // Otherwise create a new object
+    CComObject<CDefaultEvaluationDataItem>* pComObject;
+    hr = CComObject<CDefaultEvaluationDataItem>::CreateInstance(&pComObject);
+    if (FAILED(hr))
+    {
+        return hr;
+    }
+    CComPtr<CDefaultEvaluationDataItem> pCreatedInstance(pComObject);
+
+    // Another thread may have associated an item with the session in the meantime. In that case
+    // use theirs.
+    hr = pInspectionSession->SetDataItem(DkmDataCreationDisposition::CreateNew, pCreatedInstance.p);
+    if (FAILED(hr))
+    {
+        return pInspectionSession->GetDataItem(ppDataItem);
+    }
+
+    *ppDataItem = pCreatedInstance.Detach();
+    return S_OK;
+}
+
+HRESULT CDefaultEvaluationDataItem::GetInspectionContext(
+    _In_ DkmInspectionContext* pParentInspectionContext,
+    _Deref_out_opt_ DkmInspectionContext** ppInspectionContext
+)
+{
+    ObjectLock lock(this);
+
+    *ppInspectionContext = nullptr;
+    for (size_t i = 0; i < m_inspectionContexts.GetCount(); i++)
+    {
+        if (m_inspectionContexts[i].Parent == pParentInspectionContext)
+        {
+            return m_inspectionContexts[i].Raw.CopyTo(ppInspectionContext);
+        }
+    }
+
+    return S_FALSE;
+}
+
+void CDefaultEvaluationDataItem::AddInspectionContext(
+    _In_ DkmInspectionContext* pParentInspectionContext,
+    _In_ DkmInspectionContext* pInspectionContext
+)
+{
+    ObjectLock lock(this);
+
+    // If another thread added one first, keep theirs. Either works.
+    for (size_t i = 0; i < m_inspectionContexts.GetCount(); i++)
+    {
+        if (m_inspectionContexts[i].Parent == pParentInspectionContext)
+        {
+            return;
+        }
+    }
+
+    // Holding on to the parent keeps its address from being reused for a different context
+    InspectionContextEntry entry;
+    entry.Parent = pParentInspectionContext;
+    entry.Raw = pInspectionContext;
+    m_inspectionContexts.Add(entry);
+}
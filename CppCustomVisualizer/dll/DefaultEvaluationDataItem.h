@@ -0,0 +1,66 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+#pragma once
+
+// CDefaultEvaluationDataItem remembers, for one DkmInspectionSession, the 'ShowValueRaw' inspection
+// context that UseDefaultEvaluationBehavior created for each parent inspection context, so that it
+// is created once rather than for every FILETIME that is expanded. The evaluation results
+// themselves aren't kept: a value can be edited while the process is stopped, so each expansion
+// evaluates the expression again. The inspection session is closed when the process continues,
+// which throws the contexts away.
+class ATL_NO_VTABLE __declspec(uuid("9f3c6a15-d27e-4b80-8e4a-1c5b7d2e9f06")) CDefaultEvaluationDataItem :
+    public IUnknown,
+    public CComObjectRootEx<CComMultiThreadModel>
+{
+private:
+    struct InspectionContextEntry
+    {
+        CComPtr<DkmInspectionContext> Parent;
+        CComPtr<DkmInspectionContext> Raw;
+    };
+
+    // There are only a few parent contexts per session (ex: one per radix), so this is searched linearly
+    CAtlArray<InspectionContextEntry> m_inspectionContexts;
+
+protected:
+    CDefaultEvaluationDataItem()
+    {
+    }
+    ~CDefaultEvaluationDataItem()
+    {
+    }
+
+public:
+    static HRESULT GetInstance(
+        _In_ DkmInspectionSession* pInspectionSession,
+        _Deref_out_ CDefaultEvaluationDataItem** ppDataItem
+    );
+
+    // Returns S_FALSE if no raw inspection context was added for 'pParentInspectionContext' yet
+    HRESULT GetInspectionContext(
+        _In_ DkmInspectionContext* pParentInspectionContext,
+        _Deref_out_opt_ DkmInspectionContext** ppInspectionContext
+    );
+
+    void AddInspectionContext(
+        _In_ DkmInspectionContext* pParentInspectionContext,
+        _In_ DkmInspectionContext* pInspectionContext
+    );
+
+protected:
+    HRESULT _InternalQueryInterface(REFIID riid, void** ppvObject)
+    {
+        if (ppvObject == NULL)
+            return E_POINTER;
+
+        if (riid == __uuidof(IUnknown))
+        {
+            *ppvObject = static_cast<IUnknown*>(this);
+            AddRef();
+            return S_OK;
+        }
+
+        *ppvObject = NULL;
+        return E_NOINTERFACE;
+    }
+};
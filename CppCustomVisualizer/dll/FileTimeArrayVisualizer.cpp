@@ -0,0 +1,443 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+#include "stdafx.h"
+#include "FileTimeArrayVisualizer.h"
+#include "FileTimeFormat.h"
+#include "MemoryCacheDataItem.h"
+
+//static
+bool CFileTimeArrayVisualizer::IsFileTimeArrayType(_In_opt_ DkmString* pType)
+{
+    static const WCHAR vectorPrefix[] = L"std::vector<_FILETIME,";
+
+    return pType != nullptr && wcsncmp(pType->Value(), vectorPrefix, _countof(vectorPrefix) - 1) == 0;
+}
+
+//static
+HRESULT CFileTimeArrayVisualizer::CreateEvaluationResult(
+    _In_ DkmRootVisualizedExpression* pVisualizedExpression,
+    _Deref_out_ DkmEvaluationResult** ppResultObject
+)
+{
+    HRESULT hr;
+
+    CComObject<CFileTimeArrayVisualizer>* pComObject;
+    hr = CComObject<CFileTimeArrayVisualizer>::CreateInstance(&pComObject);
+    if (FAILED(hr))
+    {
+        return hr;
+    }
+    CComPtr<CFileTimeArrayVisualizer> pArrayVisualizer(pComObject);
+    pArrayVisualizer->m_pVisualizedExpression = pVisualizedExpression;
+
+    // Find the element storage with the same members that the STL's natvis uses. This costs two
+    // evaluations per vector, rather than one per element.
+    bool isPointer = wcschr(pVisualizedExpression->Type()->Value(), '*') != nullptr;
+    LPCWSTR fullName = pVisualizedExpression->FullName()->Value();
+    CString myval2Text;
+    myval2Text.Format(isPointer ? L"(%s)->_Mypair._Myval2" : L"(%s)._Mypair._Myval2", fullName);
+    pArrayVisualizer->m_firstText.Format(L"%s._Myfirst", static_cast<LPCWSTR>(myval2Text));
+
+    CString evalText;
+    evalText.Format(L"(unsigned __int64)%s._Myfirst", static_cast<LPCWSTR>(myval2Text));
+    unsigned long long firstAddress;
+    hr = EvaluateUInt64(pVisualizedExpression, evalText, &firstAddress);
+    if (FAILED(hr))
+    {
+        // Not a layout we recognize, so let the C++ EE visualize it
+        return E_NOTIMPL;
+    }
+
+    evalText.Format(L"%s._Mylast - %s._Myfirst", static_cast<LPCWSTR>(myval2Text), static_cast<LPCWSTR>(myval2Text));
+    unsigned long long count;
+    hr = EvaluateUInt64(pVisualizedExpression, evalText, &count);
+    if (FAILED(hr))
+    {
+        return E_NOTIMPL;
+    }
+
+    pArrayVisualizer->m_firstAddress = firstAddress;
+    pArrayVisualizer->m_count = count > UINT32_MAX ? UINT32_MAX : static_cast<UINT32>(count);
+
+    CString strValue;
+    strValue.Format(L"{ size=%llu }", count);
+
+    CComPtr<DkmString> pValue;
+    hr = DkmString::Create(DkmSourceString(strValue), &pValue);
+    if (FAILED(hr))
+    {
+        return hr;
+    }
+
+    DkmEvaluationResultFlags_t resultFlags = DkmEvaluationResultFlags::ReadOnly;
+    if (pArrayVisualizer->m_count != 0)
+    {
+        resultFlags |= DkmEvaluationResultFlags::Expandable;
+    }
+
+    CComPtr<DkmDataAddress> pAddress;
+    DkmPointerValueHome* pPointerValueHome = DkmPointerValueHome::TryCast(pVisualizedExpression->ValueHome());
+    if (pPointerValueHome != nullptr)
+    {
+        hr = DkmDataAddress::Create(pVisualizedExpression->RuntimeInstance(), pPointerValueHome->Address(), nullptr, &pAddress);
+        if (FAILED(hr))
+        {
+            return hr;
+        }
+    }
+
+    CComPtr<DkmSuccessEvaluationResult> pSuccessEvaluationResult;
+    hr = DkmSuccessEvaluationResult::Create(
+        pVisualizedExpression->InspectionContext(),
+        pVisualizedExpression->StackFrame(),
+        pVisualizedExpression->Name(),
+        pVisualizedExpression->FullName(),
+        resultFlags,
+        pValue,
+        nullptr,
+        pVisualizedExpression->Type(),
+        DkmEvaluationResultCategory::Class,
+        DkmEvaluationResultAccessType::None,
+        DkmEvaluationResultStorageType::None,
+        DkmEvaluationResultTypeModifierFlags::None,
+        pAddress,
+        nullptr,
+        (DkmReadOnlyCollection<DkmModuleInstance*>*)nullptr,
+        DkmDataItem::Null(),
+        &pSuccessEvaluationResult
+    );
+    if (FAILED(hr))
+    {
+        return hr;
+    }
+
+    hr = pVisualizedExpression->SetDataItem(DkmDataCreationDisposition::CreateNew, pArrayVisualizer.p);
+    if (FAILED(hr))
+    {
+        return hr;
+    }
+
+    *ppResultObject = pSuccessEvaluationResult.Detach();
+    return S_OK;
+}
+
+HRESULT CFileTimeArrayVisualizer::GetChildren(
+    _In_ UINT32 InitialRequestSize,
+    _In_ DkmInspectionContext* pInspectionContext,
+    _Out_ DkmArray<DkmChildVisualizedExpression*>* pInitialChildren,
+    _Deref_out_ DkmEvaluationResultEnumContext** ppEnumContext
+)
+{
+    HRESULT hr;
+    pInitialChildren->Members = nullptr;
+    pInitialChildren->Length = 0;
+
+    CComPtr<DkmEvaluationResultEnumContext> pEnumContext;
+    hr = DkmEvaluationResultEnumContext::Create(
+        m_count,
+        m_pVisualizedExpression->StackFrame(),
+        pInspectionContext,
+        this,
+        &pEnumContext);
+    if (FAILED(hr))
+    {
+        return hr;
+    }
+
+    UINT32 initialCount = InitialRequestSize < m_count ? InitialRequestSize : m_count;
+    if (initialCount > 0)
+    {
+        hr = GetItems(m_pVisualizedExpression, pEnumContext, 0, initialCount, pInitialChildren);
+        if (FAILED(hr))
+        {
+            return hr;
+        }
+    }
+
+    *ppEnumContext = pEnumContext.Detach();
+    return S_OK;
+}
+
+HRESULT CFileTimeArrayVisualizer::GetItems(
+    _In_ DkmVisualizedExpression* pVisualizedExpression,
+    _In_ DkmEvaluationResultEnumContext* pEnumContext,
+    _In_ UINT32 StartIndex,
+    _In_ UINT32 Count,
+    _Out_ DkmArray<DkmChildVisualizedExpression*>* pItems
+)
+{
+    HRESULT hr;
+    pItems->Members = nullptr;
+    pItems->Length = 0;
+
+    if (Count == 0 || StartIndex >= m_count || Count > m_count - StartIndex)
+    {
+        return E_INVALIDARG;
+    }
+
+    CAtlArray<ULONGLONG> ticks;
+    CAtlArray<bool> readable;
+    hr = ReadWindow(StartIndex, Count, ticks, readable);
+    if (FAILED(hr))
+    {
+        return hr;
+    }
+
+    CAtlArray<CString> texts;
+    if (!texts.SetCount(Count))
+    {
+        return E_OUTOFMEMORY;
+    }
+    hr = FileTimesToText(ticks.GetData(), Count, texts.GetData());
+    if (FAILED(hr))
+    {
+        return hr;
+    }
+
+    CComPtr<DkmString> pType;
+    hr = DkmString::Create(DkmSourceString(L"_FILETIME"), &pType);
+    if (FAILED(hr))
+    {
+        return hr;
+    }
+
+    CAutoDkmArray<DkmChildVisualizedExpression*> resultValues;
+    hr = DkmAllocArray(Count, &resultValues);
+    if (FAILED(hr))
+    {
+        return hr;
+    }
+
+    for (UINT32 i = 0; i < Count; i++)
+    {
+        LPCWSTR valueText;
+        if (!readable[i])
+        {
+            valueText = L"<Unable to read memory>";
+        }
+        else if (texts[i].IsEmpty())
+        {
+            valueText = L"<Invalid Value>";
+        }
+        else
+        {
+            valueText = texts[i];
+        }
+
+        hr = CreateItem(pVisualizedExpression, pType, StartIndex + i, valueText, &resultValues.Members[i]);
+        if (FAILED(hr))
+        {
+            return hr;
+        }
+    }
+
+    *pItems = resultValues.Detach();
+    return S_OK;
+}
+
+HRESULT CFileTimeArrayVisualizer::ReadWindow(
+    _In_ UINT32 StartIndex,
+    _In_ UINT32 Count,
+    _Out_ CAtlArray<ULONGLONG>& ticks,
+    _Out_ CAtlArray<bool>& readable
+)
+{
+    HRESULT hr;
+
+    if (Count > UINT32_MAX / sizeof(FILETIME))
+    {
+        return E_INVALIDARG;
+    }
+
+    if (!ticks.SetCount(Count) || !readable.SetCount(Count))
+    {
+        return E_OUTOFMEMORY;
+    }
+
+    // A FILETIME is a little endian 64-bit tick count split into two DWORDs, so the elements can
+    // be read straight into the tick array
+    static_assert(sizeof(FILETIME) == sizeof(ULONGLONG), "FILETIME is 64 bits");
+    UINT64 windowAddress = m_firstAddress + static_cast<UINT64>(StartIndex) * sizeof(FILETIME);
+    hr = CMemoryCacheDataItem::ReadMemory(m_pVisualizedExpression, windowAddress, ticks.GetData(), Count * sizeof(FILETIME));
+    if (SUCCEEDED(hr))
+    {
+        for (UINT32 i = 0; i < Count; i++)
+        {
+            readable[i] = true;
+        }
+        return S_OK;
+    }
+
+    // Part of the window isn't readable. The cache remembers which pages failed, so reading the
+    // elements individually doesn't go back to the target for those pages.
+    for (UINT32 i = 0; i < Count; i++)
+    {
+        hr = CMemoryCacheDataItem::ReadMemory(m_pVisualizedExpression, windowAddress + static_cast<UINT64>(i) * sizeof(FILETIME), &ticks[i], sizeof(FILETIME));
+        readable[i] = SUCCEEDED(hr);
+        if (!readable[i])
+        {
+            ticks[i] = 0;
+        }
+    }
+
+    return S_OK;
+}
+
+HRESULT CFileTimeArrayVisualizer::CreateItem(
+    _In_ DkmVisualizedExpression* pParent,
+    _In_ DkmString* pType,
+    _In_ UINT32 index,
+    _In_ LPCWSTR valueText,
+    _Deref_out_ DkmChildVisualizedExpression** ppResult
+)
+{
+    HRESULT hr;
+
+    DkmInspectionContext* pInspectionContext = m_pVisualizedExpression->InspectionContext();
+    UINT64 address = m_firstAddress + static_cast<UINT64>(index) * sizeof(FILETIME);
+
+    CString strName;
+    strName.Format(L"[%u]", index);
+    CComPtr<DkmString> pName;
+    hr = DkmString::Create(DkmSourceString(strName), &pName);
+    if (FAILED(hr))
+    {
+        return hr;
+    }
+
+    // Index the element storage directly so that evaluating the full name doesn't need to call
+    // std::vector::operator[]
+    CString strFullName;
+    strFullName.Format(L"%s[%u]", static_cast<LPCWSTR>(m_firstText), index);
+    CComPtr<DkmString> pFullName;
+    hr = DkmString::Create(DkmSourceString(strFullName), &pFullName);
+    if (FAILED(hr))
+    {
+        return hr;
+    }
+
+    CComPtr<DkmString> pValue;
+    hr = DkmString::Create(DkmSourceString(valueText), &pValue);
+    if (FAILED(hr))
+    {
+        return hr;
+    }
+
+    CComPtr<DkmDataAddress> pAddress;
+    hr = DkmDataAddress::Create(pInspectionContext->RuntimeInstance(), address, nullptr, &pAddress);
+    if (FAILED(hr))
+    {
+        return hr;
+    }
+
+    CComPtr<DkmPointerValueHome> pPointerValueHome;
+    hr = DkmPointerValueHome::Create(address, &pPointerValueHome);
+    if (FAILED(hr))
+    {
+        return hr;
+    }
+
+    // Like the root FILETIME visualization, the element is expanded by the C++ EE (see
+    // UseDefaultEvaluationBehavior) to show the raw fields
+    CComPtr<DkmSuccessEvaluationResult> pEvaluationResult;
+    hr = DkmSuccessEvaluationResult::Create(
+        pInspectionContext,
+        m_pVisualizedExpression->StackFrame(),
+        pName,
+        pFullName,
+        DkmEvaluationResultFlags::Expandable | DkmEvaluationResultFlags::ReadOnly,
+        pValue,
+        nullptr,
+        pType,
+        DkmEvaluationResultCategory::Data,
+        DkmEvaluationResultAccessType::None,
+        DkmEvaluationResultStorageType::None,
+        DkmEvaluationResultTypeModifierFlags::None,
+        pAddress,
+        nullptr,
+        (DkmReadOnlyCollection<DkmModuleInstance*>*)nullptr,
+        DkmDataItem::Null(),
+        &pEvaluationResult
+    );
+    if (FAILED(hr))
+    {
+        return hr;
+    }
+
+    hr = DkmChildVisualizedExpression::Create(
+        pInspectionContext,
+        m_pVisualizedExpression->VisualizerId(),
+        m_pVisualizedExpression->SourceId(),
+        m_pVisualizedExpression->StackFrame(),
+        pPointerValueHome,
+        pEvaluationResult,
+        pParent,
+        index,
+        DkmDataItem::Null(),
+        ppResult
+    );
+
+    return hr;
+}
+
+//static
+HRESULT CFileTimeArrayVisualizer::EvaluateUInt64(
+    _In_ DkmVisualizedExpression* pVisualizedExpression,
+    _In_ LPCWSTR evalText,
+    _Out_ unsigned long long* pResult
+)
+{
+    HRESULT hr;
+    *pResult = 0;
+
+    CComPtr<DkmString> pEvalText;
+    hr = DkmString::Create(DkmSourceString(evalText), &pEvalText);
+    if (FAILED(hr))
+    {
+        return hr;
+    }
+
+    CAutoDkmClosePtr<DkmLanguageExpression> pLanguageExpression;
+    hr = DkmLanguageExpression::Create(
+        pVisualizedExpression->InspectionContext()->Language(),
+        DkmEvaluationFlags::TreatAsExpression,
+        pEvalText,
+        DkmDataItem::Null(),
+        &pLanguageExpression
+    );
+    if (FAILED(hr))
+    {
+        return hr;
+    }
+
+    CComPtr<DkmEvaluationResult> pEvalResult;
+    #pragma warning(suppress : 6387) // 'pLanguageExpression' could be 0
+    hr = pVisualizedExpression->EvaluateExpressionCallback(
+        pVisualizedExpression->InspectionContext(),
+        pLanguageExpression,
+        pVisualizedExpression->StackFrame(),
+        &pEvalResult
+    );
+    if (FAILED(hr))
+    {
+        return hr;
+    }
+
+    DkmSuccessEvaluationResult* pSuccessEvalResult = DkmSuccessEvaluationResult::TryCast(pEvalResult);
+    if (pSuccessEvalResult == nullptr || pSuccessEvalResult->Value() == nullptr)
+    {
+        return E_FAIL;
+    }
+
+    // The value is formatted in the radix of the inspection context, which wcstoull handles
+    // either way
+    LPCWSTR valueStr = pSuccessEvalResult->Value()->Value();
+    LPWSTR endPtr;
+    *pResult = wcstoull(valueStr, &endPtr, 0);
+    if (valueStr == endPtr)
+    {
+        return E_FAIL;
+    }
+
+    return S_OK;
+}
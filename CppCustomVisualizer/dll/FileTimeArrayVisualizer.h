@@ -0,0 +1,97 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+#pragma once
+
+// CFileTimeArrayVisualizer takes over the expansion of a std::vector<FILETIME>. Instead of letting
+// the C++ EE evaluate each element (which reads and formats one FILETIME at a time), each window
+// of children that the debugger requests is read from the target with a single read and formatted
+// as a batch. It is the data item of the root DkmVisualizedExpression.
+class ATL_NO_VTABLE __declspec(uuid("e2a7c4d9-3b61-4f8e-a05d-7c9e1b4f6a38")) CFileTimeArrayVisualizer :
+    public IUnknown,
+    public CComObjectRootEx<CComMultiThreadModel>
+{
+private:
+    CComPtr<DkmVisualizedExpression> m_pVisualizedExpression;
+
+    // Expression for the element storage of the vector, ex: '(v)._Mypair._Myval2._Myfirst'
+    CString m_firstText;
+    UINT64 m_firstAddress;
+    UINT32 m_count;
+
+protected:
+    CFileTimeArrayVisualizer() :
+        m_firstAddress(0),
+        m_count(0)
+    {
+    }
+    ~CFileTimeArrayVisualizer()
+    {
+    }
+
+public:
+    // Returns true if 'pType' is the type name of a collection which this class visualizes
+    static bool IsFileTimeArrayType(_In_opt_ DkmString* pType);
+
+    // Creates the evaluation result of the root expression, and associates a new instance of this
+    // class with 'pVisualizedExpression'.
+    static HRESULT CreateEvaluationResult(
+        _In_ DkmRootVisualizedExpression* pVisualizedExpression,
+        _Deref_out_ DkmEvaluationResult** ppResultObject
+    );
+
+    HRESULT GetChildren(
+        _In_ UINT32 InitialRequestSize,
+        _In_ DkmInspectionContext* pInspectionContext,
+        _Out_ DkmArray<DkmChildVisualizedExpression*>* pInitialChildren,
+        _Deref_out_ DkmEvaluationResultEnumContext** ppEnumContext
+    );
+
+    HRESULT GetItems(
+        _In_ DkmVisualizedExpression* pVisualizedExpression,
+        _In_ DkmEvaluationResultEnumContext* pEnumContext,
+        _In_ UINT32 StartIndex,
+        _In_ UINT32 Count,
+        _Out_ DkmArray<DkmChildVisualizedExpression*>* pItems
+    );
+
+protected:
+    // Reads elements [StartIndex, StartIndex+Count) into 'ticks'. The window is read with one call;
+    // if that fails, the elements are read one by one and those which can't be read are marked in
+    // 'readable'.
+    HRESULT ReadWindow(
+        _In_ UINT32 StartIndex,
+        _In_ UINT32 Count,
+        _Out_ CAtlArray<ULONGLONG>& ticks,
+        _Out_ CAtlArray<bool>& readable
+    );
+
+    HRESULT CreateItem(
+        _In_ DkmVisualizedExpression* pParent,
+        _In_ DkmString* pType,
+        _In_ UINT32 index,
+        _In_ LPCWSTR valueText,
+        _Deref_out_ DkmChildVisualizedExpression** ppResult
+    );
+
+    static HRESULT EvaluateUInt64(
+        _In_ DkmVisualizedExpression* pVisualizedExpression,
+        _In_ LPCWSTR evalText,
+        _Out_ unsigned long long* pResult
+    );
+
+    HRESULT _InternalQueryInterface(REFIID riid, void** ppvObject)
+    {
+        if (ppvObject == NULL)
+            return E_POINTER;
+
+        if (riid == __uuidof(IUnknown))
+        {
+            *ppvObject = static_cast<IUnknown*>(this);
+            AddRef();
+            return S_OK;
+        }
+
+        *ppvObject = NULL;
+        return E_NOINTERFACE;
+    }
+};
@@ -0,0 +1,184 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+// FileTimeFormat.cpp : Formatting of FILETIME values for display in the debugger
+
+#include "stdafx.h"
+#include "FileTimeFormat.h"
+#include "CivilTime.h"
+#include "DateTimePattern.h"
+
+static void CivilTimeToSystemTime(const CivilTime& civilTime, SYSTEMTIME& systemTime)
+{
+    systemTime.wYear = civilTime.Year;
+    systemTime.wMonth = civilTime.Month;
+    systemTime.wDayOfWeek = civilTime.DayOfWeek;
+    systemTime.wDay = civilTime.Day;
+    systemTime.wHour = civilTime.Hour;
+    systemTime.wMinute = civilTime.Minute;
+    systemTime.wSecond = civilTime.Second;
+    systemTime.wMilliseconds = civilTime.Milliseconds;
+}
+
+// Formats with GetDateFormatW/GetTimeFormatW. This is used for locales which DateTimePattern doesn't
+// support.
+static HRESULT SystemTimeToTextWithNls(LCID locale, const SYSTEMTIME& systemTime, CString& text)
+{
+    text.Empty();
+
+    int cch;
+
+    // Deterime how much to allocate for the date
+    cch = GetDateFormatW(
+        locale,
+        DATE_SHORTDATE,
+        &systemTime,
+        nullptr,
+        nullptr,
+        0
+        );
+    if (cch == 0)
+    {
+        return WIN32_LAST_ERROR();
+    }
+
+    int allocLength = cch
+        - 1 // To convert from a character count (including null terminator) to a length
+        + 1; // For the space (' ') character between the date and time
+
+    // Deterime how much to allocate for the time
+    cch = GetTimeFormatW(
+        locale,
+        /*flags*/0,
+        &systemTime,
+        nullptr,
+        nullptr,
+        0
+        );
+    if (cch == 0)
+    {
+        return WIN32_LAST_ERROR();
+    }
+
+    allocLength += (cch - 1); // '-1' is to convert from a character count (including null terminator) to a length
+    CString result;
+    LPWSTR pBuffer = result.GetBuffer(allocLength);
+
+    // Add the date
+    cch = GetDateFormatW(
+        locale,
+        DATE_SHORTDATE,
+        &systemTime,
+        nullptr,
+        pBuffer,
+        allocLength+1
+        );
+    if (cch == 0)
+    {
+        return WIN32_LAST_ERROR();
+    }
+
+    pBuffer += ((size_t)cch-1); // '-1' is to convert from a character count (including null terminator) to a length
+    int remainaingLength = allocLength - (cch-1);
+
+    // Add a space between the date and the time
+    if (remainaingLength <= 1)
+    {
+        return HRESULT_FROM_WIN32(ERROR_INSUFFICIENT_BUFFER);
+    }
+    *pBuffer = ' ';
+    pBuffer++;
+    remainaingLength--;
+
+    // Add the time
+    cch = GetTimeFormatW(
+        locale,
+        /*flags*/0,
+        &systemTime,
+        nullptr,
+        pBuffer,
+        remainaingLength + 1 // '+1' is for null terminator
+        );
+    if (cch == 0)
+    {
+        return WIN32_LAST_ERROR();
+    }
+
+    result.ReleaseBuffer();
+    text = result;
+
+    return S_OK;
+}
+
+// 'pPattern' is DateTimePattern::Get(locale), which callers look up once for all of their values
+static HRESULT SystemTimeToText(LCID locale, const DateTimePattern* pPattern, const SYSTEMTIME& systemTime, CString& text)
+{
+    if (pPattern != nullptr)
+    {
+        // Date and time formats are far shorter than this, so the fallback below is only for safety
+        WCHAR buffer[128];
+        size_t length = pPattern->Format(systemTime, buffer, _countof(buffer));
+        if (length != 0)
+        {
+            text.SetString(buffer, static_cast<int>(length));
+            return S_OK;
+        }
+    }
+
+    return SystemTimeToTextWithNls(locale, systemTime, text);
+}
+
+HRESULT FileTimeToText(const FILETIME& fileTime, CString& text)
+{
+    text.Empty();
+
+    // Convert to a SYSTEMTIME with CivilTime rather than FileTimeToSystemTime. It produces the same
+    // result without a call into the OS.
+    CivilTime civilTime;
+    ULONGLONG ticks = (static_cast<ULONGLONG>(fileTime.dwHighDateTime) << 32) | fileTime.dwLowDateTime;
+    if (!FileTimeTicksToCivil(ticks, &civilTime))
+    {
+        return E_INVALIDARG;
+    }
+
+    SYSTEMTIME systemTime;
+    CivilTimeToSystemTime(civilTime, systemTime);
+
+    LCID locale = GetThreadLocale();
+    return SystemTimeToText(locale, DateTimePattern::Get(locale), systemTime, text);
+}
+
+HRESULT FileTimesToText(_In_reads_(count) const ULONGLONG* pTicks, _In_ size_t count, _Out_writes_(count) CString* pTexts)
+{
+    CAtlArray<CivilTime> civilTimes;
+    if (!civilTimes.SetCount(count))
+    {
+        return E_OUTOFMEMORY;
+    }
+
+    static_assert(sizeof(ULONGLONG) == sizeof(uint64_t), "FILETIME ticks are 64 bits");
+    FileTimeTicksToCivil(reinterpret_cast<const uint64_t*>(pTicks), count, civilTimes.GetData());
+
+    LCID locale = GetThreadLocale();
+    const DateTimePattern* pPattern = DateTimePattern::Get(locale);
+    for (size_t i = 0; i < count; i++)
+    {
+        // FileTimeTicksToCivil zeroes the entries which it could not convert
+        if (civilTimes[i].Year == 0)
+        {
+            pTexts[i].Empty();
+            continue;
+        }
+
+        SYSTEMTIME systemTime;
+        CivilTimeToSystemTime(civilTimes[i], systemTime);
+
+        HRESULT hr = SystemTimeToText(locale, pPattern, systemTime, pTexts[i]);
+        if (FAILED(hr))
+        {
+            pTexts[i].Empty();
+        }
+    }
+
+    return S_OK;
+}
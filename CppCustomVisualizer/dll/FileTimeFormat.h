@@ -0,0 +1,11 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+#pragma once
+
+// Formats a FILETIME as '<short date> <time>' using the locale of the current thread
+HRESULT FileTimeToText(const FILETIME& fileTime, CString& text);
+
+// Formats 'count' FILETIMEs, given as raw 100ns tick counts, into 'pTexts'. All of the values are
+// converted to civil time in one batch before any of them is formatted. Values which cannot be
+// formatted get an empty string, and the method still succeeds.
+HRESULT FileTimesToText(_In_reads_(count) const ULONGLONG* pTicks, _In_ size_t count, _Out_writes_(count) CString* pTexts);
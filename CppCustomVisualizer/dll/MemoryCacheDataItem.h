@@ -0,0 +1,65 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+#pragma once
+
+#include "MemoryCache.h"
+
+// CMemoryCacheDataItem holds a MemoryPageCache of the target process for one root
+// DkmVisualizedExpression. The windows of a FILETIME array are read through it, so the windows
+// which overlap the same pages while the array is expanded are served from the cache. The debugger evaluates the expression again, which creates a new root, after
+// anything could have changed memory: when the process continues, and when a value is edited in
+// the same break state. Each evaluation therefore starts with an empty cache.
+class ATL_NO_VTABLE __declspec(uuid("4b8d2e61-7a3c-4f19-b5e0-8c6a1d9f3b72")) CMemoryCacheDataItem :
+    public IUnknown,
+    public CComObjectRootEx<CComMultiThreadModel>
+{
+private:
+    CComPtr<DkmProcess> m_pProcess;
+    MemoryPageCache m_cache;
+
+protected:
+    CMemoryCacheDataItem()
+    {
+    }
+    ~CMemoryCacheDataItem()
+    {
+    }
+
+public:
+    // Reads target memory through the cache of the root of 'pVisualizedExpression'
+    static HRESULT ReadMemory(
+        _In_ DkmVisualizedExpression* pVisualizedExpression,
+        _In_ UINT64 address,
+        _Out_writes_bytes_(size) void* pBuffer,
+        _In_ UINT32 size
+    );
+
+    // Returns the hit/miss counters of the cache of the root of 'pVisualizedExpression'
+    static HRESULT GetStatistics(
+        _In_ DkmVisualizedExpression* pVisualizedExpression,
+        _Out_ UINT64* pHits,
+        _Out_ UINT64* pMisses
+    );
+
+protected:
+    static HRESULT GetInstance(
+        _In_ DkmVisualizedExpression* pVisualizedExpression,
+        _Deref_out_ CMemoryCacheDataItem** ppDataItem
+    );
+
+    HRESULT _InternalQueryInterface(REFIID riid, void** ppvObject)
+    {
+        if (ppvObject == NULL)
+            return E_POINTER;
+
+        if (riid == __uuidof(IUnknown))
+        {
+            *ppvObject = static_cast<IUnknown*>(this);
+            AddRef();
+            return S_OK;
+        }
+
+        *ppvObject = NULL;
+        return E_NOINTERFACE;
+    }
+};
@@ -0,0 +1,28 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+#include "stdafx.h"
+#include "TargetBitnessDataItem.h"
+
+//static
+UINT32 CTargetBitnessDataItem::GetPointerSize(_In_ DkmProcess* pProcess)
+{
+    CComPtr<CTargetBitnessDataItem> pDataItem;
+    if (pProcess->GetDataItem(&pDataItem) == S_OK)
+    {
+        return pDataItem->m_pointerSize;
+    }
+
+    UINT32 pointerSize = (pProcess->SystemInformation()->Flags() & DefaultPort::DkmSystemInformationFlags::Is64Bit) != 0 ? 8 : 4;
+
+    CComObject<CTargetBitnessDataItem>* pComObject;
+    if (SUCCEEDED(CComObject<CTargetBitnessDataItem>::CreateInstance(&pComObject)))
+    {
+        CComPtr<CTargetBitnessDataItem> pCreatedInstance(pComObject);
+        pCreatedInstance->m_pointerSize = pointerSize;
+
+        // Another thread may have raced us here. Both results are the same, so ignore failures.
+        pProcess->SetDataItem(DkmDataCreationDisposition::CreateNew, pCreatedInstance.p);
+    }
+
+    return pointerSize;
+}
@@ -5,6 +5,11 @@
 
 #include "stdafx.h"
 #include "_EntryPoint.h"
+#include "FileTimeFormat.h"
+#include "FileTimeArrayVisualizer.h"
+#include "DefaultEvaluationDataItem.h"
+#include "TargetBitnessDataItem.h"
+#include "AddressFormat.h"
 
 HRESULT STDMETHODCALLTYPE CCppCustomVisualizerService::EvaluateVisualizedExpression(
     _In_ Evaluation::DkmVisualizedExpression* pVisualizedExpression,
@@ -28,11 +33,17 @@ HRESULT STDMETHODCALLTYPE CCppCustomVisualizerService::EvaluateVisualizedExpress
     DkmRootVisualizedExpression* pRootVisualizedExpression = DkmRootVisualizedExpression::TryCast(pVisualizedExpression);
     if (pRootVisualizedExpression == nullptr)
     {
-        // This sample doesn't provide child evaluation results, so only root expressions are expected
+        // Children of FILETIME arrays are created with their evaluation results, so only root expressions are expected
         return E_NOTIMPL;
     }
 
-    // Read the FILETIME value from the target process
+    if (CFileTimeArrayVisualizer::IsFileTimeArrayType(pRootVisualizedExpression->Type()))
+    {
+        return CFileTimeArrayVisualizer::CreateEvaluationResult(pRootVisualizedExpression, ppResultObject);
+    }
+
+    // Read the FILETIME value from the target process. A single FILETIME is one read of 8 bytes,
+    // so it doesn't go through the memory cache, which only pays off for the windows of arrays.
     DkmProcess* pTargetProcess = pVisualizedExpression->RuntimeInstance()->Process();
     FILETIME value;
 #pragma prefast(suppress:6387, "pBytesRead is unused and can be null")
@@ -58,19 +69,17 @@ HRESULT STDMETHODCALLTYPE CCppCustomVisualizerService::EvaluateVisualizedExpress
     if (pType != nullptr && wcschr(pType->Value(), '*') != nullptr)
     {
         // Make the editable value just the pointer string
-        UINT64 address = pPointerValueHome->Address();
-        if ((pTargetProcess->SystemInformation()->Flags()& DefaultPort::DkmSystemInformationFlags::Is64Bit) != 0)
-        {
-            strEditableValue.Format(L"0x%08x%08x", static_cast<DWORD>(address >> 32), static_cast<DWORD>(address));
-        }
-        else
-        {
-            strEditableValue.Format(L"0x%08x", static_cast<DWORD>(address));
-        }
+        WCHAR addressText[AddressFormatBufferLength];
+        size_t addressLength = FormatAddress(pPointerValueHome->Address(), CTargetBitnessDataItem::GetPointerSize(pTargetProcess), addressText);
+        strEditableValue.SetString(addressText, static_cast<int>(addressLength));
 
         // Prefix the value with the address
         CString strValueWithAddress;
-        strValueWithAddress.Format(L"%s {%s}", static_cast<LPCWSTR>(strEditableValue), static_cast<LPCWSTR>(strValue));
+        strValueWithAddress.Preallocate(static_cast<int>(addressLength) + 3 + strValue.GetLength());
+        strValueWithAddress.Append(addressText, static_cast<int>(addressLength));
+        strValueWithAddress.Append(L" {");
+        strValueWithAddress.Append(strValue);
+        strValueWithAddress.AppendChar(L'}');
         strValue = strValueWithAddress;
     }
 
@@ -152,20 +161,68 @@ HRESULT STDMETHODCALLTYPE CCppCustomVisualizerService::UseDefaultEvaluationBehav
     // NOTE: If this custom visualizer supported underlying strings (no DkmEvaluationResultFlags::RawString),
     // this method would also be called when that is requested.
 
+    // FILETIME arrays are expanded by GetChildren/GetItems instead
+    CComPtr<CFileTimeArrayVisualizer> pArrayVisualizer;
+    if (pVisualizedExpression->GetDataItem(&pArrayVisualizer) == S_OK)
+    {
+        *pUseDefaultEvaluationBehavior = false;
+        *ppDefaultEvaluationResult = nullptr;
+        return S_OK;
+    }
+
+    // Both root FILETIMEs and the elements of FILETIME arrays are delegated. The elements already
+    // have evaluation results, which carry their full name.
+    DkmString* pFullName = nullptr;
     DkmRootVisualizedExpression* pRootVisualizedExpression = DkmRootVisualizedExpression::TryCast(pVisualizedExpression);
-    if (pRootVisualizedExpression == nullptr)
+    DkmChildVisualizedExpression* pChildVisualizedExpression = DkmChildVisualizedExpression::TryCast(pVisualizedExpression);
+    if (pRootVisualizedExpression != nullptr)
+    {
+        pFullName = pRootVisualizedExpression->FullName();
+    }
+    else if (pChildVisualizedExpression != nullptr)
+    {
+        DkmSuccessEvaluationResult* pChildEvaluationResult = DkmSuccessEvaluationResult::TryCast(pChildVisualizedExpression->EvaluationResult());
+        if (pChildEvaluationResult != nullptr)
+        {
+            pFullName = pChildEvaluationResult->FullName();
+        }
+    }
+    if (pFullName == nullptr)
     {
-        // This sample doesn't provide child evaluation results, so only root expressions are expected
         return E_NOTIMPL;
     }
 
     DkmInspectionContext* pParentInspectionContext = pVisualizedExpression->InspectionContext();
 
+    CComPtr<CDefaultEvaluationDataItem> pCache;
+    hr = CDefaultEvaluationDataItem::GetInstance(pParentInspectionContext->InspectionSession(), &pCache);
+    if (FAILED(hr))
+    {
+        return hr;
+    }
+
+    // Evaluate in an inspection context with 'DkmEvaluationFlags::ShowValueRaw' set. This is important because
+    // the result of the expression is a FILETIME, and we don't want our visualizer to be invoked again. This
+    // step would be unnecessary if we were evaluating a different expression that resulted in a type which
+    // we didn't visualize. The context only depends on the parent context, so it is created once per parent.
+    CComPtr<DkmInspectionContext> pInspectionContext;
+    hr = pCache->GetInspectionContext(pParentInspectionContext, &pInspectionContext);
+    if (hr != S_OK)
+    {
+        hr = CreateRawInspectionContext(pParentInspectionContext, &pInspectionContext);
+        if (FAILED(hr))
+        {
+            return hr;
+        }
+
+        pCache->AddInspectionContext(pParentInspectionContext, pInspectionContext);
+    }
+
     CAutoDkmClosePtr<DkmLanguageExpression> pLanguageExpression;
     hr = DkmLanguageExpression::Create(
         pParentInspectionContext->Language(),
         DkmEvaluationFlags::TreatAsExpression,
-        pRootVisualizedExpression->FullName(),
+        pFullName,
         DkmDataItem::Null(),
         &pLanguageExpression
         );
@@ -174,12 +231,32 @@ HRESULT STDMETHODCALLTYPE CCppCustomVisualizerService::UseDefaultEvaluationBehav
         return hr;
     }
 
-    // Create a new inspection context with 'DkmEvaluationFlags::ShowValueRaw' set. This is important because
-    // the result of the expression is a FILETIME, and we don't want our visualizer to be invoked again. This
-    // step would be unnecessary if we were evaluating a different expression that resulted in a type which
-    // we didn't visualize.
-    CComPtr<DkmInspectionContext> pInspectionContext;
-    if (DkmComponentManager::IsApiVersionSupported(DkmApiVersion::VS16RTMPreview))
+    CComPtr<DkmEvaluationResult> pEEEvaluationResult;
+    #pragma warning(suppress : 6387) // 'pLanguageExpression' could be 0
+    hr = pVisualizedExpression->EvaluateExpressionCallback(
+        pInspectionContext,
+        pLanguageExpression,
+        pVisualizedExpression->StackFrame(),
+        &pEEEvaluationResult
+        );
+    if (FAILED(hr))
+    {
+        return hr;
+    }
+
+    *ppDefaultEvaluationResult = pEEEvaluationResult.Detach();
+    *pUseDefaultEvaluationBehavior = true;
+    return S_OK;
+}
+
+HRESULT CCppCustomVisualizerService::CreateRawInspectionContext(
+    _In_ Evaluation::DkmInspectionContext* pParentInspectionContext,
+    _Deref_out_ Evaluation::DkmInspectionContext** ppInspectionContext
+    )
+{
+    HRESULT hr;
+
+    if (m_fVS16InspectionContextSupported)
     {
         // If we are running in VS 16 or newer, use this overload...
         hr = DkmInspectionContext::Create(
@@ -197,7 +274,7 @@ HRESULT STDMETHODCALLTYPE CCppCustomVisualizerService::UseDefaultEvaluationBehav
             Evaluation::DkmCompiledVisualizationDataPriority::None,
             pParentInspectionContext->ReturnValues(),
             pParentInspectionContext->SymbolsConnection(),
-            &pInspectionContext
+            ppInspectionContext
             );
     }
     else
@@ -217,30 +294,10 @@ HRESULT STDMETHODCALLTYPE CCppCustomVisualizerService::UseDefaultEvaluationBehav
             (Evaluation::DkmCompiledVisualizationData*)nullptr,
             Evaluation::DkmCompiledVisualizationDataPriority::None,
             pParentInspectionContext->ReturnValues(),
-            &pInspectionContext
+            ppInspectionContext
             );
     }
-    if (FAILED(hr))
-    {
-        return hr;
-    }
-
-    CComPtr<DkmEvaluationResult> pEEEvaluationResult;
-    #pragma warning(suppress : 6387) // 'pLanguageExpression' could be 0
-    hr = pVisualizedExpression->EvaluateExpressionCallback(
-        pInspectionContext,
-        pLanguageExpression,
-        pVisualizedExpression->StackFrame(),
-        &pEEEvaluationResult
-        );
-    if (FAILED(hr))
-    {
-        return hr;
-    }
-
-    *ppDefaultEvaluationResult = pEEEvaluationResult.Detach();
-    *pUseDefaultEvaluationBehavior = true;
-    return S_OK;
+    return hr;
 }
 
 HRESULT STDMETHODCALLTYPE CCppCustomVisualizerService::GetChildren(
@@ -251,8 +308,15 @@ HRESULT STDMETHODCALLTYPE CCppCustomVisualizerService::GetChildren(
     _Deref_out_ Evaluation::DkmEvaluationResultEnumContext** ppEnumContext
     )
 {
-    // This sample delegates expansion to the C++ EE, so this method doesn't need to be implemented
-    return E_NOTIMPL;
+    // Single FILETIMEs are expanded by the C++ EE (see UseDefaultEvaluationBehavior), so this is only
+    // called for FILETIME arrays
+    CComPtr<CFileTimeArrayVisualizer> pArrayVisualizer;
+    if (pVisualizedExpression->GetDataItem(&pArrayVisualizer) != S_OK)
+    {
+        return E_NOTIMPL;
+    }
+
+    return pArrayVisualizer->GetChildren(InitialRequestSize, pInspectionContext, pInitialChildren, ppEnumContext);
 }
 
 HRESULT STDMETHODCALLTYPE CCppCustomVisualizerService::GetItems(
@@ -263,8 +327,13 @@ HRESULT STDMETHODCALLTYPE CCppCustomVisualizerService::GetItems(
     _Out_ DkmArray<Evaluation::DkmChildVisualizedExpression*>* pItems
     )
 {
-    // This sample delegates expansion to the C++ EE, so this method doesn't need to be implemented
-    return E_NOTIMPL;
+    CComPtr<CFileTimeArrayVisualizer> pArrayVisualizer;
+    if (pVisualizedExpression->GetDataItem(&pArrayVisualizer) != S_OK)
+    {
+        return E_NOTIMPL;
+    }
+
+    return pArrayVisualizer->GetItems(pVisualizedExpression, pEnumContext, StartIndex, Count, pItems);
 }
 
 HRESULT STDMETHODCALLTYPE CCppCustomVisualizerService::SetValueAsString(
@@ -287,97 +356,3 @@ HRESULT STDMETHODCALLTYPE CCppCustomVisualizerService::GetUnderlyingString(
     // doesn't need to be implemented
     return E_NOTIMPL;
 }
-
-HRESULT CCppCustomVisualizerService::FileTimeToText(const FILETIME& fileTime, CString& text)
-{
-    text.Empty();
-
-    SYSTEMTIME systemTime;
-    if (!FileTimeToSystemTime(&fileTime, &systemTime))
-    {
-        return WIN32_LAST_ERROR();
-    }
-
-    int cch;
-
-    // Deterime how much to allocate for the date
-    cch = GetDateFormatW(
-        GetThreadLocale(),
-        DATE_SHORTDATE,
-        &systemTime,
-        nullptr,
-        nullptr,
-        0
-        );
-    if (cch == 0)
-    {
-        return WIN32_LAST_ERROR();
-    }
-
-    int allocLength = cch
-        - 1 // To convert from a character count (including null terminator) to a length
-        + 1; // For the space (' ') character between the date and time
-
-    // Deterime how much to allocate for the time
-    cch = GetTimeFormatW(
-        GetThreadLocale(),
-        /*flags*/0,
-        &systemTime,
-        nullptr,
-        nullptr,
-        0
-        );
-    if (cch == 0)
-    {
-        return WIN32_LAST_ERROR();
-    }
-
-    allocLength += (cch - 1); // '-1' is to convert from a character count (including null terminator) to a length
-    CString result;
-    LPWSTR pBuffer = result.GetBuffer(allocLength);
-
-    // Add the date
-    cch = GetDateFormatW(
-        GetThreadLocale(),
-        DATE_SHORTDATE,
-        &systemTime,
-        nullptr,
-        pBuffer,
-        allocLength+1
-        );
-    if (cch == 0)
-    {
-        return WIN32_LAST_ERROR();
-    }
-
-    pBuffer += ((size_t)cch-1); // '-1' is to convert from a character count (including null terminator) to a length
-    int remainaingLength = allocLength - (cch-1);
-
-    // Add a space between the date and the time
-    if (remainaingLength <= 1)
-    {
-        return HRESULT_FROM_WIN32(ERROR_INSUFFICIENT_BUFFER);
-    }
-    *pBuffer = ' ';
-    pBuffer++;
-    remainaingLength--;
-
-    // Add the time
-    cch = GetTimeFormatW(
-        GetThreadLocale(),
-        /*flags*/0,
-        &systemTime,
-        nullptr,
-        pBuffer,
-        remainaingLength + 1 // '+1' is for null terminator
-        );
-    if (cch == 0)
-    {
-        return WIN32_LAST_ERROR();
-    }
-
-    result.ReleaseBuffer();
-    text = result;
-
-    return S_OK;
-}
\ No newline at end of file
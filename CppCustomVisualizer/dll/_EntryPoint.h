@@ -21,8 +21,14 @@ class ATL_NO_VTABLE CCppCustomVisualizerService :
     // DllGetClassObject
     public CComCoClass<CCppCustomVisualizerService, &CCppCustomVisualizerServiceContract::ClassId>
 {
+private:
+    // Whether the VS 16 overload of DkmInspectionContext::Create is available. The debugger's API
+    // version can't change while this component is loaded, so it is checked once here.
+    const bool m_fVS16InspectionContextSupported;
+
 protected:
-    CCppCustomVisualizerService()
+    CCppCustomVisualizerService() :
+        m_fVS16InspectionContextSupported(DkmComponentManager::IsApiVersionSupported(DkmApiVersion::VS16RTMPreview))
     {
     }
     ~CCppCustomVisualizerService()
@@ -70,7 +76,10 @@ public:
         );
 
 private:
-    static HRESULT FileTimeToText(const FILETIME& fileTime, CString& text);
+    HRESULT CreateRawInspectionContext(
+        _In_ Evaluation::DkmInspectionContext* pParentInspectionContext,
+        _Deref_out_ Evaluation::DkmInspectionContext** ppInspectionContext
+        );
 };
 
 OBJECT_ENTRY_AUTO(CCppCustomVisualizerService::ClassId, CCppCustomVisualizerService)
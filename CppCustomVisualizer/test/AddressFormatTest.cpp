@@ -0,0 +1,51 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+// Checks AddressFormat against swprintf, which is what the visualizer used before it
+
+#include "TestCheck.h"
+#include "AddressFormat.h"
+#include <wchar.h>
+#include <random>
+
+namespace
+{
+    void CheckAddress(uint64_t address)
+    {
+        wchar_t expected[AddressFormatBufferLength];
+        wchar_t actual[AddressFormatBufferLength];
+
+        swprintf(expected, AddressFormatBufferLength, L"0x%016llx", (unsigned long long)address);
+        CHECK(FormatAddress(address, 8, actual) == 18);
+        CHECK(wcscmp(expected, actual) == 0);
+
+        swprintf(expected, AddressFormatBufferLength, L"0x%08x", (unsigned int)address);
+        CHECK(FormatAddress(address, 4, actual) == 10);
+        CHECK(wcscmp(expected, actual) == 0);
+    }
+}
+
+int main()
+{
+    CheckAddress(0);
+    CheckAddress(UINT64_MAX);
+    CheckAddress(0xffffffff);
+    CheckAddress(0x100000000ull);
+
+    // Every value of every byte position
+    for (uint32_t position = 0; position < 8; position++)
+    {
+        for (uint64_t value = 0; value < 256; value++)
+        {
+            CheckAddress(value << (8 * position));
+        }
+    }
+
+    std::mt19937_64 random(1);
+    for (int i = 0; i < 1000000; i++)
+    {
+        CheckAddress(random());
+    }
+
+    return ReportChecks();
+}
@@ -0,0 +1,124 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+// Times FileTimeTicksToCivil and FormatAddress against the C runtime functions they stand in
+// for, on the same inputs. Prints the best of several runs in nanoseconds per value.
+
+#include "AddressFormat.h"
+#include "CivilTime.h"
+#include <stdio.h>
+#include <time.h>
+#include <wchar.h>
+#include <chrono>
+#include <random>
+#include <vector>
+
+namespace
+{
+    const size_t ValueCount = 1 << 20;
+    const int Runs = 5;
+
+    // Keeps the compiler from throwing away the results
+    volatile uint64_t g_sink;
+
+    template <class TBody>
+    void Measure(const char* name, TBody body)
+    {
+        double best = 0;
+        for (int run = 0; run < Runs; run++)
+        {
+            auto start = std::chrono::steady_clock::now();
+            g_sink += body();
+            double elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+            if (run == 0 || elapsed < best)
+            {
+                best = elapsed;
+            }
+        }
+
+        printf("%-40s %8.2f ns/value\n", name, best / ValueCount);
+    }
+
+    bool ToTm(time_t seconds, struct tm* pResult)
+    {
+#if defined(_MSC_VER)
+        return gmtime_s(pResult, &seconds) == 0;
+#else
+        return gmtime_r(&seconds, pResult) != nullptr;
+#endif
+    }
+}
+
+int main()
+{
+    // FILETIMEs between 1970 and 2100, so that the C runtime can convert them too
+    const uint64_t UnixEpochTicks = 116444736000000000ull;
+    const uint64_t Year2100Ticks = 159992640000000000ull;
+    std::mt19937_64 random(1);
+    std::vector<uint64_t> ticks(ValueCount);
+    for (uint64_t& value : ticks)
+    {
+        value = UnixEpochTicks + random() % (Year2100Ticks - UnixEpochTicks);
+    }
+    std::vector<CivilTime> results(ValueCount);
+
+    Measure("FileTimeTicksToCivil (one at a time)", [&]() -> uint64_t
+    {
+        uint64_t sum = 0;
+        for (size_t i = 0; i < ValueCount; i++)
+        {
+            FileTimeTicksToCivil(ticks[i], &results[i]);
+            sum += results[i].Day;
+        }
+        return sum;
+    });
+
+    Measure("FileTimeTicksToCivil (batch)", [&]() -> uint64_t
+    {
+        return FileTimeTicksToCivil(ticks.data(), ticks.size(), results.data()) + results[ValueCount / 2].Day;
+    });
+
+    Measure("gmtime", [&]() -> uint64_t
+    {
+        uint64_t sum = 0;
+        for (size_t i = 0; i < ValueCount; i++)
+        {
+            struct tm value;
+            if (ToTm((time_t)((ticks[i] - UnixEpochTicks) / 10000000), &value))
+            {
+                sum += value.tm_mday;
+            }
+        }
+        return sum;
+    });
+
+    std::vector<uint64_t> addresses(ValueCount);
+    for (uint64_t& address : addresses)
+    {
+        address = random();
+    }
+
+    Measure("FormatAddress (64-bit)", [&]() -> uint64_t
+    {
+        uint64_t sum = 0;
+        wchar_t buffer[AddressFormatBufferLength];
+        for (size_t i = 0; i < ValueCount; i++)
+        {
+            sum += FormatAddress(addresses[i], 8, buffer) + buffer[17];
+        }
+        return sum;
+    });
+
+    Measure("swprintf(L\"0x%016llx\")", [&]() -> uint64_t
+    {
+        uint64_t sum = 0;
+        wchar_t buffer[AddressFormatBufferLength];
+        for (size_t i = 0; i < ValueCount; i++)
+        {
+            sum += swprintf(buffer, AddressFormatBufferLength, L"0x%016llx", (unsigned long long)addresses[i]) + buffer[17];
+        }
+        return sum;
+    });
+
+    return 0;
+}
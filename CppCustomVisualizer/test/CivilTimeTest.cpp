@@ -0,0 +1,225 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+// Checks FileTimeTicksToCivil against a reference calendar on every day it can convert, and on
+// every millisecond of a day. Both the scalar and the batch conversions are checked.
+
+#include "TestCheck.h"
+#include "CivilTime.h"
+#include <string.h>
+#include <vector>
+
+namespace
+{
+    const uint64_t TicksPerMillisecond = 10000;
+    const uint64_t MillisecondsPerDay = 24ull * 60 * 60 * 1000;
+    const uint64_t TicksPerDay = MillisecondsPerDay * TicksPerMillisecond;
+
+    // Converted through the batch overload in groups of this many
+    const size_t BatchSize = 4093;
+
+    // The reference: a calendar which is stepped forward one day, or one millisecond, at a time
+    struct ReferenceTime
+    {
+        CivilTime Time;
+
+        ReferenceTime()
+        {
+            // 1601-01-01 00:00:00.000, a Monday
+            memset(&Time, 0, sizeof(Time));
+            Time.Year = 1601;
+            Time.Month = 1;
+            Time.Day = 1;
+            Time.DayOfWeek = 1;
+        }
+
+        static bool IsLeapYear(uint32_t year)
+        {
+            return (year % 4 == 0 && year % 100 != 0) || year % 400 == 0;
+        }
+
+        static uint32_t DaysInMonth(uint32_t year, uint32_t month)
+        {
+            static const uint32_t days[] = { 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+            return (month == 2 && IsLeapYear(year)) ? 29 : days[month - 1];
+        }
+
+        void NextDay()
+        {
+            Time.DayOfWeek = (Time.DayOfWeek + 1) % 7;
+            if (++Time.Day <= DaysInMonth(Time.Year, Time.Month))
+            {
+                return;
+            }
+
+            Time.Day = 1;
+            if (++Time.Month <= 12)
+            {
+                return;
+            }
+
+            Time.Month = 1;
+            Time.Year++;
+        }
+
+        void NextMillisecond()
+        {
+            if (++Time.Milliseconds < 1000)
+            {
+                return;
+            }
+            Time.Milliseconds = 0;
+            if (++Time.Second < 60)
+            {
+                return;
+            }
+            Time.Second = 0;
+            if (++Time.Minute < 60)
+            {
+                return;
+            }
+            Time.Minute = 0;
+            Time.Hour++;
+        }
+    };
+
+    bool SameDate(const CivilTime& a, const CivilTime& b)
+    {
+        return a.Year == b.Year && a.Month == b.Month && a.Day == b.Day && a.DayOfWeek == b.DayOfWeek;
+    }
+
+    bool SameTime(const CivilTime& a, const CivilTime& b)
+    {
+        return a.Hour == b.Hour && a.Minute == b.Minute && a.Second == b.Second && a.Milliseconds == b.Milliseconds;
+    }
+
+    // Converts 'ticks' with the batch overload and checks each entry against the scalar one
+    void CheckBatch(const std::vector<uint64_t>& ticks, std::vector<CivilTime>* pResults)
+    {
+        pResults->resize(ticks.size());
+        CHECK(FileTimeTicksToCivil(ticks.data(), ticks.size(), pResults->data()) == ticks.size());
+
+        for (size_t i = 0; i < ticks.size(); i++)
+        {
+            CivilTime scalar;
+            CHECK(FileTimeTicksToCivil(ticks[i], &scalar));
+            CHECK(memcmp(&scalar, &(*pResults)[i], sizeof(scalar)) == 0);
+        }
+    }
+
+    // Every day from 1601-01-01 to the last one below MaxFileTimeTicks, each at a different time of
+    // day and with a different number of ticks below the millisecond
+    void TestEveryDay()
+    {
+        const uint64_t lastDay = (MaxFileTimeTicks - 1) / TicksPerDay;
+
+        ReferenceTime reference;
+        std::vector<uint64_t> ticks;
+        std::vector<uint32_t> msOfDay;
+        std::vector<CivilTime> results;
+        for (uint64_t day = 0; day <= lastDay; day++)
+        {
+            uint64_t ms = (day * 48271) % MillisecondsPerDay;
+            uint64_t value = day * TicksPerDay + ms * TicksPerMillisecond + day % TicksPerMillisecond;
+            if (value >= MaxFileTimeTicks)
+            {
+                value = MaxFileTimeTicks - 1;
+                ms = (value % TicksPerDay) / TicksPerMillisecond;
+            }
+            ticks.push_back(value);
+            msOfDay.push_back((uint32_t)ms);
+
+            if (ticks.size() == BatchSize || day == lastDay)
+            {
+                CheckBatch(ticks, &results);
+                for (size_t i = 0; i < results.size(); i++)
+                {
+                    CHECK(SameDate(results[i], reference.Time));
+                    CHECK(results[i].Hour * 3600000u + results[i].Minute * 60000u + results[i].Second * 1000u + results[i].Milliseconds == msOfDay[i]);
+                    reference.NextDay();
+                }
+                ticks.clear();
+                msOfDay.clear();
+            }
+        }
+
+        // The last day is the one FileTimeToSystemTime documents as its limit
+        CivilTime last;
+        CHECK(FileTimeTicksToCivil(MaxFileTimeTicks - 1, &last));
+        CHECK(last.Year == 30828 && last.Month == 9 && last.Day == 14);
+        CHECK(last.Hour == 2 && last.Minute == 48 && last.Second == 5 && last.Milliseconds == 477);
+    }
+
+    // Every millisecond of a day, on a day which is in a leap year and past the first 400 years
+    void TestEveryMillisecond()
+    {
+        // 2024-02-29
+        ReferenceTime reference;
+        uint64_t day = 0;
+        while (!(reference.Time.Year == 2024 && reference.Time.Month == 2 && reference.Time.Day == 29))
+        {
+            reference.NextDay();
+            day++;
+        }
+
+        std::vector<uint64_t> ticks;
+        std::vector<CivilTime> results;
+        for (uint64_t ms = 0; ms < MillisecondsPerDay; ms += BatchSize)
+        {
+            ticks.clear();
+            for (uint64_t i = ms; i < ms + BatchSize && i < MillisecondsPerDay; i++)
+            {
+                ticks.push_back(day * TicksPerDay + i * TicksPerMillisecond + TicksPerMillisecond - 1);
+            }
+
+            CheckBatch(ticks, &results);
+            for (size_t i = 0; i < results.size(); i++)
+            {
+                CHECK(SameDate(results[i], reference.Time));
+                CHECK(SameTime(results[i], reference.Time));
+                reference.NextMillisecond();
+            }
+        }
+    }
+
+    // Values FileTimeToSystemTime rejects are rejected, and zeroed by the batch overload
+    void TestInvalid()
+    {
+        CivilTime result;
+        CHECK(!FileTimeTicksToCivil(MaxFileTimeTicks, &result));
+        CHECK(!FileTimeTicksToCivil(UINT64_MAX, &result));
+
+        std::vector<uint64_t> ticks(19);
+        for (size_t i = 0; i < ticks.size(); i++)
+        {
+            ticks[i] = (i % 3 == 0) ? MaxFileTimeTicks + i : i * TicksPerDay;
+        }
+
+        std::vector<CivilTime> results(ticks.size());
+        CHECK(FileTimeTicksToCivil(ticks.data(), ticks.size(), results.data()) == 12);
+        for (size_t i = 0; i < ticks.size(); i++)
+        {
+            if (i % 3 == 0)
+            {
+                CivilTime zero;
+                memset(&zero, 0, sizeof(zero));
+                CHECK(memcmp(&results[i], &zero, sizeof(zero)) == 0);
+            }
+            else
+            {
+                CHECK(FileTimeTicksToCivil(ticks[i], &result) && memcmp(&results[i], &result, sizeof(result)) == 0);
+            }
+        }
+
+        CHECK(FileTimeTicksToCivil(ticks.data(), 0, results.data()) == 0);
+    }
+}
+
+int main()
+{
+    TestEveryDay();
+    TestEveryMillisecond();
+    TestInvalid();
+
+    return ReportChecks();
+}
@@ -7,13 +7,74 @@
 #include <windows.h>
 #include "TargetApp.h"
 
+static void FillSample(Sample& sample, size_t count)
+{
+    sample.a.resize(count);
+    sample.b.resize(count);
+    for (size_t i = 0; i < count; i++)
+    {
+        sample.a[i] = static_cast<int>(i);
+        sample.b[i] = static_cast<int>(count - i);
+    }
+}
+
 int wmain(int argc, WCHAR* argv[])
 {
     Sample sample;
     sample.a = { 1, 2, 3, 4, 5 };
     sample.b = { 5, 4, 3, 2, 1 };
 
-    __debugbreak(); // program will stop here. Evaluate 'sample' in the locals or watch window.
+    // Scenarios for measuring how the visualizer scales (see PerfTrace.h in the visualizer). The
+    // 10^8 element Sample needs about 800MB, so it is only built when '/large' is passed.
+    bool buildLarge = argc > 1 && _wcsicmp(argv[1], L"/large") == 0;
+
+    Sample sample10;
+    Sample sample1K;
+    Sample sample1M;
+    Sample sample100M;
+    FillSample(sample10, 10);
+    FillSample(sample1K, 1000);
+    FillSample(sample1M, 1000000);
+    if (buildLarge)
+    {
+        FillSample(sample100M, 100000000);
+    }
+
+    NestedSample nested;
+    nested.id = 1;
+    FillSample(nested.inner, 1000000);
+
+    Sample* pSample1M = &sample1M;
+    NestedSample* pNested = &nested;
+
+    std::vector<Sample> samples(3);
+    for (Sample& element : samples)
+    {
+        FillSample(element, 1000);
+    }
+
+    // 'a' and 'b' only differ at a few rows, which '[Mismatches]' should find
+    Sample diverging1M;
+    diverging1M.a.resize(1000000);
+    for (size_t i = 0; i < diverging1M.a.size(); i++)
+    {
+        diverging1M.a[i] = static_cast<int>(i);
+    }
+    diverging1M.b = diverging1M.a;
+    diverging1M.b[123456] = -1;
+    diverging1M.b[500000] = -1;
+    diverging1M.b[999999] = -1;
+
+    Particles particles;
+    for (unsigned int i = 0; i < 2000; i++)
+    {
+        particles.x.push_back(i * 0.5f);
+        particles.y.push_back(i * -0.25f);
+        particles.mass.push_back(1.0 / (i + 1));
+        particles.id.push_back(i);
+    }
+
+    __debugbreak(); // program will stop here. Evaluate 'sample' (or one of the scenarios above) in the locals or watch window.
     std::cout << "Test complete\n";
 
     return 0;
@@ -9,3 +9,21 @@ public:
     std::vector<int> a;
     std::vector<int> b;
 };
+
+// A Sample which is a member of another object, rather than a local
+class NestedSample
+{
+public:
+    int id;
+    Sample inner;
+};
+
+// Parallel arrays of mixed element types. Expecting all of the vectors to have the same size.
+class Particles
+{
+public:
+    std::vector<float> x;
+    std::vector<float> y;
+    std::vector<double> mass;
+    std::vector<unsigned int> id;
+};
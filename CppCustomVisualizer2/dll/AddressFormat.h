@@ -0,0 +1,71 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+#pragma once
+
+// This file defines AddressFormat, which formats target addresses the way the debugger shows
+// pointers: '0x' followed by 8 (32-bit target) or 16 (64-bit target) lower case hex digits. It only
+// depends on the C++ standard library.
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace AddressFormatDetail
+{
+    // Two hex digits for every byte value
+    static const wchar_t HexPairs[] =
+        L"000102030405060708090a0b0c0d0e0f101112131415161718191a1b1c1d1e1f"
+        L"202122232425262728292a2b2c2d2e2f303132333435363738393a3b3c3d3e3f"
+        L"404142434445464748494a4b4c4d4e4f505152535455565758595a5b5c5d5e5f"
+        L"606162636465666768696a6b6c6d6e6f707172737475767778797a7b7c7d7e7f"
+        L"808182838485868788898a8b8c8d8e8f909192939495969798999a9b9c9d9e9f"
+        L"a0a1a2a3a4a5a6a7a8a9aaabacadaeafb0b1b2b3b4b5b6b7b8b9babbbcbdbebf"
+        L"c0c1c2c3c4c5c6c7c8c9cacbcccdcecfd0d1d2d3d4d5d6d7d8d9dadbdcdddedf"
+        L"e0e1e2e3e4e5e6e7e8e9eaebecedeeeff0f1f2f3f4f5f6f7f8f9fafbfcfdfeff";
+}
+
+template <unsigned int PointerSize>
+struct AddressFormat
+{
+    static_assert(PointerSize == 4 || PointerSize == 8, "Targets are either 32-bit or 64-bit");
+
+    // Number of characters in a formatted address, not counting the null terminator
+    static const size_t Length = 2 + 2 * PointerSize;
+
+    // Writes the address and a null terminator into 'pBuffer', which must hold at least Length + 1
+    // characters. Returns Length. 32-bit targets only show the low 32 bits of 'address', like the
+    // C++ EE does.
+    static size_t Format(uint64_t address, wchar_t* pBuffer)
+    {
+        pBuffer[0] = L'0';
+        pBuffer[1] = L'x';
+
+        // The loop has a constant trip count, so the compiler fully unrolls it for each pointer size
+        wchar_t* pDigits = pBuffer + Length;
+        *pDigits = L'\0';
+        for (unsigned int i = 0; i < PointerSize; i++)
+        {
+            const wchar_t* pPair = AddressFormatDetail::HexPairs + 2 * (address & 0xff);
+            pDigits -= 2;
+            pDigits[0] = pPair[0];
+            pDigits[1] = pPair[1];
+            address >>= 8;
+        }
+
+        return Length;
+    }
+};
+
+// Large enough for an address of either pointer size, including the null terminator
+const size_t AddressFormatBufferLength = AddressFormat<8>::Length + 1;
+
+// Formats 'address' for a target with 'pointerSize' byte pointers into 'buffer'. Returns the number
+// of characters written, not counting the null terminator.
+inline size_t FormatAddress(uint64_t address, unsigned int pointerSize, wchar_t (&buffer)[AddressFormatBufferLength])
+{
+    if (pointerSize == 8)
+    {
+        return AddressFormat<8>::Format(address, buffer);
+    }
+
+    return AddressFormat<4>::Format(address, buffer);
+}
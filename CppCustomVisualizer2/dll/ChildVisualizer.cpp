@@ -2,21 +2,139 @@
 // Licensed under the MIT license. See LICENSE file in the project root for full license information.
 #include "stdafx.h"
 #include "ChildVisualizer.h"
+#include "MemoryCacheDataItem.h"
+#include "PerfTrace.h"
 
 HRESULT CChildVisualizer::Initialize(
     _In_ DkmVisualizedExpression* pVisualizedExpression,
+    _In_ const ParallelArrayPlan& plan,
     _In_ unsigned long long vectorSize,
-    _In_ unsigned long long parentIndex,
-    _In_ bool rootIsPointer
+    _In_ unsigned long long first,
+    _In_ bool rootIsPointer,
+    _In_reads_opt_(plan.Columns.size()) const VectorBounds* pBounds
 )
 {
     m_pVisualizedExpression = pVisualizedExpression;
+    m_plan = plan;
     m_vectorSize = vectorSize;
-    m_parentIndex = parentIndex;
+    m_first = first;
     m_fRootIsPointer = rootIsPointer;
+    if (pBounds != nullptr)
+    {
+        m_bounds.assign(pBounds, pBounds + plan.Columns.size());
+    }
     return S_OK;
 }
 
+void CChildVisualizer::SetRowIndices(
+    _In_reads_(count) const uint64_t* pRowIndices,
+    _In_ size_t count
+)
+{
+    m_rowIndices.assign(pRowIndices, pRowIndices + count);
+}
+
+void CChildVisualizer::SetPage(
+    _In_ unsigned long long first,
+    _In_ UINT32 count
+)
+{
+    ObjectLock lock(this);
+
+    m_fSequential = (m_pageCount != 0 && first == m_pageFirst + m_pageCount);
+    m_pageFirst = first;
+    m_pageCount = count;
+}
+
+void CChildVisualizer::GetPrefetchStatistics(
+    _Out_ UINT64* pHits,
+    _Out_ UINT64* pMisses
+)
+{
+    *pHits = (UINT64)m_prefetchHits;
+    *pMisses = (UINT64)m_prefetchMisses;
+}
+
+bool CChildVisualizer::TryGetRow(
+    _In_ unsigned long long index,
+    _Out_ ParallelArrayRow* pRow
+)
+{
+    unsigned long long first = index;
+    UINT32 count = 1;
+    UINT32 prefetchCount = 0;
+    {
+        ObjectLock lock(this);
+
+        for (size_t i = 0; i < 2; i++)
+        {
+            size_t window = (m_newestWindow + i) % 2;
+            if (m_windows[window].TryGetRow(m_plan, index, pRow))
+            {
+                if (index >= m_prefetchedFirst[window])
+                {
+                    InterlockedIncrement64(&m_prefetchHits);
+                }
+                return true;
+            }
+        }
+
+        if (m_bounds.empty() || index >= m_vectorSize)
+        {
+            return false;
+        }
+        InterlockedIncrement64(&m_prefetchMisses);
+
+        // Read the whole page which the row was listed in. Rows outside of it, such as those of
+        // '[Mismatches]', are read one at a time.
+        if (index >= m_pageFirst && index - m_pageFirst < m_pageCount)
+        {
+            first = m_pageFirst;
+            count = m_pageCount;
+
+            // Someone scrolling through the range is likely to expand rows of the next pages too
+            if (m_fSequential && first + count < m_vectorSize)
+            {
+                UINT32 rowSize = 0;
+                for (size_t i = 0; i < m_plan.Columns.size(); i++)
+                {
+                    rowSize += m_plan.Columns[i].ElementSize;
+                }
+
+                unsigned long long rows = min((unsigned long long)PrefetchPages * count, m_vectorSize - (first + count));
+                rows = min(rows, (unsigned long long)(PrefetchByteBudget / rowSize));
+                prefetchCount = (UINT32)rows;
+            }
+        }
+    }
+    CPerfTraceScope perfTrace("ReadRows", m_vectorSize, first, 0, count + prefetchCount);
+
+    DkmVisualizedExpression* pVisualizedExpression = m_pVisualizedExpression;
+    auto reader = [pVisualizedExpression](uint64_t address, void* pBuffer, uint32_t size) -> bool
+    {
+        return SUCCEEDED(CMemoryCacheDataItem::ReadMemory(pVisualizedExpression, address, pBuffer, size));
+    };
+
+    // Target memory is read without holding the lock, so that other rows can still be looked up
+    // in the windows meanwhile
+    ParallelArrayWindow window;
+    if (!ReadParallelArrayWindow(m_plan, m_bounds.data(), first, count + prefetchCount, reader, &window) &&
+        (prefetchCount == 0 || !ReadParallelArrayWindow(m_plan, m_bounds.data(), first, count, reader, &window)))
+    {
+        return false;
+    }
+    bool hasRow = window.TryGetRow(m_plan, index, pRow);
+
+    // Replace the older of the two windows. The window it replaces is freed once the lock is
+    // released.
+    ObjectLock lock(this);
+    std::swap(m_windows[1 - m_newestWindow], window);
+    m_newestWindow = 1 - m_newestWindow;
+    m_prefetchedFirst[m_newestWindow] = first + count;
+
+    return hasRow;
+}
+
 HRESULT CChildVisualizer::CreateEvaluationResult(
     _In_ DkmString* pName,
     _In_ DkmString* pFullName,
@@ -25,26 +143,12 @@ HRESULT CChildVisualizer::CreateEvaluationResult(
     _In_opt_ DkmVisualizedExpression* pParent,
     _In_ DkmInspectionContext* pInspectionContext,
     _In_ unsigned long long index,
-    _Deref_out_ DkmEvaluationResult** ppResultObject
+    _Deref_out_ DkmEvaluationResult** ppResultObject,
+    _Inout_ UINT64* pAllocations
 )
 {
     HRESULT hr = S_OK;
 
-    CComPtr<DkmPointerValueHome> pPointerValueHome = DkmPointerValueHome::TryCast(m_pVisualizedExpression->ValueHome());
-    if (pPointerValueHome == nullptr)
-    {
-        // This sample only handles visualizing in-memory Sample structures
-        return E_NOTIMPL;
-    }
-
-    // Create method for DkmDataAddress takes a runtime instance.
-    CComPtr<DkmDataAddress> pAddress;
-    hr = DkmDataAddress::Create(m_pVisualizedExpression->InspectionContext()->RuntimeInstance(), pPointerValueHome->Address(), NULL, &pAddress);
-    if (FAILED(hr))
-    {
-        return hr;
-    }
-
     CString strValue;
     strValue.Format(L"%llu", index);
 
@@ -54,6 +158,7 @@ HRESULT CChildVisualizer::CreateEvaluationResult(
     {
         return hr;
     }
+    (*pAllocations)++;
 
     CComPtr<DkmSuccessEvaluationResult> pSuccessEvaluationResult;
     hr = DkmSuccessEvaluationResult::Create(
@@ -79,6 +184,7 @@ HRESULT CChildVisualizer::CreateEvaluationResult(
     {
         return hr;
     }
+    (*pAllocations)++;
 
     *ppResultObject = (DkmEvaluationResult*)pSuccessEvaluationResult.Detach();
 
@@ -86,6 +192,7 @@ HRESULT CChildVisualizer::CreateEvaluationResult(
 }
 
 HRESULT CChildVisualizer::GetChildren(
+    _In_ DkmVisualizedExpression* pVisualizedExpression,
     _In_ UINT32 InitialRequestSize,
     _In_ DkmInspectionContext* pInspectionContext,
     _Out_ DkmArray<DkmChildVisualizedExpression*>* pInitialChildren,
@@ -96,8 +203,8 @@ HRESULT CChildVisualizer::GetChildren(
     pInitialChildren->Members = nullptr;
     pInitialChildren->Length = 0;
 
-    // A and B
-    UINT32 childCount = 2;
+    // One child per column
+    UINT32 childCount = (UINT32)m_plan.Columns.size();
 
     CComPtr<DkmEvaluationResultEnumContext> pEnumContext;
     hr = DkmEvaluationResultEnumContext::Create(
@@ -113,7 +220,7 @@ HRESULT CChildVisualizer::GetChildren(
 
     if (InitialRequestSize > 0)
     {
-        GetItems(m_pVisualizedExpression, pEnumContext, 0, childCount, pInitialChildren);
+        GetItems(pVisualizedExpression, pEnumContext, 0, childCount, pInitialChildren);
     }
 
     *ppEnumContext = pEnumContext.Detach();
@@ -121,10 +228,6 @@ HRESULT CChildVisualizer::GetChildren(
     return hr;
 }
 
-static LPCWSTR itemNames[2] = { L"A", L"B" };
-static LPCWSTR itemExprs[2] = { L"(%s).a[%llu]", L"(%s).b[%llu]" };
-static LPCWSTR itemExprsPtr[2] = { L"(%s)->a[%llu]", L"(%s)->b[%llu]" };
-
 HRESULT CChildVisualizer::GetItems(
     _In_ DkmVisualizedExpression* pVisualizedExpression,
     _In_ DkmEvaluationResultEnumContext* pEnumContext,
@@ -135,30 +238,48 @@ HRESULT CChildVisualizer::GetItems(
 {
     HRESULT hr = S_OK;
 
-    if (Count == 0 || StartIndex > 1 || StartIndex + Count > 2)
+    UINT32 columnCount = (UINT32)m_plan.Columns.size();
+    if (Count == 0 || StartIndex >= columnCount || Count > columnCount - StartIndex)
     {
         return E_INVALIDARG;
     }
 
-    CComPtr<DkmString> pType;
-    hr = DkmString::Create(DkmSourceString(L"int"), &pType);
+    CAutoDkmArray<DkmChildVisualizedExpression*> resultValues;
+    hr = DkmAllocArray(Count, &resultValues);
     if (FAILED(hr))
     {
         return hr;
     }
 
-    CAutoDkmArray<DkmChildVisualizedExpression*> resultValues;
-    hr = DkmAllocArray(Count, &resultValues);
-    if (FAILED(hr))
+    // This data item is shared by all the rows of a range, so find out which row is being expanded
+    CComPtr<DkmChildVisualizedExpression> pRowExpression = DkmChildVisualizedExpression::TryCast(pVisualizedExpression);
+    if (pRowExpression == nullptr)
     {
-        return hr;
+        return E_INVALIDARG;
     }
+    unsigned long long rowIndex;
+    if (m_rowIndices.empty())
+    {
+        rowIndex = m_first + pRowExpression->Index();
+    }
+    else if (pRowExpression->Index() < m_rowIndices.size())
+    {
+        rowIndex = m_rowIndices[pRowExpression->Index()];
+    }
+    else
+    {
+        return E_INVALIDARG;
+    }
+
+    ParallelArrayRow row;
+    bool hasRow = TryGetRow(rowIndex, &row);
 
-    CComPtr<DkmRootVisualizedExpression> pRootVisualizedExpression = DkmRootVisualizedExpression::TryCast(pVisualizedExpression);
+    // The item expressions are relative to the root object itself
+    CComPtr<DkmRootVisualizedExpression> pRootVisualizedExpression = DkmRootVisualizedExpression::TryCast(m_pVisualizedExpression);
     CComPtr<DkmString> pFullName;
     if (pRootVisualizedExpression == nullptr)
     {
-        hr = pVisualizedExpression->CreateDefaultChildFullName(0, &pFullName);
+        hr = m_pVisualizedExpression->CreateDefaultChildFullName(0, &pFullName);
         if (FAILED(hr))
         {
             return hr;
@@ -173,15 +294,16 @@ HRESULT CChildVisualizer::GetItems(
     {
         CString evalText;
 
-        UINT32 index = StartIndex + 1;
-        VSAnalysisAssume(index < _countof(itemExprsPtr) && index < _countof(itemExprs) , "Should be impossible: already validated at start of function");
+        UINT32 index = StartIndex + i;
+        VSAnalysisAssume(index < m_plan.Columns.size(), "Should be impossible: already validated at start of function");
+        const ParallelArrayColumn& column = m_plan.Columns[index];
         if (m_fRootIsPointer)
         {
-            evalText.Format(itemExprsPtr[index], pFullName->Value(), m_parentIndex);
+            evalText.Format(L"(%s)->%s[%llu]", pFullName->Value(), column.Member.c_str(), rowIndex);
         }
         else
         {
-            evalText.Format(itemExprs[index], pFullName->Value(), m_parentIndex);
+            evalText.Format(L"(%s).%s[%llu]", pFullName->Value(), column.Member.c_str(), rowIndex);
         }
         CComPtr<DkmString> pEvalText;
         hr = DkmString::Create(DkmSourceString(evalText), &pEvalText);
@@ -191,20 +313,45 @@ HRESULT CChildVisualizer::GetItems(
         }
 
         CComPtr<DkmString> pDisplayName;
-        hr = DkmString::Create(DkmSourceString(itemNames[index]), &pDisplayName);
+        hr = DkmString::Create(DkmSourceString(column.DisplayName.c_str()), &pDisplayName);
+        if (FAILED(hr))
+        {
+            return hr;
+        }
+
+        CComPtr<DkmString> pType;
+        hr = DkmString::Create(DkmSourceString(ColumnType::Get(column.Type).Name), &pType);
         if (FAILED(hr))
         {
             return hr;
         }
 
         CComPtr<DkmChildVisualizedExpression> pChildVisualizedExpression;
-        hr = CreateItemVisualizedExpression(
-            pEvalText,
-            pDisplayName,
-            pType,
-            index,
-            &pChildVisualizedExpression
-        );
+        if (hasRow)
+        {
+            hr = CreateItemFromValue(
+                pVisualizedExpression,
+                pEvalText,
+                pDisplayName,
+                pType,
+                index,
+                column.Type,
+                row.Values[index],
+                row.Addresses[index],
+                &pChildVisualizedExpression
+            );
+        }
+        else
+        {
+            hr = CreateItemVisualizedExpression(
+                pVisualizedExpression,
+                pEvalText,
+                pDisplayName,
+                pType,
+                index,
+                &pChildVisualizedExpression
+            );
+        }
         if (FAILED(hr))
         {
             return hr;
@@ -219,6 +366,7 @@ HRESULT CChildVisualizer::GetItems(
 }
 
 HRESULT CChildVisualizer::CreateItemVisualizedExpression(
+    _In_ DkmVisualizedExpression* pParent,
     _In_ DkmString* pEvalText,
     _In_ DkmString* pDisplayName,
     _In_ DkmString* pType,
@@ -291,7 +439,88 @@ HRESULT CChildVisualizer::CreateItemVisualizedExpression(
         m_pVisualizedExpression->StackFrame(),
         nullptr,
         pEvalResultNewName,
-        m_pVisualizedExpression,
+        pParent,
+        index,
+        this,
+        &pChildVisualizedExpression
+    );
+    if (FAILED(hr))
+    {
+        return hr;
+    }
+
+    *ppResult = pChildVisualizedExpression.Detach();
+
+    return hr;
+}
+
+HRESULT CChildVisualizer::CreateItemFromValue(
+    _In_ DkmVisualizedExpression* pParent,
+    _In_ DkmString* pFullName,
+    _In_ DkmString* pDisplayName,
+    _In_ DkmString* pType,
+    _In_ UINT32 index,
+    _In_ ColumnType::e type,
+    _In_ const uint8_t* pValue,
+    _In_ UINT64 address,
+    _Deref_out_ DkmChildVisualizedExpression** ppResult
+)
+{
+    HRESULT hr = S_OK;
+
+    DkmInspectionContext* pInspectionContext = m_pVisualizedExpression->InspectionContext();
+
+    WCHAR valueText[ColumnValueBufferLength];
+    FormatColumnValue(type, pValue, pInspectionContext->Radix() == 16, valueText);
+
+    CComPtr<DkmString> pValueString;
+    hr = DkmString::Create(DkmSourceString(valueText), &pValueString);
+    if (FAILED(hr))
+    {
+        return hr;
+    }
+
+    CComPtr<DkmDataAddress> pAddress;
+    hr = DkmDataAddress::Create(pInspectionContext->RuntimeInstance(), address, NULL, &pAddress);
+    if (FAILED(hr))
+    {
+        return hr;
+    }
+
+    CComPtr<DkmSuccessEvaluationResult> pEvaluationResult;
+    hr = DkmSuccessEvaluationResult::Create(
+        pInspectionContext,
+        m_pVisualizedExpression->StackFrame(),
+        pDisplayName,
+        pFullName,
+        DkmEvaluationResultFlags::ReadOnly,
+        pValueString,
+        pValueString,
+        pType,
+        DkmEvaluationResultCategory::Data,
+        DkmEvaluationResultAccessType::None,
+        DkmEvaluationResultStorageType::None,
+        DkmEvaluationResultTypeModifierFlags::None,
+        pAddress,
+        nullptr,
+        (DkmReadOnlyCollection<DkmModuleInstance*>*)nullptr,
+        DkmDataItem::Null(),
+        &pEvaluationResult
+    );
+    if (FAILED(hr))
+    {
+        return hr;
+    }
+
+    CComPtr<DkmChildVisualizedExpression> pChildVisualizedExpression;
+    hr = DkmChildVisualizedExpression::Create(
+        pInspectionContext,
+        m_pVisualizedExpression->VisualizerId(),
+        m_pVisualizedExpression->SourceId(),
+        m_pVisualizedExpression->StackFrame(),
+        nullptr,
+        pEvaluationResult,
+        pParent,
         index,
         this,
         &pChildVisualizedExpression
@@ -2,22 +2,65 @@
 // Licensed under the MIT license. See LICENSE file in the project root for full license information.
 #pragma once
 
+#include "ParallelArrays.h"
+
+// CChildVisualizer is the data item shared by all of the '[Index]' rows of one range (the root, one
+// bucket of it, or the '[Mismatches]' list). It only holds state which is the same for every row;
+// a row finds its own index from DkmChildVisualizedExpression::Index(). This keeps expanding a page
+// of rows down to the Dkm objects which Concord itself needs. The children of a row are the columns
+// of the root's ParallelArrayPlan.
+//
+// The values of the rows are not read when a page of rows is listed, so scrolling through a large
+// range never waits on target memory. They are read the first time a row of the page is expanded,
+// for the whole page at once. If the pages were listed one after the other, the next PrefetchPages
+// pages are read along with it, so that expanding rows further down doesn't go back to the target.
 class ATL_NO_VTABLE __declspec(uuid("61131513-4f8d-4d5f-a2e3-8e346fe5ff20")) CChildVisualizer :
     public IUnknown,
     public CComObjectRootEx<CComMultiThreadModel>
 {
 private:
     CComPtr<DkmVisualizedExpression> m_pVisualizedExpression;
+    // The columns of the root's type, which are the children of every row
+    ParallelArrayPlan m_plan;
     unsigned long long m_vectorSize;
-    unsigned long long m_parentIndex;
+    unsigned long long m_first;
     bool m_fRootIsPointer;
+    // If not empty, the row listed at position i is m_rowIndices[i] rather than m_first + i
+    std::vector<uint64_t> m_rowIndices;
+    // Begin/end/capacity of each column, indexed like m_plan.Columns. Empty if the vectors can't be
+    // read from target memory, in which case the rows are evaluated with the EE when expanded.
+    std::vector<VectorBounds> m_bounds;
+
+    // The rows of the last page listed by GetItems, which are read together when one of them is
+    // first expanded
+    uint64_t m_pageFirst;
+    uint32_t m_pageCount;
+    // Set if the last page listed started where the one before it ended
+    bool m_fSequential;
+    // The two most recently read windows of rows. Keeping the previous one means going back to a
+    // row of the page before doesn't read it again.
+    ParallelArrayWindow m_windows[2];
+    size_t m_newestWindow;
+    // The first row of each window which was read ahead rather than asked for
+    uint64_t m_prefetchedFirst[2];
+    // Rows found in the rows read ahead, and reads of target memory for rows which weren't in
+    // either window, for tuning
+    volatile LONG64 m_prefetchHits;
+    volatile LONG64 m_prefetchMisses;
 
 public:
     CChildVisualizer()
     {
         m_vectorSize = 0;
-        m_parentIndex = 0;
+        m_first = 0;
         m_fRootIsPointer = false;
+        m_pageFirst = 0;
+        m_pageCount = 0;
+        m_fSequential = false;
+        m_newestWindow = 0;
+        m_prefetchedFirst[0] = m_prefetchedFirst[1] = 0;
+        m_prefetchHits = 0;
+        m_prefetchMisses = 0;
     }
     ~CChildVisualizer()
     {
@@ -26,11 +69,38 @@ public:
     DECLARE_NO_REGISTRY();
     DECLARE_NOT_AGGREGATABLE(CChildVisualizer);
 
+    // Number of pages read ahead of the one expanded when the pages are listed in order, and the
+    // most that is read ahead at once, over all columns
+    static const UINT32 PrefetchPages = 2;
+    static const UINT32 PrefetchByteBudget = 1024 * 1024;
+
     HRESULT STDMETHODCALLTYPE Initialize(
         _In_ DkmVisualizedExpression* pVisualizedExpression,
+        _In_ const ParallelArrayPlan& plan,
         _In_ unsigned long long vectorSize,
-        _In_ unsigned long long parentIndex,
-        _In_ bool rootIsPointer
+        _In_ unsigned long long first,
+        _In_ bool rootIsPointer,
+        _In_reads_opt_(plan.Columns.size()) const VectorBounds* pBounds
+    );
+
+    // List the rows 'pRowIndices' instead of a contiguous range
+    void SetRowIndices(
+        _In_reads_(count) const uint64_t* pRowIndices,
+        _In_ size_t count
+    );
+
+    // Remember that the rows [first, first + count) were listed, so that their values are read
+    // together when one of them is expanded
+    void SetPage(
+        _In_ unsigned long long first,
+        _In_ UINT32 count
+    );
+
+    // Returns how many expanded rows were found in rows read ahead, and how many times rows had to
+    // be read from target memory when expanded
+    void GetPrefetchStatistics(
+        _Out_ UINT64* pHits,
+        _Out_ UINT64* pMisses
     );
 
     HRESULT STDMETHODCALLTYPE CreateEvaluationResult(
@@ -41,9 +111,11 @@ public:
         _In_opt_ Evaluation::DkmVisualizedExpression* pParent,
         _In_ Evaluation::DkmInspectionContext* pInspectionContext,
         _In_ unsigned long long index,
-        _Deref_out_ Evaluation::DkmEvaluationResult** ppResultObject
+        _Deref_out_ Evaluation::DkmEvaluationResult** ppResultObject,
+        _Inout_ UINT64* pAllocations
     );
     HRESULT STDMETHODCALLTYPE GetChildren(
+        _In_ Evaluation::DkmVisualizedExpression* pVisualizedExpression,
         _In_ UINT32 InitialRequestSize,
         _In_ Evaluation::DkmInspectionContext* pInspectionContext,
         _Out_ DkmArray<Evaluation::DkmChildVisualizedExpression*>* pInitialChildren,
@@ -75,11 +147,33 @@ protected:
     }
 
 private:
+    // Copies the values of row 'index' into 'pRow', reading them from target memory if they aren't
+    // in one of the windows yet. Returns false if the row has to be evaluated with the EE.
+    bool TryGetRow(
+        _In_ unsigned long long index,
+        _Out_ ParallelArrayRow* pRow
+    );
+
     HRESULT STDMETHODCALLTYPE CreateItemVisualizedExpression(
+        _In_ DkmVisualizedExpression* pParent,
         _In_ DkmString* pEvalText,
         _In_ DkmString* pDisplayName,
         _In_ DkmString* pType,
         _In_ UINT32 index,
         _Deref_out_ DkmChildVisualizedExpression** ppResult
     );
+
+    // Create the child for an item whose value was already read from target memory. Unlike
+    // CreateItemVisualizedExpression, this doesn't go through the EE.
+    HRESULT STDMETHODCALLTYPE CreateItemFromValue(
+        _In_ DkmVisualizedExpression* pParent,
+        _In_ DkmString* pFullName,
+        _In_ DkmString* pDisplayName,
+        _In_ DkmString* pType,
+        _In_ UINT32 index,
+        _In_ ColumnType::e type,
+        _In_ const uint8_t* pValue,
+        _In_ UINT64 address,
+        _Deref_out_ DkmChildVisualizedExpression** ppResult
+    );
 };
\ No newline at end of file
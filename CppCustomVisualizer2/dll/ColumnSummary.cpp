@@ -0,0 +1,387 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+// ColumnSummary.cpp : min/max/sum/NaN reduction and mismatch kernels for the columns of a parallel
+// arrays object. This file doesn't use the precompiled header so that it stays portable.
+
+#include "ColumnSummary.h"
+#include <limits>
+
+#if defined(_M_X64) || defined(__x86_64__)
+#define COLUMNSUMMARY_HAS_AVX2_PATH 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define COLUMNSUMMARY_TARGET_AVX2
+#else
+#define COLUMNSUMMARY_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+namespace
+{
+    // Result of reducing one run of elements of type T
+    template <class T>
+    struct Reduction
+    {
+        T Min;
+        T Max;
+        double Sum;
+        uint64_t NaNCount;
+    };
+
+    template <class T>
+    bool IsNaN(T value)
+    {
+        // Only true for floating point NaNs
+        return value != value;
+    }
+
+    template <class T>
+    void ReduceScalar(const T* pValues, size_t count, Reduction<T>* pResult)
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            T value = pValues[i];
+            if (IsNaN(value))
+            {
+                pResult->NaNCount++;
+                continue;
+            }
+
+            pResult->Min = (value < pResult->Min) ? value : pResult->Min;
+            pResult->Max = (value > pResult->Max) ? value : pResult->Max;
+            pResult->Sum += (double)value;
+        }
+    }
+
+    void FindMismatchesScalar(const uint8_t* pFirst, const uint8_t* pOther, size_t count, uint32_t elementSize, uint64_t baseIndex, size_t maxIndices, std::vector<uint64_t>* pIndices)
+    {
+        for (size_t i = 0; i < count && pIndices->size() < maxIndices; i++)
+        {
+            if (memcmp(pFirst + i * elementSize, pOther + i * elementSize, elementSize) != 0)
+            {
+                pIndices->push_back(baseIndex + i);
+            }
+        }
+    }
+
+#if COLUMNSUMMARY_HAS_AVX2_PATH
+
+    bool IsAvx2Supported()
+    {
+#if defined(_MSC_VER)
+        int info[4];
+        __cpuid(info, 0);
+        if (info[0] < 7)
+        {
+            return false;
+        }
+
+        // The OS also needs to save the YMM registers on context switches
+        __cpuid(info, 1);
+        const int osxsave = 1 << 27;
+        const int avx = 1 << 28;
+        if ((info[2] & (osxsave | avx)) != (osxsave | avx) || (_xgetbv(0) & 6) != 6)
+        {
+            return false;
+        }
+
+        __cpuidex(info, 7, 0);
+        return (info[1] & (1 << 5)) != 0;
+#else
+        return __builtin_cpu_supports("avx2") != 0;
+#endif
+    }
+
+    inline uint64_t CountBits(unsigned int mask)
+    {
+        uint64_t count = 0;
+        for (; mask != 0; mask &= mask - 1)
+        {
+            count++;
+        }
+        return count;
+    }
+
+    // Integer sums are kept in 64-bit lanes. A run of int32 elements would need 2^32 elements to
+    // overflow them, and SummarizeParallelArrays hands over at most a chunk at a time.
+    COLUMNSUMMARY_TARGET_AVX2 void ReduceInt32Avx2(const int32_t* pValues, size_t count, Reduction<int32_t>* pResult)
+    {
+        __m256i min = _mm256_set1_epi32(pResult->Min);
+        __m256i max = _mm256_set1_epi32(pResult->Max);
+        __m256i sumLow = _mm256_setzero_si256();
+        __m256i sumHigh = _mm256_setzero_si256();
+
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8)
+        {
+            __m256i values = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pValues + i));
+            min = _mm256_min_epi32(min, values);
+            max = _mm256_max_epi32(max, values);
+            sumLow = _mm256_add_epi64(sumLow, _mm256_cvtepi32_epi64(_mm256_castsi256_si128(values)));
+            sumHigh = _mm256_add_epi64(sumHigh, _mm256_cvtepi32_epi64(_mm256_extracti128_si256(values, 1)));
+        }
+
+        int32_t mins[8];
+        int32_t maxs[8];
+        int64_t sums[4];
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(mins), min);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(maxs), max);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(sums), _mm256_add_epi64(sumLow, sumHigh));
+
+        int64_t sum = sums[0] + sums[1] + sums[2] + sums[3];
+        for (int lane = 0; lane < 8; lane++)
+        {
+            pResult->Min = (mins[lane] < pResult->Min) ? mins[lane] : pResult->Min;
+            pResult->Max = (maxs[lane] > pResult->Max) ? maxs[lane] : pResult->Max;
+        }
+        pResult->Sum += (double)sum;
+
+        ReduceScalar(pValues + i, count - i, pResult);
+    }
+
+    // NaNs are replaced with +inf for the minimum, -inf for the maximum and 0 for the sum, so that
+    // they don't take part. Sums are kept in double precision.
+    COLUMNSUMMARY_TARGET_AVX2 void ReduceFloatAvx2(const float* pValues, size_t count, Reduction<float>* pResult)
+    {
+        const __m256 positiveInfinity = _mm256_set1_ps(std::numeric_limits<float>::infinity());
+        const __m256 negativeInfinity = _mm256_set1_ps(-std::numeric_limits<float>::infinity());
+
+        __m256 min = _mm256_set1_ps(pResult->Min);
+        __m256 max = _mm256_set1_ps(pResult->Max);
+        __m256d sumLow = _mm256_setzero_pd();
+        __m256d sumHigh = _mm256_setzero_pd();
+        uint64_t nanCount = 0;
+
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8)
+        {
+            __m256 values = _mm256_loadu_ps(pValues + i);
+            __m256 isNumber = _mm256_cmp_ps(values, values, _CMP_ORD_Q);
+            nanCount += CountBits(~(unsigned int)_mm256_movemask_ps(isNumber) & 0xff);
+
+            min = _mm256_min_ps(min, _mm256_blendv_ps(positiveInfinity, values, isNumber));
+            max = _mm256_max_ps(max, _mm256_blendv_ps(negativeInfinity, values, isNumber));
+
+            __m256 numbers = _mm256_and_ps(values, isNumber);
+            sumLow = _mm256_add_pd(sumLow, _mm256_cvtps_pd(_mm256_castps256_ps128(numbers)));
+            sumHigh = _mm256_add_pd(sumHigh, _mm256_cvtps_pd(_mm256_extractf128_ps(numbers, 1)));
+        }
+
+        float mins[8];
+        float maxs[8];
+        double sums[4];
+        _mm256_storeu_ps(mins, min);
+        _mm256_storeu_ps(maxs, max);
+        _mm256_storeu_pd(sums, _mm256_add_pd(sumLow, sumHigh));
+
+        for (int lane = 0; lane < 8; lane++)
+        {
+            pResult->Min = (mins[lane] < pResult->Min) ? mins[lane] : pResult->Min;
+            pResult->Max = (maxs[lane] > pResult->Max) ? maxs[lane] : pResult->Max;
+        }
+        pResult->Sum += sums[0] + sums[1] + sums[2] + sums[3];
+        pResult->NaNCount += nanCount;
+
+        ReduceScalar(pValues + i, count - i, pResult);
+    }
+
+    COLUMNSUMMARY_TARGET_AVX2 void ReduceDoubleAvx2(const double* pValues, size_t count, Reduction<double>* pResult)
+    {
+        const __m256d positiveInfinity = _mm256_set1_pd(std::numeric_limits<double>::infinity());
+        const __m256d negativeInfinity = _mm256_set1_pd(-std::numeric_limits<double>::infinity());
+
+        __m256d min = _mm256_set1_pd(pResult->Min);
+        __m256d max = _mm256_set1_pd(pResult->Max);
+        __m256d sum = _mm256_setzero_pd();
+        uint64_t nanCount = 0;
+
+        size_t i = 0;
+        for (; i + 4 <= count; i += 4)
+        {
+            __m256d values = _mm256_loadu_pd(pValues + i);
+            __m256d isNumber = _mm256_cmp_pd(values, values, _CMP_ORD_Q);
+            nanCount += CountBits(~(unsigned int)_mm256_movemask_pd(isNumber) & 0xf);
+
+            min = _mm256_min_pd(min, _mm256_blendv_pd(positiveInfinity, values, isNumber));
+            max = _mm256_max_pd(max, _mm256_blendv_pd(negativeInfinity, values, isNumber));
+            sum = _mm256_add_pd(sum, _mm256_and_pd(values, isNumber));
+        }
+
+        double mins[4];
+        double maxs[4];
+        double sums[4];
+        _mm256_storeu_pd(mins, min);
+        _mm256_storeu_pd(maxs, max);
+        _mm256_storeu_pd(sums, sum);
+
+        for (int lane = 0; lane < 4; lane++)
+        {
+            pResult->Min = (mins[lane] < pResult->Min) ? mins[lane] : pResult->Min;
+            pResult->Max = (maxs[lane] > pResult->Max) ? maxs[lane] : pResult->Max;
+        }
+        pResult->Sum += sums[0] + sums[1] + sums[2] + sums[3];
+        pResult->NaNCount += nanCount;
+
+        ReduceScalar(pValues + i, count - i, pResult);
+    }
+
+    // Compares 32 bytes at a time. Element sizes are powers of two up to 8, so a block never
+    // splits an element, and only blocks which differ somewhere are looked at element by element.
+    COLUMNSUMMARY_TARGET_AVX2 void FindMismatchesAvx2(const uint8_t* pFirst, const uint8_t* pOther, size_t count, uint32_t elementSize, uint64_t baseIndex, size_t maxIndices, std::vector<uint64_t>* pIndices)
+    {
+        const size_t BlockSize = 32;
+        const size_t elementsPerBlock = BlockSize / elementSize;
+        const unsigned int elementMask = (1u << elementSize) - 1;
+
+        size_t size = count * elementSize;
+        size_t offset = 0;
+        for (; offset + BlockSize <= size && pIndices->size() < maxIndices; offset += BlockSize)
+        {
+            __m256i first = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pFirst + offset));
+            __m256i other = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(pOther + offset));
+            unsigned int differences = ~(unsigned int)_mm256_movemask_epi8(_mm256_cmpeq_epi8(first, other));
+            if (differences == 0)
+            {
+                continue;
+            }
+
+            size_t index = offset / elementSize;
+            for (size_t i = 0; i < elementsPerBlock && pIndices->size() < maxIndices; i++)
+            {
+                if (((differences >> (i * elementSize)) & elementMask) != 0)
+                {
+                    pIndices->push_back(baseIndex + index + i);
+                }
+            }
+        }
+
+        size_t index = offset / elementSize;
+        FindMismatchesScalar(pFirst + offset, pOther + offset, count - index, elementSize, baseIndex + index, maxIndices, pIndices);
+    }
+
+    const bool s_fAvx2Supported = IsAvx2Supported();
+
+#endif
+
+    template <class T>
+    void Reduce(const T* pValues, size_t count, Reduction<T>* pResult)
+    {
+        ReduceScalar(pValues, count, pResult);
+    }
+
+#if COLUMNSUMMARY_HAS_AVX2_PATH
+    template <>
+    void Reduce<int32_t>(const int32_t* pValues, size_t count, Reduction<int32_t>* pResult)
+    {
+        s_fAvx2Supported ? ReduceInt32Avx2(pValues, count, pResult) : ReduceScalar(pValues, count, pResult);
+    }
+
+    template <>
+    void Reduce<float>(const float* pValues, size_t count, Reduction<float>* pResult)
+    {
+        s_fAvx2Supported ? ReduceFloatAvx2(pValues, count, pResult) : ReduceScalar(pValues, count, pResult);
+    }
+
+    template <>
+    void Reduce<double>(const double* pValues, size_t count, Reduction<double>* pResult)
+    {
+        s_fAvx2Supported ? ReduceDoubleAvx2(pValues, count, pResult) : ReduceScalar(pValues, count, pResult);
+    }
+#endif
+
+    // Reduces the elements and merges the result into the summary. Elements are copied out in
+    // blocks, since the column buffers are not necessarily aligned for T.
+    template <class T>
+    void Summarize(const uint8_t* pValues, size_t count, ColumnSummary* pSummary)
+    {
+        const size_t BlockSize = 1024;
+
+        Reduction<T> result;
+        if (pSummary->HasValues())
+        {
+            memcpy(&result.Min, pSummary->Min, sizeof(T));
+            memcpy(&result.Max, pSummary->Max, sizeof(T));
+        }
+        else if (std::numeric_limits<T>::has_infinity)
+        {
+            result.Min = std::numeric_limits<T>::infinity();
+            result.Max = -std::numeric_limits<T>::infinity();
+        }
+        else
+        {
+            result.Min = (std::numeric_limits<T>::max)();
+            result.Max = (std::numeric_limits<T>::min)();
+        }
+        result.Sum = 0;
+        result.NaNCount = 0;
+
+        T block[BlockSize];
+        for (size_t i = 0; i < count; i += BlockSize)
+        {
+            size_t blockCount = (count - i < BlockSize) ? count - i : BlockSize;
+            memcpy(block, pValues + i * sizeof(T), blockCount * sizeof(T));
+            Reduce(block, blockCount, &result);
+        }
+
+        pSummary->Count += count;
+        pSummary->NaNCount += result.NaNCount;
+        pSummary->Sum += result.Sum;
+        if (pSummary->HasValues())
+        {
+            memcpy(pSummary->Min, &result.Min, sizeof(T));
+            memcpy(pSummary->Max, &result.Max, sizeof(T));
+        }
+    }
+}
+
+void SummarizeColumnValues(ColumnType::e type, const uint8_t* pValues, size_t count, ColumnSummary* pSummary)
+{
+    switch (type)
+    {
+    case ColumnType::Int8:
+        Summarize<int8_t>(pValues, count, pSummary);
+        break;
+    case ColumnType::UInt8:
+        Summarize<uint8_t>(pValues, count, pSummary);
+        break;
+    case ColumnType::Int16:
+        Summarize<int16_t>(pValues, count, pSummary);
+        break;
+    case ColumnType::UInt16:
+        Summarize<uint16_t>(pValues, count, pSummary);
+        break;
+    case ColumnType::Int32:
+        Summarize<int32_t>(pValues, count, pSummary);
+        break;
+    case ColumnType::UInt32:
+        Summarize<uint32_t>(pValues, count, pSummary);
+        break;
+    case ColumnType::Int64:
+        Summarize<int64_t>(pValues, count, pSummary);
+        break;
+    case ColumnType::UInt64:
+        Summarize<uint64_t>(pValues, count, pSummary);
+        break;
+    case ColumnType::Float:
+        Summarize<float>(pValues, count, pSummary);
+        break;
+    case ColumnType::Double:
+        Summarize<double>(pValues, count, pSummary);
+        break;
+    }
+}
+
+void FindMismatchingElements(const uint8_t* pFirst, const uint8_t* pOther, size_t count, uint32_t elementSize, uint64_t baseIndex, size_t maxIndices, std::vector<uint64_t>* pIndices)
+{
+#if COLUMNSUMMARY_HAS_AVX2_PATH
+    if (s_fAvx2Supported)
+    {
+        FindMismatchesAvx2(pFirst, pOther, count, elementSize, baseIndex, maxIndices, pIndices);
+        return;
+    }
+#endif
+
+    FindMismatchesScalar(pFirst, pOther, count, elementSize, baseIndex, maxIndices, pIndices);
+}
@@ -0,0 +1,253 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+#pragma once
+
+// This file computes summary statistics (min, max, sum, NaN count, and whether a column is
+// bitwise equal to the first one) over the columns of a parallel arrays object, and finds the rows
+// where the columns differ. The kernels are in ColumnSummary.cpp, which is built without the
+// precompiled header and uses AVX2 when the processor supports it: for int, float and double
+// columns, and for comparing columns. Like ParallelArrays.h, this only depends on the C++
+// standard library.
+
+#include "ParallelArrays.h"
+#include <algorithm>
+
+// Summary of the elements of one column which have been folded in so far
+struct ColumnSummary
+{
+    // Number of elements, including NaNs
+    uint64_t Count;
+    // Number of NaN elements. Always 0 for integer columns.
+    uint64_t NaNCount;
+    // The smallest and largest element, in the column's own representation so that they can be
+    // shown with FormatColumnValue. Only valid if Count > NaNCount.
+    uint8_t Min[8];
+    uint8_t Max[8];
+    // Sum of all elements which are not NaN
+    double Sum;
+
+    ColumnSummary()
+    {
+        memset(this, 0, sizeof(*this));
+    }
+
+    bool HasValues() const
+    {
+        return Count > NaNCount;
+    }
+
+    double Mean() const
+    {
+        return HasValues() ? Sum / (double)(Count - NaNCount) : 0;
+    }
+};
+
+// Folds the 'count' elements of 'type' at 'pValues' into 'pSummary'
+void SummarizeColumnValues(ColumnType::e type, const uint8_t* pValues, size_t count, ColumnSummary* pSummary);
+
+// Summary of all of the columns of one object
+struct ParallelArraySummary
+{
+    // Indexed like plan.Columns
+    std::vector<ColumnSummary> Columns;
+    // Indexed like plan.Columns. Whether the column has the same type as the first column and is
+    // bitwise equal to it over the rows summarized.
+    std::vector<bool> EqualsFirst;
+    // Number of rows summarized
+    uint64_t RowCount;
+    // False if not all of the rows were summarized, because the budget or the time ran out or
+    // target memory could not be read
+    bool Complete;
+
+    ParallelArraySummary() :
+        RowCount(0),
+        Complete(false)
+    {
+    }
+};
+
+// Summarizes rows [0, rowCount) of the columns 'pBounds' (indexed like plan.Columns, as returned
+// by ReadParallelArrayBounds). The columns are streamed in chunks of at most ChunkSize bytes, each
+// read with one call to 'reader'. Stops early once reading the next chunk would go over
+// 'byteBudget' bytes in total, or when 'shouldStop()' returns true, which is checked after every
+// chunk.
+template <class TReader, class TShouldStop>
+void SummarizeParallelArrays(const ParallelArrayPlan& plan, const VectorBounds* pBounds, uint64_t rowCount, uint64_t byteBudget, TReader& reader, TShouldStop& shouldStop, ParallelArraySummary* pSummary)
+{
+    const uint32_t ChunkSize = 1024 * 1024;
+
+    size_t columnCount = plan.Columns.size();
+    pSummary->Columns.assign(columnCount, ColumnSummary());
+    pSummary->EqualsFirst.assign(columnCount, false);
+    pSummary->RowCount = 0;
+    pSummary->Complete = false;
+    if (columnCount == 0)
+    {
+        return;
+    }
+
+    uint32_t rowSize = 0;
+    uint32_t maxElementSize = 0;
+    for (size_t i = 0; i < columnCount; i++)
+    {
+        rowSize += plan.Columns[i].ElementSize;
+        maxElementSize = (plan.Columns[i].ElementSize > maxElementSize) ? plan.Columns[i].ElementSize : maxElementSize;
+        pSummary->EqualsFirst[i] = (i != 0 && plan.Columns[i].Type == plan.Columns[0].Type);
+    }
+
+    uint32_t rowsPerChunk = ChunkSize / maxElementSize;
+    std::vector<std::vector<uint8_t>> chunks(columnCount);
+    for (size_t i = 0; i < columnCount; i++)
+    {
+        chunks[i].resize((size_t)rowsPerChunk * plan.Columns[i].ElementSize);
+    }
+
+    uint64_t bytesRead = 0;
+    uint64_t row = 0;
+    while (row < rowCount)
+    {
+        uint32_t rows = (rowCount - row < rowsPerChunk) ? (uint32_t)(rowCount - row) : rowsPerChunk;
+        if (bytesRead + (uint64_t)rows * rowSize > byteBudget)
+        {
+            return;
+        }
+
+        for (size_t i = 0; i < columnCount; i++)
+        {
+            uint32_t elementSize = plan.Columns[i].ElementSize;
+            if (!reader(pBounds[i].First + row * elementSize, chunks[i].data(), rows * elementSize))
+            {
+                return;
+            }
+        }
+        bytesRead += (uint64_t)rows * rowSize;
+
+        for (size_t i = 0; i < columnCount; i++)
+        {
+            SummarizeColumnValues(plan.Columns[i].Type, chunks[i].data(), rows, &pSummary->Columns[i]);
+
+            // memcmp is already vectorized by the CRT
+            if (pSummary->EqualsFirst[i] && memcmp(chunks[i].data(), chunks[0].data(), (size_t)rows * plan.Columns[i].ElementSize) != 0)
+            {
+                pSummary->EqualsFirst[i] = false;
+            }
+        }
+
+        row += rows;
+        pSummary->RowCount = row;
+
+        if (row < rowCount && shouldStop())
+        {
+            return;
+        }
+    }
+
+    pSummary->Complete = true;
+}
+
+// Appends the indices of the elements which are not bitwise equal between 'pFirst' and 'pOther'
+// (both 'count' elements of 'elementSize' bytes) to 'pIndices', offset by 'baseIndex', until
+// 'pIndices' holds 'maxIndices' entries.
+void FindMismatchingElements(const uint8_t* pFirst, const uint8_t* pOther, size_t count, uint32_t elementSize, uint64_t baseIndex, size_t maxIndices, std::vector<uint64_t>* pIndices);
+
+// Rows of a parallel arrays object where a column differs from the first column
+struct ParallelArrayMismatches
+{
+    // In increasing order
+    std::vector<uint64_t> Rows;
+    // Number of rows scanned. Rows past this may have mismatches which were not looked for.
+    uint64_t RowCount;
+    // Set if the scan stopped because 'maxMismatches' rows were found
+    bool ReachedLimit;
+
+    ParallelArrayMismatches() :
+        RowCount(0),
+        ReachedLimit(false)
+    {
+    }
+};
+
+// Finds the first 'maxMismatches' rows in [0, rowCount) where a column which has the same type
+// as the first column is not bitwise equal to it. Other columns are not compared. The columns are
+// streamed in chunks and limited by 'byteBudget' and 'shouldStop()' the same way as
+// SummarizeParallelArrays.
+template <class TReader, class TShouldStop>
+void FindParallelArrayMismatches(const ParallelArrayPlan& plan, const VectorBounds* pBounds, uint64_t rowCount, size_t maxMismatches, uint64_t byteBudget, TReader& reader, TShouldStop& shouldStop, ParallelArrayMismatches* pMismatches)
+{
+    const uint32_t ChunkSize = 1024 * 1024;
+
+    pMismatches->Rows.clear();
+    pMismatches->RowCount = 0;
+    pMismatches->ReachedLimit = false;
+
+    std::vector<size_t> compared;
+    for (size_t i = 1; i < plan.Columns.size(); i++)
+    {
+        if (plan.Columns[i].Type == plan.Columns[0].Type)
+        {
+            compared.push_back(i);
+        }
+    }
+    if (compared.empty() || maxMismatches == 0)
+    {
+        return;
+    }
+
+    uint32_t elementSize = plan.Columns[0].ElementSize;
+    uint32_t rowsPerChunk = ChunkSize / elementSize;
+    std::vector<uint8_t> firstChunk((size_t)rowsPerChunk * elementSize);
+    std::vector<uint8_t> otherChunk((size_t)rowsPerChunk * elementSize);
+    std::vector<uint64_t> chunkRows;
+
+    uint64_t bytesRead = 0;
+    uint64_t row = 0;
+    while (row < rowCount)
+    {
+        uint32_t rows = (rowCount - row < rowsPerChunk) ? (uint32_t)(rowCount - row) : rowsPerChunk;
+        uint64_t chunkBytes = (uint64_t)rows * elementSize * (compared.size() + 1);
+        if (bytesRead + chunkBytes > byteBudget ||
+            !reader(pBounds[0].First + row * elementSize, firstChunk.data(), rows * elementSize))
+        {
+            return;
+        }
+
+        // Each compared column contributes its mismatches in this chunk. Only the first ones of
+        // the chunk as a whole are kept.
+        size_t remaining = maxMismatches - pMismatches->Rows.size();
+        chunkRows.clear();
+        for (size_t i = 0; i < compared.size(); i++)
+        {
+            if (!reader(pBounds[compared[i]].First + row * elementSize, otherChunk.data(), rows * elementSize))
+            {
+                return;
+            }
+
+            size_t previousCount = chunkRows.size();
+            FindMismatchingElements(firstChunk.data(), otherChunk.data(), rows, elementSize, row, previousCount + remaining, &chunkRows);
+            if (previousCount != 0 && chunkRows.size() != previousCount)
+            {
+                std::inplace_merge(chunkRows.begin(), chunkRows.begin() + previousCount, chunkRows.end());
+                chunkRows.erase(std::unique(chunkRows.begin(), chunkRows.end()), chunkRows.end());
+            }
+        }
+        bytesRead += chunkBytes;
+
+        if (chunkRows.size() >= remaining)
+        {
+            // Everything up to the last mismatch kept has been looked at
+            pMismatches->Rows.insert(pMismatches->Rows.end(), chunkRows.begin(), chunkRows.begin() + remaining);
+            pMismatches->RowCount = pMismatches->Rows.back() + 1;
+            pMismatches->ReachedLimit = true;
+            return;
+        }
+
+        pMismatches->Rows.insert(pMismatches->Rows.end(), chunkRows.begin(), chunkRows.end());
+        row += rows;
+        pMismatches->RowCount = row;
+
+        if (row < rowCount && shouldStop())
+        {
+            return;
+        }
+    }
+}
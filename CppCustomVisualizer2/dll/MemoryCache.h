@@ -0,0 +1,182 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+#pragma once
+
+// This file defines MemoryPageCache, a page-granular cache of target memory. It intentionally only
+// depends on the C++ standard library so that it can be compiled outside of the debugger, for
+// example against a byte buffer which stands in for the target process.
+
+#include <stdint.h>
+#include <string.h>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+class MemoryPageCache
+{
+public:
+    static const uint32_t PageSize = 0x1000;
+
+    // Once this many pages are cached, the cache is flushed before caching more
+    static const size_t MaxPages = 4096;
+
+    MemoryPageCache() :
+        m_hits(0),
+        m_misses(0),
+        m_exactReads(0)
+    {
+    }
+
+    // Reads 'size' bytes at 'address' into 'pBuffer'. Pages which are not cached yet are fetched
+    // with 'reader', which is called as 'bool reader(uint64_t address, void* pBuffer, uint32_t size)'.
+    // Adjacent missing pages are fetched with one call. If one of the pages can't be read whole,
+    // exactly the requested bytes are read instead: a minidump captures ranges which aren't page
+    // aligned (ex: the stack from the stack pointer, or a heap block). Returns false if any of the
+    // bytes could not be read.
+    template <class TReader>
+    bool Read(uint64_t address, void* pBuffer, uint32_t size, TReader& reader)
+    {
+        if (size == 0)
+        {
+            return true;
+        }
+
+        uint64_t lastAddress = address + size - 1;
+        if (lastAddress < address)
+        {
+            return false;
+        }
+
+        uint64_t firstPage = address / PageSize;
+        uint64_t lastPage = lastAddress / PageSize;
+
+        if (m_pages.size() + (lastPage - firstPage + 1) > MaxPages)
+        {
+            m_pages.clear();
+        }
+
+        // Fetch each run of missing pages with a single read
+        uint64_t page = firstPage;
+        while (page <= lastPage)
+        {
+            if (m_pages.find(page) != m_pages.end())
+            {
+                m_hits++;
+                page++;
+                continue;
+            }
+
+            uint64_t runEnd = page + 1;
+            while (runEnd <= lastPage && m_pages.find(runEnd) == m_pages.end())
+            {
+                runEnd++;
+            }
+
+            m_misses += runEnd - page;
+            FetchRun(page, (uint32_t)(runEnd - page), reader);
+            page = runEnd;
+        }
+
+        for (page = firstPage; page <= lastPage; page++)
+        {
+            if (!m_pages[page].Bytes)
+            {
+                m_exactReads++;
+                return reader(address, pBuffer, size);
+            }
+        }
+
+        // Copy the requested bytes out of the cached pages
+        uint8_t* pDest = static_cast<uint8_t*>(pBuffer);
+        uint64_t current = address;
+        uint32_t remaining = size;
+        while (remaining != 0)
+        {
+            const Page& cachedPage = m_pages[current / PageSize];
+
+            uint32_t offset = (uint32_t)(current % PageSize);
+            uint32_t chunk = PageSize - offset;
+            if (chunk > remaining)
+            {
+                chunk = remaining;
+            }
+
+            memcpy(pDest, cachedPage.Bytes.get() + offset, chunk);
+            pDest += chunk;
+            current += chunk;
+            remaining -= chunk;
+        }
+
+        return true;
+    }
+
+    void Clear()
+    {
+        m_pages.clear();
+    }
+
+    // Number of page lookups which were served from the cache
+    uint64_t Hits() const
+    {
+        return m_hits;
+    }
+
+    // Number of page lookups which had to read target memory
+    uint64_t Misses() const
+    {
+        return m_misses;
+    }
+
+    // Number of reads which touched a page that couldn't be read whole, and so were read exactly
+    uint64_t ExactReads() const
+    {
+        return m_exactReads;
+    }
+
+private:
+    struct Page
+    {
+        // null if the page could not be read
+        std::unique_ptr<uint8_t[]> Bytes;
+    };
+
+    template <class TReader>
+    void FetchRun(uint64_t firstPage, uint32_t pageCount, TReader& reader)
+    {
+        std::vector<uint8_t> buffer((size_t)pageCount * PageSize);
+        if (reader(firstPage * PageSize, buffer.data(), pageCount * PageSize))
+        {
+            for (uint32_t i = 0; i < pageCount; i++)
+            {
+                Page& page = m_pages[firstPage + i];
+                page.Bytes.reset(new uint8_t[PageSize]);
+                memcpy(page.Bytes.get(), buffer.data() + (size_t)i * PageSize, PageSize);
+            }
+            return;
+        }
+
+        // A single page which can't be read is remembered as such, without trying it again
+        if (pageCount == 1)
+        {
+            m_pages[firstPage].Bytes.reset();
+            return;
+        }
+
+        // Part of the run is not readable. Find out which pages are, so that reads of the readable
+        // pages still succeed and the unreadable ones are not fetched again.
+        for (uint32_t i = 0; i < pageCount; i++)
+        {
+            Page& page = m_pages[firstPage + i];
+            std::unique_ptr<uint8_t[]> bytes(new uint8_t[PageSize]);
+            if (reader((firstPage + i) * PageSize, bytes.get(), PageSize))
+            {
+                page.Bytes = std::move(bytes);
+            }
+        }
+    }
+
+    std::unordered_map<uint64_t, Page> m_pages;
+    uint64_t m_hits;
+    uint64_t m_misses;
+    uint64_t m_exactReads;
+};
@@ -0,0 +1,107 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+#include "stdafx.h"
+#include "MemoryCacheDataItem.h"
+
+//static
+HRESULT CMemoryCacheDataItem::ReadMemory(
+    _In_ DkmVisualizedExpression* pVisualizedExpression,
+    _In_ UINT64 address,
+    _Out_writes_bytes_(size) void* pBuffer,
+    _In_ UINT32 size
+)
+{
+    HRESULT hr;
+
+    CComPtr<CMemoryCacheDataItem> pDataItem;
+    hr = GetInstance(pVisualizedExpression, &pDataItem);
+    if (FAILED(hr))
+    {
+        return hr;
+    }
+
+    DkmProcess* pProcess = pDataItem->m_pProcess;
+    auto reader = [pProcess](uint64_t readAddress, void* pReadBuffer, uint32_t readSize) -> bool
+    {
+#pragma prefast(suppress:6387, "pBytesRead is unused and can be null")
+        return SUCCEEDED(pProcess->ReadMemory(readAddress, DkmReadMemoryFlags::None, pReadBuffer, readSize, nullptr));
+    };
+
+    ObjectLock lock(pDataItem);
+    if (!pDataItem->m_cache.Read(address, pBuffer, size, reader))
+    {
+        return HRESULT_FROM_WIN32(ERROR_PARTIAL_COPY);
+    }
+
+    return S_OK;
+}
+
+//static
+HRESULT CMemoryCacheDataItem::GetStatistics(
+    _In_ DkmVisualizedExpression* pVisualizedExpression,
+    _Out_ UINT64* pHits,
+    _Out_ UINT64* pMisses
+)
+{
+    HRESULT hr;
+    *pHits = 0;
+    *pMisses = 0;
+
+    CComPtr<CMemoryCacheDataItem> pDataItem;
+    hr = GetInstance(pVisualizedExpression, &pDataItem);
+    if (FAILED(hr))
+    {
+        return hr;
+    }
+
+    ObjectLock lock(pDataItem);
+    *pHits = pDataItem->m_cache.Hits();
+    *pMisses = pDataItem->m_cache.Misses();
+    return S_OK;
+}
+
+//static
+HRESULT CMemoryCacheDataItem::GetInstance(
+    _In_ DkmVisualizedExpression* pVisualizedExpression,
+    _Deref_out_ CMemoryCacheDataItem** ppDataItem
+)
+{
+    HRESULT hr;
+
+    // Children share the cache of their root
+    DkmVisualizedExpression* pRootVisualizedExpression = pVisualizedExpression;
+    for (DkmChildVisualizedExpression* pChild = DkmChildVisualizedExpression::TryCast(pRootVisualizedExpression);
+        pChild != nullptr;
+        pChild = DkmChildVisualizedExpression::TryCast(pRootVisualizedExpression))
+    {
+        pRootVisualizedExpression = pChild->Parent();
+    }
+
+    // If there is already an associated item, return it.
+    hr = pRootVisualizedExpression->GetDataItem(ppDataItem);
+    if (hr == S_OK)
+    {
+        return hr;
+    }
+
+    // Otherwise create a new object
+    CComObject<CMemoryCacheDataItem>* pComObject;
+    hr = CComObject<CMemoryCacheDataItem>::CreateInstance(&pComObject);
+    if (FAILED(hr))
+    {
+        return hr;
+    }
+    CComPtr<CMemoryCacheDataItem> pCreatedInstance(pComObject);
+    pCreatedInstance->m_pProcess = pVisualizedExpression->RuntimeInstance()->Process();
+
+    // Expression evaluation can happen on more than one thread, so another thread may have
+    // associated a cache with the expression in the meantime. In that case use theirs.
+    hr = pRootVisualizedExpression->SetDataItem(DkmDataCreationDisposition::CreateNew, pCreatedInstance.p);
+    if (FAILED(hr))
+    {
+        return pRootVisualizedExpression->GetDataItem(ppDataItem);
+    }
+
+    *ppDataItem = pCreatedInstance.Detach();
+    return S_OK;
+}
@@ -0,0 +1,66 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+#pragma once
+
+#include "MemoryCache.h"
+
+// CMemoryCacheDataItem holds a MemoryPageCache of the target process for one root
+// DkmVisualizedExpression. All of the visualizer's reads of target memory for the expression and
+// its children go through it, so repeated and overlapping reads while it is expanded are served
+// from the cache. The debugger evaluates the expression again, which creates a new root, after
+// anything could have changed memory: when the process continues, and when a value is edited in
+// the same break state. Each evaluation therefore starts with an empty cache.
+class ATL_NO_VTABLE __declspec(uuid("c5e1b7a4-2f3d-4e8b-9a61-0d7c3b5f2e94")) CMemoryCacheDataItem :
+    public IUnknown,
+    public CComObjectRootEx<CComMultiThreadModel>
+{
+private:
+    CComPtr<DkmProcess> m_pProcess;
+    MemoryPageCache m_cache;
+
+protected:
+    CMemoryCacheDataItem()
+    {
+    }
+    ~CMemoryCacheDataItem()
+    {
+    }
+
+public:
+    // Reads target memory through the cache of the root of 'pVisualizedExpression'
+    static HRESULT ReadMemory(
+        _In_ DkmVisualizedExpression* pVisualizedExpression,
+        _In_ UINT64 address,
+        _Out_writes_bytes_(size) void* pBuffer,
+        _In_ UINT32 size
+    );
+
+    // Returns the hit/miss counters of the cache of the root of 'pVisualizedExpression'
+    static HRESULT GetStatistics(
+        _In_ DkmVisualizedExpression* pVisualizedExpression,
+        _Out_ UINT64* pHits,
+        _Out_ UINT64* pMisses
+    );
+
+protected:
+    static HRESULT GetInstance(
+        _In_ DkmVisualizedExpression* pVisualizedExpression,
+        _Deref_out_ CMemoryCacheDataItem** ppDataItem
+    );
+
+    HRESULT _InternalQueryInterface(REFIID riid, void** ppvObject)
+    {
+        if (ppvObject == NULL)
+            return E_POINTER;
+
+        if (riid == __uuidof(IUnknown))
+        {
+            *ppvObject = static_cast<IUnknown*>(this);
+            AddRef();
+            return S_OK;
+        }
+
+        *ppvObject = NULL;
+        return E_NOINTERFACE;
+    }
+};
@@ -0,0 +1,168 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+#pragma once
+
+// This file writes all of the rows of a parallel arrays object out of target memory, for the
+// 'csv' and 'binary' views. The columns are streamed in chunks of ExportChunkRows rows, so memory use
+// doesn't depend on the number of rows. Output goes to a 'writer', called as
+// 'bool writer(const void* pBuffer, size_t size)'. It is called on a thread of its own, so that
+// writing one chunk overlaps with reading and formatting the next; calls to it never overlap each
+// other. Like ParallelArrays.h, this only depends on the C++ standard library.
+
+#include "ParallelArrays.h"
+#include <future>
+
+struct ExportFormat
+{
+    enum e
+    {
+        // One header line with the display names of the columns, then one line per row with the
+        // values formatted like FormatColumnNumber does in decimal, separated by commas
+        Csv,
+        // The elements of each row in column order, with their little endian representation in
+        // target memory and no padding
+        Binary
+    };
+};
+
+// Number of rows read and written at a time
+const uint32_t ExportChunkRows = 64 * 1024;
+
+// Appends rows [0, count) of 'columns' (indexed like plan.Columns, each holding 'count' elements)
+// to 'pOutput' in 'format'
+inline void FormatExportRows(const ParallelArrayPlan& plan, ExportFormat::e format, const std::vector<std::vector<uint8_t>>& columns, uint32_t count, std::vector<char>* pOutput)
+{
+    for (uint32_t row = 0; row < count; row++)
+    {
+        for (size_t i = 0; i < plan.Columns.size(); i++)
+        {
+            uint32_t elementSize = plan.Columns[i].ElementSize;
+            const uint8_t* pValue = columns[i].data() + (size_t)row * elementSize;
+
+            if (format == ExportFormat::Binary)
+            {
+                pOutput->insert(pOutput->end(), pValue, pValue + elementSize);
+                continue;
+            }
+
+            if (i != 0)
+            {
+                pOutput->push_back(',');
+            }
+
+            // Numbers are plain ASCII
+            wchar_t valueText[ColumnValueBufferLength];
+            size_t length = FormatColumnNumber(plan.Columns[i].Type, pValue, false, valueText);
+            for (size_t c = 0; c < length; c++)
+            {
+                pOutput->push_back((char)valueText[c]);
+            }
+        }
+
+        if (format == ExportFormat::Csv)
+        {
+            pOutput->push_back('\n');
+        }
+    }
+}
+
+// Writes rows [0, rowCount) of the columns 'pBounds' (indexed like plan.Columns, as returned by
+// ReadParallelArrayBounds) to 'writer' in 'format'. '*pRowsWritten' is set to the number of rows
+// handed to 'writer'. Returns false if target memory can't be read or 'writer' fails, which
+// leaves the output truncated. Throws std::bad_alloc if the chunk buffers can't be allocated and
+// std::system_error if the writing thread can't be started, after waiting for any pending write.
+template <class TReader, class TWriter>
+bool ExportParallelArrays(const ParallelArrayPlan& plan, const VectorBounds* pBounds, uint64_t rowCount, ExportFormat::e format, TReader& reader, TWriter& writer, uint64_t* pRowsWritten)
+{
+    *pRowsWritten = 0;
+
+    std::vector<std::vector<uint8_t>> columns(plan.Columns.size());
+    for (size_t i = 0; i < plan.Columns.size(); i++)
+    {
+        columns[i].resize((size_t)ExportChunkRows * plan.Columns[i].ElementSize);
+    }
+
+    // One output buffer is written while the other is filled
+    std::vector<char> outputs[2];
+    size_t current = 0;
+    // Declared after 'outputs', so that if anything throws, the pending write is waited for before
+    // its buffer is freed
+    std::future<bool> pendingWrite;
+    uint64_t pendingRows = 0;
+
+    if (format == ExportFormat::Csv)
+    {
+        for (size_t i = 0; i < plan.Columns.size(); i++)
+        {
+            if (i != 0)
+            {
+                outputs[current].push_back(',');
+            }
+            for (wchar_t c : plan.Columns[i].DisplayName)
+            {
+                outputs[current].push_back((char)c);
+            }
+        }
+        outputs[current].push_back('\n');
+    }
+
+    bool succeeded = true;
+    uint64_t row = 0;
+    while (succeeded && row < rowCount)
+    {
+        uint32_t rows = (rowCount - row < ExportChunkRows) ? (uint32_t)(rowCount - row) : ExportChunkRows;
+        for (size_t i = 0; i < plan.Columns.size() && succeeded; i++)
+        {
+            uint32_t elementSize = plan.Columns[i].ElementSize;
+            succeeded = reader(pBounds[i].First + row * elementSize, columns[i].data(), rows * elementSize);
+        }
+        if (!succeeded)
+        {
+            break;
+        }
+
+        // The buffer was last written two chunks ago, which has been waited for already
+        FormatExportRows(plan, format, columns, rows, &outputs[current]);
+
+        if (pendingWrite.valid())
+        {
+            if (!pendingWrite.get())
+            {
+                succeeded = false;
+                break;
+            }
+            *pRowsWritten += pendingRows;
+        }
+
+        std::vector<char>* pOutput = &outputs[current];
+        pendingWrite = std::async(std::launch::async, [&writer, pOutput]() -> bool
+        {
+            bool written = writer(pOutput->data(), pOutput->size());
+            pOutput->clear();
+            return written;
+        });
+        pendingRows = rows;
+        current = 1 - current;
+        row += rows;
+    }
+
+    if (pendingWrite.valid())
+    {
+        if (pendingWrite.get())
+        {
+            *pRowsWritten += pendingRows;
+        }
+        else
+        {
+            succeeded = false;
+        }
+    }
+
+    // Nothing was written yet if there are no rows; the CSV header still needs to be
+    if (succeeded && rowCount == 0 && !outputs[current].empty())
+    {
+        succeeded = writer(outputs[current].data(), outputs[current].size());
+    }
+
+    return succeeded;
+}
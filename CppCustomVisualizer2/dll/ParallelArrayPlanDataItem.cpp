@@ -0,0 +1,192 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+#include "stdafx.h"
+#include "ParallelArrayPlanDataItem.h"
+#include "VectorLayout.h"
+
+// Strips qualifiers, pointers and references from the type name the EE reports for a root, ex:
+// 'const Sample *' becomes 'Sample'
+static void GetUnqualifiedTypeName(_In_ LPCWSTR type, _Out_ CString& name)
+{
+    name = type;
+    name.Replace(L"const ", L"");
+    name.Replace(L"volatile ", L"");
+    name.TrimRight(L" *&");
+    name.Trim();
+}
+
+//static
+HRESULT CParallelArrayPlanDataItem::GetPlan(
+    _In_ DkmVisualizedExpression* pVisualizedExpression,
+    _In_ DkmString* pFullName,
+    _In_ DkmString* pType,
+    _In_ bool rootIsPointer,
+    _In_ const ParallelArrayTypes& types,
+    _Out_ ParallelArrayPlan* pPlan
+)
+{
+    HRESULT hr;
+    *pPlan = ParallelArrayPlan();
+
+    if (pType == nullptr)
+    {
+        return S_FALSE;
+    }
+
+    CString typeName;
+    GetUnqualifiedTypeName(pType->Value(), typeName);
+
+    // Without a module, the plan is compiled for every evaluation
+    CComPtr<CParallelArrayPlanDataItem> pDataItem;
+    CComPtr<DkmModuleInstance> pModuleInstance;
+    hr = GetTypeModuleInstance(pVisualizedExpression, &pModuleInstance);
+    if (FAILED(hr))
+    {
+        return hr;
+    }
+    if (pModuleInstance != nullptr)
+    {
+        hr = GetInstance(pModuleInstance, &pDataItem);
+        if (FAILED(hr))
+        {
+            return hr;
+        }
+    }
+
+    if (pDataItem != nullptr)
+    {
+        ObjectLock lock(pDataItem);
+
+        const PlanMap::CPair* pPair = pDataItem->m_plans.Lookup(typeName);
+        if (pPair != nullptr)
+        {
+            *pPlan = *pPair->m_value;
+            return S_OK;
+        }
+    }
+
+    LPCWSTR descriptor = types.Find(typeName);
+    if (descriptor == nullptr)
+    {
+        return S_FALSE;
+    }
+
+    if (!ParallelArrayPlan::Compile(descriptor, pPlan))
+    {
+        return E_UNEXPECTED;
+    }
+
+    hr = ResolveOffsets(pVisualizedExpression, pFullName, rootIsPointer, pPlan);
+    if (FAILED(hr))
+    {
+        return hr;
+    }
+    if (hr != S_OK)
+    {
+        // The offsets may be found with the next object of this type (ex: this one is a null
+        // pointer), so don't remember the plan. The rows go through the EE in the meantime.
+        return S_OK;
+    }
+
+    if (pDataItem == nullptr)
+    {
+        return S_OK;
+    }
+
+    CAutoPtr<ParallelArrayPlan> pCachedPlan(new (std::nothrow) ParallelArrayPlan(*pPlan));
+    if (pCachedPlan != nullptr)
+    {
+        ObjectLock lock(pDataItem);
+
+        // If another thread compiled the same type in the meantime, keep theirs. They are the same.
+        if (pDataItem->m_plans.Lookup(typeName) == nullptr)
+        {
+            pDataItem->m_plans.SetAt(typeName, pCachedPlan);
+        }
+    }
+
+    return S_OK;
+}
+
+//static
+HRESULT CParallelArrayPlanDataItem::GetInstance(
+    _In_ DkmModuleInstance* pModuleInstance,
+    _Deref_out_ CParallelArrayPlanDataItem** ppDataItem
+)
+{
+    HRESULT hr;
+
+    // If there is already an associated item, return it.
+    hr = pModuleInstance->GetDataItem(ppDataItem);
+    if (hr == S_OK)
+    {
+        return hr;
+    }
+
+    // Otherwise create a new object
+    CComObject<CParallelArrayPlanDataItem>* pComObject;
+    hr = CComObject<CParallelArrayPlanDataItem>::CreateInstance(&pComObject);
+    if (FAILED(hr))
+    {
+        return hr;
+    }
+    CComPtr<CParallelArrayPlanDataItem> pCreatedInstance(pComObject);
+
+    // Another thread may have associated an item with the module in the meantime. In that case
+    // use theirs.
+    hr = pModuleInstance->SetDataItem(DkmDataCreationDisposition::CreateNew, pCreatedInstance.p);
+    if (FAILED(hr))
+    {
+        return pModuleInstance->GetDataItem(ppDataItem);
+    }
+
+    *ppDataItem = pCreatedInstance.Detach();
+    return S_OK;
+}
+
+//static
+HRESULT CParallelArrayPlanDataItem::ResolveOffsets(
+    _In_ DkmVisualizedExpression* pVisualizedExpression,
+    _In_ DkmString* pFullName,
+    _In_ bool rootIsPointer,
+    _Inout_ ParallelArrayPlan* pPlan
+)
+{
+    HRESULT hr;
+
+    // The offsets are only useful if the vectors can be decoded, which needs their layout
+    CString probeText;
+    probeText.Format(rootIsPointer ? L"sizeof((%s)->%s)" : L"sizeof((%s).%s)", pFullName->Value(), pPlan->Columns[0].Member.c_str());
+
+    VectorLayout layout;
+    hr = CVectorLayoutDataItem::GetLayout(pVisualizedExpression, probeText, &layout);
+    if (hr != S_OK)
+    {
+        return hr;
+    }
+
+    uint32_t offsets[ParallelArrayPlan::MaxColumns];
+    for (size_t i = 0; i < pPlan->Columns.size(); i++)
+    {
+        CString evalText;
+        if (rootIsPointer)
+        {
+            evalText.Format(L"(unsigned __int64)&(%s)->%s - (unsigned __int64)(%s)", pFullName->Value(), pPlan->Columns[i].Member.c_str(), pFullName->Value());
+        }
+        else
+        {
+            evalText.Format(L"(unsigned __int64)&(%s).%s - (unsigned __int64)&(%s)", pFullName->Value(), pPlan->Columns[i].Member.c_str(), pFullName->Value());
+        }
+
+        unsigned long long offset;
+        hr = EvaluateUInt64(pVisualizedExpression, evalText, &offset);
+        if (FAILED(hr) || offset > UINT32_MAX)
+        {
+            return S_FALSE;
+        }
+
+        offsets[i] = (uint32_t)offset;
+    }
+
+    return pPlan->ResolveOffsets(offsets, layout) ? S_OK : S_FALSE;
+}
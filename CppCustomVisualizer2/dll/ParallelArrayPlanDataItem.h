@@ -0,0 +1,73 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+#pragma once
+
+#include "ParallelArrays.h"
+
+// CParallelArrayPlanDataItem caches the compiled ParallelArrayPlan of each parallel arrays type
+// seen in a module, so that a type's descriptor is parsed and its member offsets are found with
+// the expression evaluator only once. It is associated with the DkmModuleInstance which defines
+// the type, like the vector layout the plan depends on (see CVectorLayoutDataItem).
+class ATL_NO_VTABLE __declspec(uuid("3e9a5d27-c1f4-4b68-8d03-b7e2f6a9c154")) CParallelArrayPlanDataItem :
+    public IUnknown,
+    public CComObjectRootEx<CComMultiThreadModel>
+{
+private:
+    typedef CAtlMap<CString, CAutoPtr<ParallelArrayPlan>, CStringElementTraits<CString>, CAutoPtrElementTraits<ParallelArrayPlan>> PlanMap;
+
+    // Keyed by type name, without any pointer or reference
+    PlanMap m_plans;
+
+protected:
+    CParallelArrayPlanDataItem()
+    {
+    }
+    ~CParallelArrayPlanDataItem()
+    {
+    }
+
+public:
+    // Returns the plan for the type of the root expression 'pVisualizedExpression', whose full name
+    // and type are 'pFullName' and 'pType'. Returns S_FALSE if 'types' has no descriptor for it. The
+    // plan's HasOffsets is not set if the vectors can't be located in target memory, in which case
+    // the rows have to be evaluated with the EE.
+    static HRESULT GetPlan(
+        _In_ DkmVisualizedExpression* pVisualizedExpression,
+        _In_ DkmString* pFullName,
+        _In_ DkmString* pType,
+        _In_ bool rootIsPointer,
+        _In_ const ParallelArrayTypes& types,
+        _Out_ ParallelArrayPlan* pPlan
+    );
+
+protected:
+    static HRESULT GetInstance(
+        _In_ DkmModuleInstance* pModuleInstance,
+        _Deref_out_ CParallelArrayPlanDataItem** ppDataItem
+    );
+
+    // Finds where each column's vector lives in the object and records it in 'pPlan'. Returns
+    // S_FALSE if they can't be found, which may only be true for this particular object.
+    static HRESULT ResolveOffsets(
+        _In_ DkmVisualizedExpression* pVisualizedExpression,
+        _In_ DkmString* pFullName,
+        _In_ bool rootIsPointer,
+        _Inout_ ParallelArrayPlan* pPlan
+    );
+
+    HRESULT _InternalQueryInterface(REFIID riid, void** ppvObject)
+    {
+        if (ppvObject == NULL)
+            return E_POINTER;
+
+        if (riid == __uuidof(IUnknown))
+        {
+            *ppvObject = static_cast<IUnknown*>(this);
+            AddRef();
+            return S_OK;
+        }
+
+        *ppvObject = NULL;
+        return E_NOINTERFACE;
+    }
+};
@@ -0,0 +1,556 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+#pragma once
+
+// This file decodes "parallel arrays" types straight from target memory: a struct whose members
+// are N std::vectors of the same length, where row i is made up of element i of every vector (ex:
+// 'class Sample { std::vector<int> a, b; }', see TargetApp.h). The columns of a type are listed by
+// a descriptor such as L"A=a:int, B=b:int", which ParallelArrayPlan::Compile turns into a read plan
+// once per type. Memory is read with a 'reader', called as
+// 'bool reader(uint64_t address, void* pBuffer, uint32_t size)', the same as for MemoryPageCache. In
+// the debugger the reader goes to the target process; elsewhere it can be any byte source. Like
+// StlVectorLayout.h, this only depends on the C++ standard library.
+
+#include "StlVectorLayout.h"
+#include <stdio.h>
+#include <wchar.h>
+#include <string>
+#include <vector>
+
+// Element types which a column can hold
+struct ColumnType
+{
+    enum e
+    {
+        Int8,
+        UInt8,
+        Int16,
+        UInt16,
+        Int32,
+        UInt32,
+        Int64,
+        UInt64,
+        Float,
+        Double
+    };
+
+    struct Info
+    {
+        const wchar_t* Name;
+        uint32_t Size;
+    };
+
+    // Indexed by ColumnType::e. The names are the ones the C++ EE uses for the type.
+    static const Info& Get(e type)
+    {
+        static const Info infos[] =
+        {
+            { L"char", 1 },
+            { L"unsigned char", 1 },
+            { L"short", 2 },
+            { L"unsigned short", 2 },
+            { L"int", 4 },
+            { L"unsigned int", 4 },
+            { L"__int64", 8 },
+            { L"unsigned __int64", 8 },
+            { L"float", 4 },
+            { L"double", 8 },
+        };
+
+        return infos[type];
+    }
+
+    static bool TryParse(const std::wstring& name, e* pType)
+    {
+        static const struct
+        {
+            const wchar_t* Name;
+            e Type;
+        } aliases[] =
+        {
+            { L"char", Int8 }, { L"int8_t", Int8 }, { L"signed char", Int8 },
+            { L"unsigned char", UInt8 }, { L"uint8_t", UInt8 },
+            { L"short", Int16 }, { L"int16_t", Int16 },
+            { L"unsigned short", UInt16 }, { L"uint16_t", UInt16 },
+            { L"int", Int32 }, { L"int32_t", Int32 }, { L"long", Int32 },
+            { L"unsigned int", UInt32 }, { L"uint32_t", UInt32 }, { L"unsigned long", UInt32 },
+            { L"__int64", Int64 }, { L"int64_t", Int64 }, { L"long long", Int64 },
+            { L"unsigned __int64", UInt64 }, { L"uint64_t", UInt64 }, { L"unsigned long long", UInt64 },
+            { L"float", Float },
+            { L"double", Double },
+        };
+
+        for (size_t i = 0; i < sizeof(aliases) / sizeof(aliases[0]); i++)
+        {
+            if (name == aliases[i].Name)
+            {
+                *pType = aliases[i].Type;
+                return true;
+            }
+        }
+
+        return false;
+    }
+};
+
+// One column of a parallel arrays type
+struct ParallelArrayColumn
+{
+    // Shown as the name of the column's cell in each row
+    std::wstring DisplayName;
+    // Name of the std::vector member holding the column
+    std::wstring Member;
+    ColumnType::e Type;
+    uint32_t ElementSize;
+    // Offset of the std::vector from the start of the object. Only valid if the plan's
+    // HasOffsets is set.
+    uint32_t Offset;
+};
+
+// The compiled form of a descriptor: which vectors to read, and how to render their elements
+struct ParallelArrayPlan
+{
+    // A parallel arrays type with more columns than this is almost certainly a typo in a descriptor
+    static const size_t MaxColumns = 32;
+
+    std::vector<ParallelArrayColumn> Columns;
+
+    // Set by ResolveOffsets. When it is not set, the rows can still be shown through the EE.
+    bool HasOffsets;
+    // Layout of the column vectors. Only valid if HasOffsets is set.
+    VectorLayout Layout;
+    // The part of the object which holds all of the column vectors, so that their bounds can be
+    // read at once
+    uint32_t ReadOffset;
+    uint32_t ReadSize;
+
+    ParallelArrayPlan() :
+        HasOffsets(false),
+        ReadOffset(0),
+        ReadSize(0)
+    {
+        memset(&Layout, 0, sizeof(Layout));
+    }
+
+    // Parses a descriptor: a comma separated list of columns, each written as
+    // '[DisplayName=]member:type', where 'type' is one of the types known to ColumnType. Without a
+    // display name, the cell is named after the member. Returns false if the descriptor is
+    // malformed.
+    static bool Compile(const wchar_t* descriptor, ParallelArrayPlan* pPlan)
+    {
+        *pPlan = ParallelArrayPlan();
+
+        const wchar_t* pCurrent = descriptor;
+        while (*pCurrent != L'\0')
+        {
+            const wchar_t* pEnd = wcschr(pCurrent, L',');
+            if (pEnd == nullptr)
+            {
+                pEnd = pCurrent + wcslen(pCurrent);
+            }
+
+            std::wstring text(pCurrent, pEnd);
+            pCurrent = (*pEnd == L',') ? pEnd + 1 : pEnd;
+
+            size_t colon = text.find(L':');
+            if (colon == std::wstring::npos)
+            {
+                return false;
+            }
+
+            ParallelArrayColumn column;
+            std::wstring name = Trim(text.substr(0, colon));
+            size_t equals = name.find(L'=');
+            if (equals == std::wstring::npos)
+            {
+                column.Member = name;
+                column.DisplayName = name;
+            }
+            else
+            {
+                column.DisplayName = Trim(name.substr(0, equals));
+                column.Member = Trim(name.substr(equals + 1));
+            }
+
+            if (column.Member.empty() || column.DisplayName.empty() ||
+                !ColumnType::TryParse(Trim(text.substr(colon + 1)), &column.Type))
+            {
+                return false;
+            }
+
+            column.ElementSize = ColumnType::Get(column.Type).Size;
+            column.Offset = 0;
+            pPlan->Columns.push_back(column);
+        }
+
+        return !pPlan->Columns.empty() && pPlan->Columns.size() <= MaxColumns;
+    }
+
+    // Records where each column vector lives in the object ('pOffsets' is indexed like Columns)
+    // and how they are laid out, and works out the single read which covers all of them. Returns
+    // false if the vectors are too far apart to be read at once.
+    bool ResolveOffsets(const uint32_t* pOffsets, const VectorLayout& layout)
+    {
+        uint32_t vectorSize = layout.VectorSize;
+        const uint32_t MaxReadSize = 4096;
+
+        uint32_t first = UINT32_MAX;
+        uint32_t last = 0;
+        for (size_t i = 0; i < Columns.size(); i++)
+        {
+            if (pOffsets[i] > MaxReadSize)
+            {
+                return false;
+            }
+
+            Columns[i].Offset = pOffsets[i];
+            first = (pOffsets[i] < first) ? pOffsets[i] : first;
+            last = (pOffsets[i] + vectorSize > last) ? pOffsets[i] + vectorSize : last;
+        }
+
+        if (Columns.empty() || last - first > MaxReadSize)
+        {
+            return false;
+        }
+
+        for (size_t i = 0; i < Columns.size(); i++)
+        {
+            Columns[i].Offset -= first;
+        }
+
+        Layout = layout;
+        ReadOffset = first;
+        ReadSize = last - first;
+        HasOffsets = true;
+        return true;
+    }
+
+private:
+    static std::wstring Trim(const std::wstring& text)
+    {
+        size_t first = text.find_first_not_of(L" \t");
+        if (first == std::wstring::npos)
+        {
+            return std::wstring();
+        }
+
+        size_t last = text.find_last_not_of(L" \t");
+        return text.substr(first, last - first + 1);
+    }
+};
+
+// The parallel arrays types which the visualizer knows about, with the descriptor of each. They
+// are listed in a file (CppCustomVisualizer.parallelarrays in the debugger), one per line, as
+// '<type name>=<descriptor>', ex: 'Sample = A=a:int, B=b:int'. The type name ends at the first
+// '='. Lines starting with '#' are comments. A line whose descriptor doesn't compile is skipped,
+// and if a type is listed twice, the first line is used.
+class ParallelArrayTypes
+{
+public:
+    void Parse(const std::wstring& text)
+    {
+        const wchar_t* WhiteSpace = L" \t\r\n";
+
+        size_t lineStart = 0;
+        while (lineStart < text.size())
+        {
+            size_t lineEnd = text.find(L'\n', lineStart);
+            if (lineEnd == std::wstring::npos)
+            {
+                lineEnd = text.size();
+            }
+            std::wstring line = text.substr(lineStart, lineEnd - lineStart);
+            lineStart = lineEnd + 1;
+
+            size_t first = line.find_first_not_of(WhiteSpace);
+            size_t separator = line.find(L'=');
+            if (first == std::wstring::npos || line[first] == L'#' || separator == std::wstring::npos)
+            {
+                continue;
+            }
+
+            std::wstring typeName = line.substr(0, separator);
+            std::wstring descriptor = line.substr(separator + 1);
+            typeName.erase(typeName.find_last_not_of(WhiteSpace) + 1);
+            typeName.erase(0, typeName.find_first_not_of(WhiteSpace));
+            descriptor.erase(descriptor.find_last_not_of(WhiteSpace) + 1);
+            descriptor.erase(0, descriptor.find_first_not_of(WhiteSpace));
+
+            ParallelArrayPlan plan;
+            if (typeName.empty() || Find(typeName.c_str()) != nullptr || !ParallelArrayPlan::Compile(descriptor.c_str(), &plan))
+            {
+                continue;
+            }
+
+            m_typeNames.push_back(typeName);
+            m_descriptors.push_back(descriptor);
+        }
+    }
+
+    // Returns the descriptor of the type 'typeName', without any qualifiers, or nullptr if it
+    // isn't listed
+    const wchar_t* Find(const wchar_t* typeName) const
+    {
+        for (size_t i = 0; i < m_typeNames.size(); i++)
+        {
+            if (m_typeNames[i] == typeName)
+            {
+                return m_descriptors[i].c_str();
+            }
+        }
+        return nullptr;
+    }
+
+    size_t GetCount() const
+    {
+        return m_typeNames.size();
+    }
+
+private:
+    // Indexed alike
+    std::vector<std::wstring> m_typeNames;
+    std::vector<std::wstring> m_descriptors;
+};
+
+// The elements of one row, copied out of a ParallelArrayWindow. Indexed like plan.Columns.
+struct ParallelArrayRow
+{
+    uint64_t Addresses[ParallelArrayPlan::MaxColumns];
+    uint8_t Values[ParallelArrayPlan::MaxColumns][8];
+};
+
+// The values of the rows [First, First + Count) of every column, stored column by column exactly
+// as they were read from the target
+struct ParallelArrayWindow
+{
+    uint64_t First;
+    uint32_t Count;
+    // Target address of the element in row First of each column
+    std::vector<uint64_t> Addresses;
+    std::vector<std::vector<uint8_t>> Columns;
+
+    ParallelArrayWindow() :
+        First(0),
+        Count(0)
+    {
+    }
+
+    // Copies row 'index' into 'pRow'. Returns false if the row is not in the window.
+    bool TryGetRow(const ParallelArrayPlan& plan, uint64_t index, ParallelArrayRow* pRow) const
+    {
+        if (index < First || index - First >= Count || Columns.size() != plan.Columns.size())
+        {
+            return false;
+        }
+
+        size_t offset = (size_t)(index - First);
+        for (size_t i = 0; i < plan.Columns.size(); i++)
+        {
+            uint32_t elementSize = plan.Columns[i].ElementSize;
+            pRow->Addresses[i] = Addresses[i] + offset * elementSize;
+            memcpy(pRow->Values[i], Columns[i].data() + offset * elementSize, elementSize);
+        }
+
+        return true;
+    }
+};
+
+// Reads the column vectors of the object at 'objectAddress' into 'pBounds' (indexed like
+// plan.Columns). Requires plan.HasOffsets. Returns false if they can't be read or don't decode as
+// vectors of the column types.
+template <class TReader>
+bool ReadParallelArrayBounds(const ParallelArrayPlan& plan, uint64_t objectAddress, TReader& reader, VectorBounds* pBounds)
+{
+    if (!plan.HasOffsets)
+    {
+        return false;
+    }
+
+    // The vectors are all within ReadSize bytes of each other, so one read covers all of them
+    std::vector<uint8_t> buffer(plan.ReadSize);
+    if (!reader(objectAddress + plan.ReadOffset, buffer.data(), plan.ReadSize))
+    {
+        return false;
+    }
+
+    for (size_t i = 0; i < plan.Columns.size(); i++)
+    {
+        const ParallelArrayColumn& column = plan.Columns[i];
+        if (column.Offset + plan.Layout.VectorSize > plan.ReadSize ||
+            !DecodeVector(plan.Layout, buffer.data() + column.Offset, column.ElementSize, &pBounds[i]))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Reads rows [startIndex, startIndex + count) of every column into 'pWindow'. 'pBounds' are the
+// column vectors as returned by ReadParallelArrayBounds. The caller validates the range against
+// the number of rows. Each column is read with one call to 'reader'.
+template <class TReader>
+bool ReadParallelArrayWindow(const ParallelArrayPlan& plan, const VectorBounds* pBounds, uint64_t startIndex, uint32_t count, TReader& reader, ParallelArrayWindow* pWindow)
+{
+    pWindow->First = startIndex;
+    pWindow->Count = 0;
+    pWindow->Addresses.resize(plan.Columns.size());
+    pWindow->Columns.resize(plan.Columns.size());
+
+    for (size_t i = 0; i < plan.Columns.size(); i++)
+    {
+        uint32_t elementSize = plan.Columns[i].ElementSize;
+        if (count > UINT32_MAX / elementSize)
+        {
+            return false;
+        }
+
+        std::vector<uint8_t>& values = pWindow->Columns[i];
+        values.resize((size_t)count * elementSize);
+        pWindow->Addresses[i] = pBounds[i].First + startIndex * elementSize;
+        if (!reader(pWindow->Addresses[i], values.data(), count * elementSize))
+        {
+            return false;
+        }
+    }
+
+    pWindow->Count = count;
+    return true;
+}
+
+// Large enough for any element formatted by FormatColumnValue, including the null terminator
+const size_t ColumnValueBufferLength = 32;
+
+// Formats the number in the element at 'pValue' the way the C++ EE does. 'hex' selects
+// hexadecimal for integers, zero padded to the element size, which is how the EE shows them when
+// the radix is 16. Floating point values always show all of the digits the EE does (9 for float,
+// 17 for double), ex: 1.00000000. Returns the number of characters written, not counting the null
+// terminator.
+inline size_t FormatColumnNumber(ColumnType::e type, const uint8_t* pValue, bool hex, wchar_t (&buffer)[ColumnValueBufferLength])
+{
+    int length = -1;
+    switch (type)
+    {
+    case ColumnType::Int8:
+    case ColumnType::UInt8:
+    case ColumnType::Int16:
+    case ColumnType::UInt16:
+    case ColumnType::Int32:
+    case ColumnType::UInt32:
+    case ColumnType::Int64:
+    case ColumnType::UInt64:
+    {
+        uint32_t size = ColumnType::Get(type).Size;
+        uint64_t bits = 0;
+        memcpy(&bits, pValue, size);
+
+        if (hex)
+        {
+            length = swprintf(buffer, ColumnValueBufferLength, L"0x%0*llx", (int)(2 * size), (unsigned long long)bits);
+        }
+        else if (type == ColumnType::Int8 || type == ColumnType::Int16 || type == ColumnType::Int32 || type == ColumnType::Int64)
+        {
+            // Sign extend from the element size
+            uint32_t shift = 64 - 8 * size;
+            int64_t value = (int64_t)(bits << shift) >> shift;
+            length = swprintf(buffer, ColumnValueBufferLength, L"%lld", (long long)value);
+        }
+        else
+        {
+            length = swprintf(buffer, ColumnValueBufferLength, L"%llu", (unsigned long long)bits);
+        }
+        break;
+    }
+
+    case ColumnType::Float:
+    {
+        float value;
+        memcpy(&value, pValue, sizeof(value));
+        length = swprintf(buffer, ColumnValueBufferLength, L"%#.9g", (double)value);
+        break;
+    }
+
+    case ColumnType::Double:
+    {
+        double value;
+        memcpy(&value, pValue, sizeof(value));
+        length = swprintf(buffer, ColumnValueBufferLength, L"%#.17g", value);
+        break;
+    }
+    }
+
+    if (length < 0)
+    {
+        buffer[0] = L'\0';
+        return 0;
+    }
+
+    return (size_t)length;
+}
+
+// Formats 'value' as the C++ EE shows a char after its number, ex: 'a', '\n' or '\x1'. Bytes past
+// 0x7f are shown from the Windows-1252 code page, like the EE does on an English system. Returns the
+// number of characters written, not counting the null terminator.
+inline size_t FormatCharLiteral(uint8_t value, wchar_t* pBuffer, size_t bufferLength)
+{
+    // Windows-1252 for 0x80 to 0x9f, 0 where it doesn't define a character. The rest of the
+    // bytes are the same as in Unicode.
+    static const wchar_t windows1252[32] =
+    {
+        0x20ac, 0, 0x201a, 0x0192, 0x201e, 0x2026, 0x2020, 0x2021, 0x02c6, 0x2030, 0x0160, 0x2039, 0x0152, 0, 0x017d, 0,
+        0, 0x2018, 0x2019, 0x201c, 0x201d, 0x2022, 0x2013, 0x2014, 0x02dc, 0x2122, 0x0161, 0x203a, 0x0153, 0, 0x017e, 0x0178,
+    };
+
+    const wchar_t* pEscape = nullptr;
+    switch (value)
+    {
+    case 0: pEscape = L"\\0"; break;
+    case '\a': pEscape = L"\\a"; break;
+    case '\b': pEscape = L"\\b"; break;
+    case '\t': pEscape = L"\\t"; break;
+    case '\n': pEscape = L"\\n"; break;
+    case '\v': pEscape = L"\\v"; break;
+    case '\f': pEscape = L"\\f"; break;
+    case '\r': pEscape = L"\\r"; break;
+    case '\'': pEscape = L"\\'"; break;
+    case '\\': pEscape = L"\\\\"; break;
+    }
+
+    wchar_t character = (value >= 0x80 && value < 0xa0) ? windows1252[value - 0x80] : (wchar_t)value;
+    int length;
+    if (pEscape != nullptr)
+    {
+        length = swprintf(pBuffer, bufferLength, L"'%ls'", pEscape);
+    }
+    else if (character < 0x20 || character == 0x7f)
+    {
+        length = swprintf(pBuffer, bufferLength, L"'\\x%x'", (unsigned int)value);
+    }
+    else
+    {
+        length = swprintf(pBuffer, bufferLength, L"'%lc'", character);
+    }
+
+    if (length < 0)
+    {
+        pBuffer[0] = L'\0';
+        return 0;
+    }
+
+    return (size_t)length;
+}
+
+// Formats the element at 'pValue' the way the C++ EE shows a value of the column type: the number
+// from FormatColumnNumber, followed by the character for char and unsigned char, ex: 97 'a' or
+// 0x61 'a'. Returns the number of characters written, not counting the null terminator.
+inline size_t FormatColumnValue(ColumnType::e type, const uint8_t* pValue, bool hex, wchar_t (&buffer)[ColumnValueBufferLength])
+{
+    size_t length = FormatColumnNumber(type, pValue, hex, buffer);
+    if (length != 0 && (type == ColumnType::Int8 || type == ColumnType::UInt8))
+    {
+        buffer[length++] = L' ';
+        length += FormatCharLiteral(*pValue, buffer + length, ColumnValueBufferLength - length);
+    }
+
+    return length;
+}
@@ -0,0 +1,86 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+#include "stdafx.h"
+#include "PerfTrace.h"
+#include <psapi.h>
+
+namespace
+{
+    CComAutoCriticalSection s_logLock;
+    FILE* s_pLogFile = nullptr;
+    volatile LONG s_logState = 0; // 0: not checked yet, 1: logging, 2: disabled
+}
+
+CPerfTraceScope::CPerfTraceScope(
+    _In_z_ const char* op,
+    _In_ UINT64 size,
+    _In_ UINT64 first,
+    _In_ UINT32 start,
+    _In_ UINT32 count
+) :
+    m_op(op),
+    m_size(size),
+    m_first(first),
+    m_start(start),
+    m_count(count),
+    m_allocations(0)
+{
+    m_startTime.QuadPart = 0;
+    if (GetLogFile() != nullptr)
+    {
+        QueryPerformanceCounter(&m_startTime);
+    }
+}
+
+CPerfTraceScope::~CPerfTraceScope()
+{
+    FILE* pLogFile = GetLogFile();
+    if (pLogFile == nullptr)
+    {
+        return;
+    }
+
+    LARGE_INTEGER endTime, frequency;
+    QueryPerformanceCounter(&endTime);
+    QueryPerformanceFrequency(&frequency);
+    UINT64 microseconds = (UINT64)(endTime.QuadPart - m_startTime.QuadPart) * 1000000 / (UINT64)frequency.QuadPart;
+
+    PROCESS_MEMORY_COUNTERS memoryCounters = {};
+    memoryCounters.cb = sizeof(memoryCounters);
+    K32GetProcessMemoryInfo(GetCurrentProcess(), &memoryCounters, sizeof(memoryCounters));
+
+    CComCritSecLock<CComAutoCriticalSection> lock(s_logLock);
+    fprintf(
+        pLogFile,
+        "{\"op\":\"%s\",\"size\":%llu,\"first\":%llu,\"start\":%u,\"count\":%u,\"us\":%llu,\"allocations\":%llu,\"peakWorkingSetKB\":%llu}\n",
+        m_op,
+        m_size,
+        m_first,
+        m_start,
+        m_count,
+        microseconds,
+        m_allocations,
+        (UINT64)memoryCounters.PeakWorkingSetSize / 1024);
+    fflush(pLogFile);
+}
+
+//static
+FILE* CPerfTraceScope::GetLogFile()
+{
+    if (s_logState == 0)
+    {
+        CComCritSecLock<CComAutoCriticalSection> lock(s_logLock);
+        if (s_logState == 0)
+        {
+            WCHAR path[MAX_PATH];
+            DWORD cch = GetEnvironmentVariableW(L"CPPCUSTOMVISUALIZER2_PERF_LOG", path, _countof(path));
+            if (cch != 0 && cch < _countof(path))
+            {
+                _wfopen_s(&s_pLogFile, path, L"a");
+            }
+            InterlockedExchange(&s_logState, s_pLogFile != nullptr ? 1 : 2);
+        }
+    }
+
+    return s_logState == 1 ? s_pLogFile : nullptr;
+}
@@ -0,0 +1,53 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+#pragma once
+
+// CPerfTraceScope times one visualizer operation. When the CPPCUSTOMVISUALIZER2_PERF_LOG environment
+// variable names a file (it is read once, when the first scope is created), each scope appends one
+// JSON object per line to that file when it ends, ex:
+//
+//   {"op":"GetItems","size":1000000,"first":0,"start":0,"count":100,"us":153,"allocations":305,"peakWorkingSetKB":81234}
+//
+// 'size' and 'first' describe the Sample, or the bucket of it, being visualized; 'start' and 'count'
+// the window of children requested. 'peakWorkingSetKB' is the peak working set of the process
+// hosting the visualizer. Together with the scenarios in TargetApp this shows how the visualizer
+// scales with the size of a Sample.
+// When the variable isn't set, a scope costs one flag check.
+class CPerfTraceScope
+{
+private:
+    const char* m_op;
+    UINT64 m_size;
+    UINT64 m_first;
+    UINT32 m_start;
+    UINT32 m_count;
+    UINT64 m_allocations;
+    LARGE_INTEGER m_startTime;
+
+public:
+    CPerfTraceScope(
+        _In_z_ const char* op,
+        _In_ UINT64 size,
+        _In_ UINT64 first = 0,
+        _In_ UINT32 start = 0,
+        _In_ UINT32 count = 0
+    );
+    ~CPerfTraceScope();
+
+    // For operations which only know the size of the Sample part way through
+    void SetSize(_In_ UINT64 size)
+    {
+        m_size = size;
+    }
+
+    void SetAllocations(_In_ UINT64 allocations)
+    {
+        m_allocations = allocations;
+    }
+
+private:
+    CPerfTraceScope(const CPerfTraceScope&);
+    CPerfTraceScope& operator=(const CPerfTraceScope&);
+
+    static FILE* GetLogFile();
+};
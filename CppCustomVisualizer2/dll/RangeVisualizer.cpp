@@ -0,0 +1,81 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+#include "stdafx.h"
+#include "RangeVisualizer.h"
+
+HRESULT CRangeVisualizer::GetChildren(
+    _In_ DkmVisualizedExpression* pVisualizedExpression,
+    _In_ UINT32 InitialRequestSize,
+    _In_ DkmInspectionContext* pInspectionContext,
+    _Out_ DkmArray<DkmChildVisualizedExpression*>* pInitialChildren,
+    _Deref_out_ DkmEvaluationResultEnumContext** ppEnumContext
+)
+{
+    bool fFindMismatches;
+    {
+        ObjectLock lock(this);
+        fFindMismatches = m_fFindMismatches;
+    }
+
+    if (fFindMismatches)
+    {
+        // The mismatches are looked for outside of the lock, since that can read the whole
+        // container. If another expansion stored them first, its rows are kept, since GetItems
+        // may already be reading them.
+        ParallelArrayMismatches mismatches;
+        HRESULT hr = m_pRootVisualizer->GetMismatches(pInspectionContext, true, &mismatches);
+        if (FAILED(hr))
+        {
+            return hr;
+        }
+
+        ObjectLock lock(this);
+        if (m_fFindMismatches)
+        {
+            m_rows.swap(mismatches.Rows);
+            m_count = m_rows.size();
+            m_fFindMismatches = false;
+        }
+    }
+
+    unsigned long long count;
+    const uint64_t* pRows;
+    GetRows(&count, &pRows);
+
+    return m_pRootVisualizer->GetRangeChildren(
+        pVisualizedExpression,
+        m_first,
+        count,
+        pRows,
+        this,
+        &m_pRowDescriptor,
+        InitialRequestSize,
+        pInspectionContext,
+        pInitialChildren,
+        ppEnumContext
+    );
+}
+
+HRESULT CRangeVisualizer::GetItems(
+    _In_ DkmVisualizedExpression* pVisualizedExpression,
+    _In_ DkmEvaluationResultEnumContext* pEnumContext,
+    _In_ UINT32 StartIndex,
+    _In_ UINT32 Count,
+    _Out_ DkmArray<DkmChildVisualizedExpression*>* pItems
+)
+{
+    unsigned long long count;
+    const uint64_t* pRows;
+    GetRows(&count, &pRows);
+
+    return m_pRootVisualizer->GetRangeItems(
+        pVisualizedExpression,
+        m_first,
+        count,
+        pRows,
+        &m_pRowDescriptor,
+        StartIndex,
+        Count,
+        pItems
+    );
+}
@@ -0,0 +1,121 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+#pragma once
+
+#include "RootVisualizer.h"
+
+// CRangeVisualizer is the data item of a bucket row such as '[0..999999]', or of the root's
+// '[Mismatches]' row. It only remembers which rows of the root it covers; its children
+// (sub-buckets or rows) are created on demand by the root visualizer when it is expanded. The
+// rows of '[Mismatches]' may only be looked for then too.
+class ATL_NO_VTABLE __declspec(uuid("a3f0e6b2-5c1d-4f7e-8b9a-2d4c6e8f0a13")) CRangeVisualizer :
+    public IUnknown,
+    public CComObjectRootEx<CComMultiThreadModel>
+{
+private:
+    CComPtr<CRootVisualizer> m_pRootVisualizer;
+    unsigned long long m_first;
+    unsigned long long m_count;
+    // If not empty, the rows listed instead of [m_first, m_first + m_count)
+    std::vector<uint64_t> m_rows;
+    // Set if m_rows are the root's mismatches, which haven't been looked for yet. m_count,
+    // m_rows and m_fFindMismatches are only read or set under the object lock, and m_rows never
+    // changes again once the mismatches are stored in it.
+    bool m_fFindMismatches;
+    CComPtr<CChildVisualizer> m_pRowDescriptor;
+
+public:
+    CRangeVisualizer()
+    {
+        m_first = 0;
+        m_count = 0;
+        m_fFindMismatches = false;
+    }
+    ~CRangeVisualizer()
+    {
+    }
+
+    DECLARE_NO_REGISTRY();
+    DECLARE_NOT_AGGREGATABLE(CRangeVisualizer);
+
+    void Initialize(
+        _In_ CRootVisualizer* pRootVisualizer,
+        _In_ unsigned long long first,
+        _In_ unsigned long long count
+    )
+    {
+        m_pRootVisualizer = pRootVisualizer;
+        m_first = first;
+        m_count = count;
+    }
+
+    // Cover the rows 'rows' of the root, which may not be contiguous. This takes the contents of
+    // 'rows'.
+    void Initialize(
+        _In_ CRootVisualizer* pRootVisualizer,
+        _Inout_ std::vector<uint64_t>& rows
+    )
+    {
+        m_pRootVisualizer = pRootVisualizer;
+        m_first = 0;
+        m_count = rows.size();
+        m_rows.swap(rows);
+    }
+
+    // Cover the rows of the root where its columns differ, which are looked for when this is
+    // expanded
+    void InitializeMismatches(
+        _In_ CRootVisualizer* pRootVisualizer
+    )
+    {
+        m_pRootVisualizer = pRootVisualizer;
+        m_first = 0;
+        m_count = 0;
+        m_fFindMismatches = true;
+    }
+
+    HRESULT STDMETHODCALLTYPE GetChildren(
+        _In_ Evaluation::DkmVisualizedExpression* pVisualizedExpression,
+        _In_ UINT32 InitialRequestSize,
+        _In_ Evaluation::DkmInspectionContext* pInspectionContext,
+        _Out_ DkmArray<Evaluation::DkmChildVisualizedExpression*>* pInitialChildren,
+        _Deref_out_ Evaluation::DkmEvaluationResultEnumContext** ppEnumContext
+    );
+    HRESULT STDMETHODCALLTYPE GetItems(
+        _In_ Evaluation::DkmVisualizedExpression* pVisualizedExpression,
+        _In_ Evaluation::DkmEvaluationResultEnumContext* pEnumContext,
+        _In_ UINT32 StartIndex,
+        _In_ UINT32 Count,
+        _Out_ DkmArray<Evaluation::DkmChildVisualizedExpression*>* pItems
+    );
+
+private:
+    // Returns the rows this covers, as passed to CRootVisualizer::GetRangeChildren. '*ppRows'
+    // stays valid for the life of this object.
+    void GetRows(
+        _Out_ unsigned long long* pCount,
+        _Outptr_result_maybenull_ const uint64_t** ppRows
+    )
+    {
+        ObjectLock lock(this);
+        *pCount = m_count;
+        *ppRows = m_rows.empty() ? nullptr : m_rows.data();
+    }
+
+protected:
+    HRESULT STDMETHODCALLTYPE _InternalQueryInterface(REFIID riid, void** ppvObject)
+    {
+        if (ppvObject == NULL)
+            return E_POINTER;
+
+        if (riid == __uuidof(IUnknown))
+        {
+            *ppvObject = static_cast<IUnknown*>(this);
+            AddRef();
+            return S_OK;
+        }
+
+        *ppvObject = NULL;
+        return E_NOINTERFACE;
+    }
+};
@@ -2,23 +2,75 @@
 // Licensed under the MIT license. See LICENSE file in the project root for full license information.
 #include "stdafx.h"
 #include "RootVisualizer.h"
+#include "RangeVisualizer.h"
+#include "MemoryCacheDataItem.h"
+#include "TargetBitnessDataItem.h"
+#include "AddressFormat.h"
+#include "PerfTrace.h"
+#include "SummaryCacheDataItem.h"
+#include "ColumnSummary.h"
+#include "ParallelArrayExport.h"
+
+// VisualizerIds of the views which CppCustomVisualizer.natvis has besides the default one:
+// ',view(stats)', ',view(csv)', ',view(binary)' and ',view(buckets)'
+static const GUID SummaryVisualizerId = { 0x44468a83, 0x4b9e, 0x461f, { 0xb7, 0x1e, 0x4c, 0x47, 0xd7, 0x6b, 0x17, 0x8f } };
+static const GUID CsvExportVisualizerId = { 0x7af8e3c0, 0x7c4e, 0x4849, { 0xa6, 0x69, 0x20, 0x29, 0x30, 0x2c, 0x83, 0xd2 } };
+static const GUID BinaryExportVisualizerId = { 0x3106cd65, 0x7c83, 0x4d79, { 0xbb, 0x15, 0x1b, 0xe2, 0xc6, 0x70, 0xf3, 0x34 } };
+static const GUID BucketsVisualizerId = { 0x3505077e, 0x818e, 0x43a0, { 0xa9, 0x34, 0x32, 0x9e, 0xce, 0xf2, 0x83, 0x5e } };
 
 HRESULT CRootVisualizer::Initialize(
     _In_ DkmVisualizedExpression* pVisualizedExpression,
+    _In_ const ParallelArrayPlan& plan,
     _In_ unsigned long long size,
-    _In_ bool isPointer)
+    _In_ bool isPointer,
+    _In_opt_ const CAtlArray<VectorBounds>* pBounds)
 {
     m_pVisualizedExpression = pVisualizedExpression;
+    m_plan = plan;
     m_size = size;
     m_fIsPointer = isPointer;
+    m_fHasBounds = (pBounds != nullptr);
+    if (m_fHasBounds)
+    {
+        m_bounds.Copy(*pBounds);
+    }
+
+    const GUID& visualizerId = pVisualizedExpression->VisualizerId();
+    m_fShowSummary = IsEqualGUID(visualizerId, SummaryVisualizerId) != FALSE;
+    m_fBuckets = IsEqualGUID(visualizerId, BucketsVisualizerId) != FALSE;
+    if (IsEqualGUID(visualizerId, CsvExportVisualizerId))
+    {
+        m_fExport = true;
+        m_exportFormat = ExportFormat::Csv;
+    }
+    else if (IsEqualGUID(visualizerId, BinaryExportVisualizerId))
+    {
+        m_fExport = true;
+        m_exportFormat = ExportFormat::Binary;
+    }
+    else
+    {
+        m_fExport = false;
+    }
+
+    // Only columns of the same type as the first one are compared with it
+    m_fHasMismatches = false;
+    if (m_fHasBounds && m_size != 0)
+    {
+        for (size_t i = 1; i < m_plan.Columns.size(); i++)
+        {
+            m_fHasMismatches |= (m_plan.Columns[i].Type == m_plan.Columns[0].Type);
+        }
+    }
     return S_OK;
 }
 
 //static 
-HRESULT CRootVisualizer::CreateEvaluationResult(_In_ DkmVisualizedExpression* pVisualizedExpression, _Deref_out_ DkmEvaluationResult** ppResultObject)
+HRESULT CRootVisualizer::CreateEvaluationResult(_In_ DkmVisualizedExpression* pVisualizedExpression, _In_ const ParallelArrayTypes& types, _Deref_out_ DkmEvaluationResult** ppResultObject)
 {
     HRESULT hr = S_OK;
     *ppResultObject = nullptr;
+    CPerfTraceScope perfTrace("CreateEvaluationResult", 0);
 
     CComPtr<DkmRootVisualizedExpression> pRootVisualizedExpression = DkmRootVisualizedExpression::TryCast(pVisualizedExpression);
     if (pRootVisualizedExpression == nullptr)
@@ -31,43 +83,73 @@ HRESULT CRootVisualizer::CreateEvaluationResult(_In_ DkmVisualizedExpression* pV
     CComPtr<DkmString> pType = pRootVisualizedExpression->Type();
     DkmRootVisualizedExpressionFlags_t flags = pRootVisualizedExpression->Flags();
 
-    CString evalText;
     bool isPointer = (pType != nullptr && wcschr(pType->Value(), '*') != nullptr);
-    unsigned long long sizeA;
-    hr = GetSize(
-        pVisualizedExpression,
-        pFullName,
-        L"a",
-        isPointer,
-        &sizeA
-    );
+
+    ParallelArrayPlan plan;
+    hr = CParallelArrayPlanDataItem::GetPlan(pVisualizedExpression, pFullName, pType, isPointer, types, &plan);
     if (FAILED(hr))
     {
         return hr;
     }
+    if (hr != S_OK)
+    {
+        // There is no descriptor for this type
+        return E_NOTIMPL;
+    }
 
-    unsigned long long sizeB;
-    hr = GetSize(
+    // Prefer decoding all of the vectors straight out of target memory. This is a single read
+    // instead of one round trip through the expression evaluator per column.
+    CAtlArray<VectorBounds> bounds;
+    hr = ReadVectorBounds(
         pVisualizedExpression,
-        pFullName,
-        L"b",
-        isPointer,
-        &sizeB
+        plan,
+        bounds
     );
     if (FAILED(hr))
     {
         return hr;
     }
+    bool hasBounds = (hr == S_OK);
 
-    if (sizeA != sizeB)
+    // All of the columns need to have the same number of rows
+    unsigned long long size = 0;
+    for (size_t i = 0; i < plan.Columns.size(); i++)
     {
-        return E_FAIL;
+        unsigned long long columnSize;
+        if (hasBounds)
+        {
+            columnSize = bounds[i].Count(plan.Columns[i].ElementSize);
+        }
+        else
+        {
+            hr = GetSize(
+                pVisualizedExpression,
+                pFullName,
+                plan.Columns[i].Member.c_str(),
+                isPointer,
+                &columnSize
+            );
+            if (FAILED(hr))
+            {
+                return hr;
+            }
+        }
+
+        if (i == 0)
+        {
+            size = columnSize;
+        }
+        else if (columnSize != size)
+        {
+            return E_FAIL;
+        }
     }
+    perfTrace.SetSize(size);
 
     CComObject<CRootVisualizer>* pRootVisualizer;
     if (SUCCEEDED(hr = CComObject<CRootVisualizer>::CreateInstance(&pRootVisualizer)) && pRootVisualizer != nullptr)
     {
-        if (SUCCEEDED(hr = pRootVisualizer->Initialize(pVisualizedExpression, sizeA, isPointer)) && pVisualizedExpression != nullptr)
+        if (SUCCEEDED(hr = pRootVisualizer->Initialize(pVisualizedExpression, plan, size, isPointer, hasBounds ? &bounds : nullptr)) && pVisualizedExpression != nullptr)
         {
             pVisualizedExpression->SetDataItem(DkmDataCreationDisposition::CreateNew, pRootVisualizer);
 
@@ -101,7 +183,7 @@ HRESULT CRootVisualizer::CreateEvaluationResult(
     CComPtr<DkmPointerValueHome> pPointerValueHome = DkmPointerValueHome::TryCast(m_pVisualizedExpression->ValueHome());
     if (pPointerValueHome == nullptr)
     {
-        // This sample only handles visualizing in-memory Sample structures
+        // This sample only handles visualizing in-memory objects
         return E_NOTIMPL;
     }
 
@@ -116,26 +198,44 @@ HRESULT CRootVisualizer::CreateEvaluationResult(
     CString strValue;
     strValue.Format(L"Size = %llu", m_size);
 
+    // The summary needs to stream the columns out of target memory, so it isn't available when
+    // the rows have to go through the EE
+    if (m_fShowSummary && m_fHasBounds && m_size != 0)
+    {
+        hr = AppendSummary(pPointerValueHome->Address(), pInspectionContext, strValue);
+        if (FAILED(hr))
+        {
+            return hr;
+        }
+    }
+
+    // The export views write the rows to a file when the value is opened with the text
+    // visualizer, which is what DkmEvaluationResultFlags::RawString offers
+    bool canExport = (m_fExport && m_fHasBounds);
+    if (canExport)
+    {
+        strValue.Append(m_exportFormat == ExportFormat::Csv ?
+            L"; opening with the Text Visualizer writes all rows to a .csv file in %TEMP%" :
+            L"; opening with the Text Visualizer writes all rows to a .bin file in %TEMP%");
+    }
+
     CString strEditableValue;
 
     // If we are formatting a pointer, we want to also show the address of the pointer
     if (m_fIsPointer)
     {
         // Make the editable value just the pointer string
-        UINT64 address = pPointerValueHome->Address();
-        DkmProcess* pTargetProcess = pInspectionContext->RuntimeInstance()->Process();
-        if ((pTargetProcess->SystemInformation()->Flags() & DefaultPort::DkmSystemInformationFlags::Is64Bit) != 0)
-        {
-            strEditableValue.Format(L"0x%08x%08x", static_cast<DWORD>(address >> 32), static_cast<DWORD>(address));
-        }
-        else
-        {
-            strEditableValue.Format(L"0x%08x", static_cast<DWORD>(address));
-        }
+        WCHAR addressText[AddressFormatBufferLength];
+        size_t addressLength = FormatAddress(pPointerValueHome->Address(), CTargetBitnessDataItem::GetPointerSize(pInspectionContext->RuntimeInstance()->Process()), addressText);
+        strEditableValue.SetString(addressText, static_cast<int>(addressLength));
 
         // Prefix the value with the address
         CString strValueWithAddress;
-        strValueWithAddress.Format(L"%s {%s}", static_cast<LPCWSTR>(strEditableValue), static_cast<LPCWSTR>(strValue));
+        strValueWithAddress.Preallocate(static_cast<int>(addressLength) + 3 + strValue.GetLength());
+        strValueWithAddress.Append(addressText, static_cast<int>(addressLength));
+        strValueWithAddress.Append(L" {");
+        strValueWithAddress.Append(strValue);
+        strValueWithAddress.AppendChar(L'}');
         strValue = strValueWithAddress;
     }
 
@@ -163,6 +263,10 @@ HRESULT CRootVisualizer::CreateEvaluationResult(
         // We only allow editting pointers, so mark non-pointers as read-only
         resultFlags |= DkmEvaluationResultFlags::ReadOnly;
     }
+    if (canExport)
+    {
+        resultFlags |= DkmEvaluationResultFlags::RawString;
+    }
 
     CComPtr<DkmSuccessEvaluationResult> pSuccessEvaluationResult;
     hr = DkmSuccessEvaluationResult::Create(
@@ -201,13 +305,33 @@ HRESULT CRootVisualizer::GetChildren(
     _Deref_out_ DkmEvaluationResultEnumContext** ppEnumContext
 )
 {
+    if (!m_fHasMismatches)
+    {
+        return GetRangeChildren(
+            m_pVisualizedExpression,
+            0,
+            m_size,
+            nullptr,
+            this,
+            &m_pRowDescriptor,
+            InitialRequestSize,
+            pInspectionContext,
+            pInitialChildren,
+            ppEnumContext
+        );
+    }
+
     HRESULT hr = S_OK;
     pInitialChildren->Members = nullptr;
     pInitialChildren->Length = 0;
 
+    // The rows (or buckets) are followed by '[Mismatches]'. GetBucketSize leaves room for it, so
+    // its index fits in 32 bits.
+    unsigned long long childCount = GetRangeChildCount(m_size) + 1;
+
     CComPtr<DkmEvaluationResultEnumContext> pEnumContext;
     hr = DkmEvaluationResultEnumContext::Create(
-        (DWORD) min(m_size, (unsigned long long)UINT_MAX),
+        (DWORD)childCount,
         m_pVisualizedExpression->StackFrame(),
         pInspectionContext,
         this,
@@ -237,20 +361,191 @@ HRESULT CRootVisualizer::GetItems(
 {
     HRESULT hr = S_OK;
 
-    CComPtr<DkmPointerValueHome> pPointerValueHome = DkmPointerValueHome::TryCast(pVisualizedExpression->ValueHome());
+    unsigned long long rangeChildCount = GetRangeChildCount(m_size);
+    if (!m_fHasMismatches || (unsigned long long)StartIndex + Count <= rangeChildCount)
+    {
+        return GetRangeItems(pVisualizedExpression, 0, m_size, nullptr, &m_pRowDescriptor, StartIndex, Count, pItems);
+    }
+
+    // The page reaches '[Mismatches]', which comes after the rows of the range
+    CAutoDkmArray<DkmChildVisualizedExpression*> rangeItems;
+    if (StartIndex < rangeChildCount)
+    {
+        hr = GetRangeItems(pVisualizedExpression, 0, m_size, nullptr, &m_pRowDescriptor, StartIndex, (UINT32)(rangeChildCount - StartIndex), &rangeItems);
+        if (FAILED(hr))
+        {
+            return hr;
+        }
+    }
+
+    UINT32 itemCount = (StartIndex <= rangeChildCount) ? rangeItems.Length + 1 : 0;
+
+    CAutoDkmArray<DkmChildVisualizedExpression*> resultValues;
+    hr = DkmAllocArray(itemCount, &resultValues);
+    if (FAILED(hr))
+    {
+        return hr;
+    }
+
+    if (itemCount != 0)
+    {
+        for (UINT32 i = 0; i < rangeItems.Length; i++)
+        {
+            resultValues.Members[i] = rangeItems.Members[i];
+            resultValues.Members[i]->AddRef();
+        }
+
+        hr = CreateMismatches(pVisualizedExpression, (UINT32)rangeChildCount, &resultValues.Members[rangeItems.Length]);
+        if (FAILED(hr))
+        {
+            return hr;
+        }
+    }
+
+    *pItems = resultValues.Detach();
+
+    return hr;
+}
+
+unsigned long long CRootVisualizer::GetBucketSize(_In_ unsigned long long count)
+{
+    // Outside of the 'buckets' view, the rows are only split into buckets when there are too
+    // many to list in an enum context, which also needs room for '[Mismatches]' after them
+    if (count <= MaxFlatChildren || (!m_fBuckets && count < UINT_MAX))
+    {
+        return 0;
+    }
+
+    // Pick the smallest power of BucketFanout which splits the range into at most BucketFanout
+    // buckets. So 50M elements become buckets of 1M, those become buckets of 10K, and so on.
+    unsigned long long bucketSize = BucketFanout;
+    while ((count - 1) / bucketSize >= BucketFanout)
+    {
+        bucketSize *= BucketFanout;
+    }
+
+    return bucketSize;
+}
+
+unsigned long long CRootVisualizer::GetRangeChildCount(_In_ unsigned long long count)
+{
+    unsigned long long bucketSize = GetBucketSize(count);
+    return (bucketSize == 0) ? count : (count + bucketSize - 1) / bucketSize;
+}
+
+HRESULT CRootVisualizer::GetRangeChildren(
+    _In_ DkmVisualizedExpression* pParent,
+    _In_ unsigned long long first,
+    _In_ unsigned long long count,
+    _In_reads_opt_(count) const uint64_t* pRowIndices,
+    _In_ const DkmDataItem& enumDataItem,
+    _Inout_ CComPtr<CChildVisualizer>* ppRowDescriptor,
+    _In_ UINT32 InitialRequestSize,
+    _In_ DkmInspectionContext* pInspectionContext,
+    _Out_ DkmArray<DkmChildVisualizedExpression*>* pInitialChildren,
+    _Deref_out_ DkmEvaluationResultEnumContext** ppEnumContext
+)
+{
+    HRESULT hr = S_OK;
+    pInitialChildren->Members = nullptr;
+    pInitialChildren->Length = 0;
+    CPerfTraceScope perfTrace("GetChildren", count, first, 0, InitialRequestSize);
+
+    // Ranges which are too large to list are split into buckets (see GetBucketSize), so the
+    // number of direct children always fits in 32 bits
+    unsigned long long childCount = GetRangeChildCount(count);
+
+    CComPtr<DkmEvaluationResultEnumContext> pEnumContext;
+    hr = DkmEvaluationResultEnumContext::Create(
+        (DWORD)childCount,
+        m_pVisualizedExpression->StackFrame(),
+        pInspectionContext,
+        enumDataItem,
+        &pEnumContext);
+    if (FAILED(hr))
+    {
+        return hr;
+    }
+
+    if (InitialRequestSize > 0)
+    {
+        GetRangeItems(pParent, first, count, pRowIndices, ppRowDescriptor, 0, InitialRequestSize, pInitialChildren);
+    }
+
+    *ppEnumContext = pEnumContext.Detach();
+
+    return hr;
+}
+
+HRESULT CRootVisualizer::GetRangeItems(
+    _In_ DkmVisualizedExpression* pParent,
+    _In_ unsigned long long first,
+    _In_ unsigned long long count,
+    _In_reads_opt_(count) const uint64_t* pRowIndices,
+    _Inout_ CComPtr<CChildVisualizer>* ppRowDescriptor,
+    _In_ UINT32 StartIndex,
+    _In_ UINT32 Count,
+    _Out_ DkmArray<DkmChildVisualizedExpression*>* pItems
+)
+{
+    HRESULT hr = S_OK;
+    UINT64 allocations = 0;
+    CPerfTraceScope perfTrace("GetItems", count, first, StartIndex, Count);
+
+    // A list of rows is never longer than CSummaryCacheDataItem::MaxMismatches, so it is never
+    // split into buckets
+    unsigned long long bucketSize = (pRowIndices == nullptr) ? GetBucketSize(count) : 0;
+    unsigned long long childCount = (bucketSize == 0) ? count : (count + bucketSize - 1) / bucketSize;
+    UINT32 itemCount = (StartIndex < childCount) ? (UINT32)min((unsigned long long)Count, childCount - StartIndex) : 0;
 
-    CAtlList<CComPtr<DkmChildVisualizedExpression>> childItems;
+    // The number of items is known up front, so they go straight into the result array
+    CAutoDkmArray<DkmChildVisualizedExpression*> resultValues;
+    hr = DkmAllocArray(itemCount, &resultValues);
+    if (FAILED(hr))
+    {
+        return hr;
+    }
+    allocations++;
 
-    for (UINT32 i = StartIndex; i < Count + StartIndex && i < m_size; i++)
+    if (bucketSize != 0)
     {
-        CComPtr<DkmPointerValueHome> pParentPointerValueHome = DkmPointerValueHome::TryCast(pVisualizedExpression->ValueHome());
+        for (UINT32 i = 0; i < itemCount; i++)
+        {
+            unsigned long long bucketFirst = first + (StartIndex + i) * bucketSize;
+            unsigned long long bucketCount = min(bucketSize, first + count - bucketFirst);
+
+            hr = CreateBucket(pParent, StartIndex + i, bucketFirst, bucketCount, &resultValues.Members[i], &allocations);
+            if (FAILED(hr))
+            {
+                return hr;
+            }
+        }
+    }
+    else if (itemCount != 0)
+    {
+        CComPtr<CChildVisualizer> pRowDescriptor;
+        hr = GetRowDescriptor(first, pRowIndices, count, ppRowDescriptor, &pRowDescriptor, &allocations);
+        if (FAILED(hr))
+        {
+            return hr;
+        }
+
+        // The values of the page are read when one of its rows is expanded
+        if (pRowIndices == nullptr)
+        {
+            pRowDescriptor->SetPage(first + StartIndex, itemCount);
+        }
+
+        CComPtr<DkmPointerValueHome> pPointerValueHome = DkmPointerValueHome::TryCast(pParent->ValueHome());
 
+        // None of these depend on the row, so they are shared by the whole page
         CComPtr<DkmString> pChildName;
         hr = DkmString::Create(DkmSourceString(L"[Index]"), &pChildName);
         if (FAILED(hr))
         {
             return hr;
         }
+        allocations++;
 
         CComPtr<DkmString> pChildFullName;
         hr = m_pVisualizedExpression->CreateDefaultChildFullName(0, &pChildFullName);
@@ -258,142 +553,563 @@ HRESULT CRootVisualizer::GetItems(
         {
             return hr;
         }
+        allocations++;
 
-        CComObject<CChildVisualizer>* pChildVisualizer;
-        CComObject<CChildVisualizer>::CreateInstance(&pChildVisualizer);
-        if (pChildVisualizer == NULL)
+        for (UINT32 i = 0; i < itemCount; i++)
         {
-            return E_OUTOFMEMORY;
+            unsigned long long index = (pRowIndices == nullptr) ? first + StartIndex + i : pRowIndices[StartIndex + i];
+
+            CComPtr<DkmEvaluationResult> pEvaluationResult;
+            hr = pRowDescriptor->CreateEvaluationResult(
+                pChildName,
+                pChildFullName,
+                nullptr,
+                DkmRootVisualizedExpressionFlags::None,
+                pParent,
+                m_pVisualizedExpression->InspectionContext(),
+                index,
+                &pEvaluationResult,
+                &allocations
+            );
+            if (FAILED(hr))
+            {
+                return hr;
+            }
+
+            hr = DkmChildVisualizedExpression::Create(
+                m_pVisualizedExpression->InspectionContext(),
+                m_pVisualizedExpression->VisualizerId(),
+                m_pVisualizedExpression->SourceId(),
+                m_pVisualizedExpression->StackFrame(),
+                pPointerValueHome,
+                pEvaluationResult,
+                pParent,
+                StartIndex + i,
+                pRowDescriptor,
+                &resultValues.Members[i]
+            );
+            if (FAILED(hr))
+            {
+                return hr;
+            }
+            allocations++;
         }
-        pChildVisualizer->Initialize(m_pVisualizedExpression, m_size, i, m_fIsPointer);
+    }
 
-        CComPtr<DkmEvaluationResult> pEvaluationResult;
-        hr = pChildVisualizer->CreateEvaluationResult(
-            pChildName,
-            pChildFullName,
-            nullptr,
-            DkmRootVisualizedExpressionFlags::None,
-            m_pVisualizedExpression,
-            m_pVisualizedExpression->InspectionContext(),
-            i,
-            &pEvaluationResult
-        );
+    *pItems = resultValues.Detach();
+
+    InterlockedIncrement64(&m_getItemsCalls);
+    InterlockedExchangeAdd64(&m_getItemsAllocations, allocations);
+    perfTrace.SetAllocations(allocations);
+
+    return hr;
+}
+
+HRESULT CRootVisualizer::GetRowDescriptor(
+    _In_ unsigned long long first,
+    _In_reads_opt_(count) const uint64_t* pRowIndices,
+    _In_ unsigned long long count,
+    _Inout_ CComPtr<CChildVisualizer>* ppRowDescriptor,
+    _Deref_out_ CChildVisualizer** ppResult,
+    _Inout_ UINT64* pAllocations
+)
+{
+    HRESULT hr = S_OK;
+
+    ObjectLock lock(this);
+
+    if (*ppRowDescriptor == nullptr)
+    {
+        CComObject<CChildVisualizer>* pChildVisualizer;
+        hr = CComObject<CChildVisualizer>::CreateInstance(&pChildVisualizer);
         if (FAILED(hr))
         {
             return hr;
         }
+        CComPtr<CChildVisualizer> pRowDescriptor(pChildVisualizer);
 
-        CComPtr<DkmChildVisualizedExpression> pChildVisualizedExpression;
-        hr = DkmChildVisualizedExpression::Create(
-            m_pVisualizedExpression->InspectionContext(),
-            m_pVisualizedExpression->VisualizerId(),
-            m_pVisualizedExpression->SourceId(),
-            m_pVisualizedExpression->StackFrame(),
-            pPointerValueHome,
-            pEvaluationResult,
-            m_pVisualizedExpression,
-            i,
-            pChildVisualizer,
-            &pChildVisualizedExpression
-        );
+        hr = pRowDescriptor->Initialize(m_pVisualizedExpression, m_plan, m_size, first, m_fIsPointer, m_fHasBounds ? m_bounds.GetData() : nullptr);
         if (FAILED(hr))
         {
             return hr;
         }
+        if (pRowIndices != nullptr)
+        {
+            pRowDescriptor->SetRowIndices(pRowIndices, (size_t)count);
+        }
 
-        childItems.AddTail(pChildVisualizedExpression);
+        *ppRowDescriptor = pRowDescriptor;
+        (*pAllocations)++;
     }
 
-    CAutoDkmArray<DkmChildVisualizedExpression*> resultValues;
-    DkmAllocArray(childItems.GetCount(), &resultValues);
+    *ppResult = CComPtr<CChildVisualizer>(*ppRowDescriptor).Detach();
+    return hr;
+}
+
+void CRootVisualizer::GetAllocationStatistics(
+    _Out_ UINT64* pGetItemsCalls,
+    _Out_ UINT64* pAllocations
+)
+{
+    *pGetItemsCalls = (UINT64)m_getItemsCalls;
+    *pAllocations = (UINT64)m_getItemsAllocations;
+}
+
+HRESULT CRootVisualizer::CreateBucket(
+    _In_ DkmVisualizedExpression* pParent,
+    _In_ UINT32 index,
+    _In_ unsigned long long first,
+    _In_ unsigned long long count,
+    _Deref_out_ DkmChildVisualizedExpression** ppResult,
+    _Inout_ UINT64* pAllocations
+)
+{
+    HRESULT hr = S_OK;
+
+    CComObject<CRangeVisualizer>* pRangeVisualizer;
+    hr = CComObject<CRangeVisualizer>::CreateInstance(&pRangeVisualizer);
+    if (FAILED(hr))
+    {
+        return hr;
+    }
+    (*pAllocations)++;
+    CComPtr<CRangeVisualizer> pRange(pRangeVisualizer);
+    pRange->Initialize(this, first, count);
+
+    CString strName;
+    strName.Format(L"[%llu..%llu]", first, first + count - 1);
+
+    CComPtr<DkmString> pName;
+    hr = DkmString::Create(DkmSourceString(strName), &pName);
     if (FAILED(hr))
     {
         return hr;
     }
+    (*pAllocations)++;
+
+    CString strValue;
+    strValue.Format(L"Count = %llu", count);
 
-    UINT32 j = 0;
-    POSITION pos = childItems.GetHeadPosition();
-    while (pos != NULL)
+    CComPtr<DkmString> pValue;
+    hr = DkmString::Create(DkmSourceString(strValue), &pValue);
+    if (FAILED(hr))
     {
-        CComPtr<DkmChildVisualizedExpression> pCurr = childItems.GetNext(pos);
-        resultValues.Members[j] = pCurr.Detach();
-        j++;
+        return hr;
     }
+    (*pAllocations)++;
 
-    *pItems = resultValues.Detach();
+    // A range isn't an expression of its own, so there is no full name to add to the watch window
+    CComPtr<DkmSuccessEvaluationResult> pEvaluationResult;
+    hr = DkmSuccessEvaluationResult::Create(
+        m_pVisualizedExpression->InspectionContext(),
+        m_pVisualizedExpression->StackFrame(),
+        pName,
+        nullptr,
+        DkmEvaluationResultFlags::Expandable | DkmEvaluationResultFlags::ReadOnly,
+        pValue,
+        pValue,
+        nullptr,
+        DkmEvaluationResultCategory::Data,
+        DkmEvaluationResultAccessType::None,
+        DkmEvaluationResultStorageType::None,
+        DkmEvaluationResultTypeModifierFlags::None,
+        nullptr,
+        nullptr,
+        (DkmReadOnlyCollection<DkmModuleInstance*>*)nullptr,
+        DkmDataItem::Null(),
+        &pEvaluationResult
+    );
+    if (FAILED(hr))
+    {
+        return hr;
+    }
+    (*pAllocations)++;
+
+    CComPtr<DkmChildVisualizedExpression> pChildVisualizedExpression;
+    hr = DkmChildVisualizedExpression::Create(
+        m_pVisualizedExpression->InspectionContext(),
+        m_pVisualizedExpression->VisualizerId(),
+        m_pVisualizedExpression->SourceId(),
+        m_pVisualizedExpression->StackFrame(),
+        nullptr,
+        pEvaluationResult,
+        pParent,
+        index,
+        pRange,
+        &pChildVisualizedExpression
+    );
+    if (FAILED(hr))
+    {
+        return hr;
+    }
+    (*pAllocations)++;
+
+    *ppResult = pChildVisualizedExpression.Detach();
 
     return hr;
 }
 
-HRESULT CRootVisualizer::GetSize(
-    _In_ Evaluation::DkmVisualizedExpression* pVisualizedExpression,
-    _In_ DkmString* pFullName,
-    _In_ LPCWSTR pMemberName,
-    _In_ bool rootIsPointer,
-    _Out_ unsigned long long* pSize
+HRESULT CRootVisualizer::CreateMismatches(
+    _In_ DkmVisualizedExpression* pParent,
+    _In_ UINT32 index,
+    _Deref_out_ DkmChildVisualizedExpression** ppResult
 )
 {
     HRESULT hr = S_OK;
 
-    CString evalText;
-    if (rootIsPointer)
+    // Ex: 'Count = 3', 'Count >= 100' or 'Count = 3 (first 1048576 rows)' once the rows have been
+    // looked for
+    ParallelArrayMismatches mismatches;
+    hr = GetMismatches(m_pVisualizedExpression->InspectionContext(), false, &mismatches);
+    if (FAILED(hr))
     {
-        evalText.Format(L"(%s)->%s.size()", pFullName->Value(), pMemberName);
+        return hr;
+    }
+    bool found = (hr == S_OK);
+
+    CString strValue;
+    if (!found)
+    {
+        strValue = L"Expand to compare the columns";
     }
     else
     {
-        evalText.Format(L"(%s).%s.size()", pFullName->Value(), pMemberName);
+        strValue.Format(mismatches.ReachedLimit ? L"Count >= %llu" : L"Count = %llu", (unsigned long long)mismatches.Rows.size());
+        if (!mismatches.ReachedLimit && mismatches.RowCount < m_size)
+        {
+            strValue.AppendFormat(L" (first %llu rows)", mismatches.RowCount);
+        }
     }
-    CComPtr<DkmString> pEvalText;
-    hr = DkmString::Create(DkmSourceString(evalText), &pEvalText);
+
+    CComPtr<DkmString> pValue;
+    hr = DkmString::Create(DkmSourceString(strValue), &pValue);
     if (FAILED(hr))
     {
         return hr;
     }
 
-    CComPtr<DkmLanguageExpression> pLanguageExpression;
-    hr = DkmLanguageExpression::Create(
-        pVisualizedExpression->InspectionContext()->Language(),
-        DkmEvaluationFlags::TreatAsExpression,
-        pEvalText,
+    CComPtr<DkmString> pName;
+    hr = DkmString::Create(DkmSourceString(L"[Mismatches]"), &pName);
+    if (FAILED(hr))
+    {
+        return hr;
+    }
+
+    CComObject<CRangeVisualizer>* pRangeVisualizer;
+    hr = CComObject<CRangeVisualizer>::CreateInstance(&pRangeVisualizer);
+    if (FAILED(hr))
+    {
+        return hr;
+    }
+    CComPtr<CRangeVisualizer> pRange(pRangeVisualizer);
+
+    DkmEvaluationResultFlags_t resultFlags = DkmEvaluationResultFlags::ReadOnly;
+    if (!found)
+    {
+        resultFlags |= DkmEvaluationResultFlags::Expandable;
+        pRange->InitializeMismatches(this);
+    }
+    else
+    {
+        if (!mismatches.Rows.empty())
+        {
+            resultFlags |= DkmEvaluationResultFlags::Expandable;
+        }
+        pRange->Initialize(this, mismatches.Rows);
+    }
+
+    CComPtr<DkmSuccessEvaluationResult> pEvaluationResult;
+    hr = DkmSuccessEvaluationResult::Create(
+        m_pVisualizedExpression->InspectionContext(),
+        m_pVisualizedExpression->StackFrame(),
+        pName,
+        nullptr,
+        resultFlags,
+        pValue,
+        pValue,
+        nullptr,
+        DkmEvaluationResultCategory::Data,
+        DkmEvaluationResultAccessType::None,
+        DkmEvaluationResultStorageType::None,
+        DkmEvaluationResultTypeModifierFlags::None,
+        nullptr,
+        nullptr,
+        (DkmReadOnlyCollection<DkmModuleInstance*>*)nullptr,
         DkmDataItem::Null(),
-        &pLanguageExpression
+        &pEvaluationResult
     );
     if (FAILED(hr))
     {
         return hr;
     }
-    CComPtr<DkmEvaluationResult> pEvalResult;
-    hr = pVisualizedExpression->EvaluateExpressionCallback(
-        pVisualizedExpression->InspectionContext(),
-        pLanguageExpression,
-        pVisualizedExpression->StackFrame(),
-        &pEvalResult
+
+    CComPtr<DkmChildVisualizedExpression> pChildVisualizedExpression;
+    hr = DkmChildVisualizedExpression::Create(
+        m_pVisualizedExpression->InspectionContext(),
+        m_pVisualizedExpression->VisualizerId(),
+        m_pVisualizedExpression->SourceId(),
+        m_pVisualizedExpression->StackFrame(),
+        nullptr,
+        pEvaluationResult,
+        pParent,
+        index,
+        pRange,
+        &pChildVisualizedExpression
     );
     if (FAILED(hr))
     {
         return hr;
     }
 
-    CComPtr<DkmSuccessEvaluationResult> pSuccessEvalResult = DkmSuccessEvaluationResult::TryCast(pEvalResult);
-    if (pSuccessEvalResult == nullptr)
+    *ppResult = pChildVisualizedExpression.Detach();
+
+    return hr;
+}
+
+HRESULT CRootVisualizer::ReadVectorBounds(
+    _In_ Evaluation::DkmVisualizedExpression* pVisualizedExpression,
+    _In_ const ParallelArrayPlan& plan,
+    _Out_ CAtlArray<VectorBounds>& bounds
+)
+{
+    HRESULT hr = S_OK;
+    bounds.RemoveAll();
+
+    CComPtr<DkmPointerValueHome> pPointerValueHome = DkmPointerValueHome::TryCast(pVisualizedExpression->ValueHome());
+    if (pPointerValueHome == nullptr || !plan.HasOffsets)
+    {
+        return S_FALSE;
+    }
+
+    if (!bounds.SetCount(plan.Columns.size()))
+    {
+        return E_OUTOFMEMORY;
+    }
+
+    auto reader = [pVisualizedExpression](uint64_t address, void* pBuffer, uint32_t size) -> bool
+    {
+        return SUCCEEDED(CMemoryCacheDataItem::ReadMemory(pVisualizedExpression, address, pBuffer, size));
+    };
+
+    if (!ReadParallelArrayBounds(plan, pPointerValueHome->Address(), reader, bounds.GetData()))
+    {
+        // The memory can't be read or doesn't look like the vectors of the plan. Let the EE sort
+        // it out.
+        bounds.RemoveAll();
+        return S_FALSE;
+    }
+
+    return S_OK;
+}
+
+HRESULT CRootVisualizer::GetMismatches(
+    _In_ DkmInspectionContext* pInspectionContext,
+    _In_ bool search,
+    _Out_ ParallelArrayMismatches* pMismatches
+)
+{
+    CComPtr<DkmPointerValueHome> pPointerValueHome = DkmPointerValueHome::TryCast(m_pVisualizedExpression->ValueHome());
+    if (pPointerValueHome == nullptr)
+    {
+        return E_NOTIMPL;
+    }
+
+    CPerfTraceScope perfTrace("Mismatches", m_size);
+    return CSummaryCacheDataItem::GetMismatches(pInspectionContext, m_plan, pPointerValueHome->Address(), m_bounds.GetData(), m_size, search, pMismatches);
+}
+
+HRESULT CRootVisualizer::AppendSummary(
+    _In_ UINT64 address,
+    _In_ DkmInspectionContext* pInspectionContext,
+    _Inout_ CString& value
+)
+{
+    HRESULT hr = S_OK;
+    CPerfTraceScope perfTrace("Summary", m_size);
+
+    ParallelArraySummary summary;
+    hr = CSummaryCacheDataItem::GetSummary(pInspectionContext, m_plan, address, m_bounds.GetData(), m_size, &summary);
+    if (FAILED(hr))
+    {
+        return hr;
+    }
+
+    // Ex: 'Size = 5; A: min=1 max=5 sum=15 mean=3; B: min=1 max=5 sum=15 mean=3; A == B'
+    bool hex = (pInspectionContext->Radix() == 16);
+    for (size_t i = 0; i < m_plan.Columns.size(); i++)
     {
-        return E_FAIL;
+        const ParallelArrayColumn& column = m_plan.Columns[i];
+        const ColumnSummary& columnSummary = summary.Columns[i];
+
+        value.AppendFormat(L"; %s:", column.DisplayName.c_str());
+        if (columnSummary.HasValues())
+        {
+            WCHAR minText[ColumnValueBufferLength];
+            WCHAR maxText[ColumnValueBufferLength];
+            FormatColumnValue(column.Type, columnSummary.Min, hex, minText);
+            FormatColumnValue(column.Type, columnSummary.Max, hex, maxText);
+            value.AppendFormat(L" min=%s max=%s sum=%.15g mean=%.15g", minText, maxText, columnSummary.Sum, columnSummary.Mean());
+        }
+        if (column.Type == ColumnType::Float || column.Type == ColumnType::Double)
+        {
+            value.AppendFormat(L" NaN=%llu", columnSummary.NaNCount);
+        }
     }
 
-    CComPtr<DkmString> pValue = pSuccessEvalResult->Value();
-    if (pValue == nullptr)
+    for (size_t i = 1; i < m_plan.Columns.size(); i++)
     {
-        return E_FAIL;
+        if (m_plan.Columns[i].Type == m_plan.Columns[0].Type)
+        {
+            value.AppendFormat(
+                summary.EqualsFirst[i] ? L"; %s == %s" : L"; %s != %s",
+                m_plan.Columns[0].DisplayName.c_str(),
+                m_plan.Columns[i].DisplayName.c_str());
+        }
     }
 
-    LPCWSTR sizeStr = pValue->Value();
-    LPWSTR endPtr;
-    *pSize = wcstoull(sizeStr, &endPtr, 0);
-    if (sizeStr == endPtr)
+    if (!summary.Complete)
     {
-        return E_FAIL;
+        value.AppendFormat(L" (first %llu rows)", summary.RowCount);
     }
 
     return hr;
+}
+
+HRESULT CRootVisualizer::Export(
+    _Deref_out_ DkmString** ppResult
+)
+{
+    HRESULT hr = S_OK;
+    *ppResult = nullptr;
+
+    if (!m_fExport || !m_fHasBounds)
+    {
+        return E_NOTIMPL;
+    }
+    CPerfTraceScope perfTrace("Export", m_size);
+
+    CComCritSecLock<CComAutoCriticalSection> lock(m_exportLock);
+    if (m_pExportResult != nullptr && GetFileAttributesW(m_exportPath) != INVALID_FILE_ATTRIBUTES)
+    {
+        *ppResult = CComPtr<DkmString>(m_pExportResult).Detach();
+        return S_OK;
+    }
+
+    // Ex: '%TEMP%\sample1M-12345678.csv'. Only keep characters of the root's name which can be
+    // used in a file name.
+    CString name(L"export");
+    CComPtr<DkmRootVisualizedExpression> pRootVisualizedExpression = DkmRootVisualizedExpression::TryCast(m_pVisualizedExpression);
+    if (pRootVisualizedExpression != nullptr && pRootVisualizedExpression->Name() != nullptr)
+    {
+        name = pRootVisualizedExpression->Name()->Value();
+        for (int i = 0; i < name.GetLength(); i++)
+        {
+            if (!iswalnum(name[i]))
+            {
+                name.SetAt(i, L'_');
+            }
+        }
+    }
+
+    WCHAR tempPath[MAX_PATH];
+    DWORD tempPathLength = GetTempPathW(_countof(tempPath), tempPath);
+    if (tempPathLength == 0 || tempPathLength >= _countof(tempPath))
+    {
+        return HRESULT_FROM_WIN32(GetLastError());
+    }
+
+    CString path;
+    path.Format(L"%s%s-%llu.%s", tempPath, name.GetString(), GetTickCount64(), m_exportFormat == ExportFormat::Csv ? L"csv" : L"bin");
+
+    // The CRT opens the file with CreateFile, so the reason it failed is the last Win32 error
+    FILE* pFile = nullptr;
+    SetLastError(ERROR_SUCCESS);
+    if (_wfopen_s(&pFile, path, L"wb") != 0 || pFile == nullptr)
+    {
+        DWORD error = GetLastError();
+        return (error != ERROR_SUCCESS) ? HRESULT_FROM_WIN32(error) : E_FAIL;
+    }
+
+    // Stream the columns straight from the process, like the summary does. Only the file is
+    // written from another thread.
+    DkmProcess* pProcess = m_pVisualizedExpression->RuntimeInstance()->Process();
+    auto reader = [pProcess](uint64_t readAddress, void* pReadBuffer, uint32_t readSize) -> bool
+    {
+#pragma prefast(suppress:6387, "pBytesRead is unused and can be null")
+        return SUCCEEDED(pProcess->ReadMemory(readAddress, DkmReadMemoryFlags::None, pReadBuffer, readSize, nullptr));
+    };
+    auto writer = [pFile](const void* pBuffer, size_t size) -> bool
+    {
+        return fwrite(pBuffer, 1, size, pFile) == size;
+    };
+
+    // ExportParallelArrays reports running out of memory, or failing to start its writer thread,
+    // with exceptions, which must not get past this method
+    uint64_t rowsWritten = 0;
+    bool succeeded = false;
+    try
+    {
+        succeeded = ExportParallelArrays(m_plan, m_bounds.GetData(), m_size, m_exportFormat, reader, writer, &rowsWritten);
+    }
+    catch (const std::bad_alloc&)
+    {
+        hr = E_OUTOFMEMORY;
+    }
+    catch (const std::exception&)
+    {
+        hr = E_FAIL;
+    }
+    succeeded = (fclose(pFile) == 0) && succeeded;
+    if (FAILED(hr))
+    {
+        return hr;
+    }
+
+    CString strResult;
+    if (succeeded)
+    {
+        strResult.Format(L"Exported %llu rows to %s", rowsWritten, path.GetString());
+    }
+    else
+    {
+        strResult.Format(L"Export stopped after %llu of %llu rows: %s", rowsWritten, m_size, path.GetString());
+    }
+
+    CComPtr<DkmString> pResult;
+    hr = DkmString::Create(DkmSourceString(strResult), &pResult);
+    if (FAILED(hr))
+    {
+        return hr;
+    }
+
+    // A partial export is tried again the next time
+    if (succeeded)
+    {
+        m_exportPath = path;
+        m_pExportResult = pResult;
+    }
+
+    *ppResult = pResult.Detach();
+    return hr;
+}
+
+HRESULT CRootVisualizer::GetSize(
+    _In_ Evaluation::DkmVisualizedExpression* pVisualizedExpression,
+    _In_ DkmString* pFullName,
+    _In_ LPCWSTR pMemberName,
+    _In_ bool rootIsPointer,
+    _Out_ unsigned long long* pSize
+)
+{
+    CString evalText;
+    if (rootIsPointer)
+    {
+        evalText.Format(L"(%s)->%s.size()", pFullName->Value(), pMemberName);
+    }
+    else
+    {
+        evalText.Format(L"(%s).%s.size()", pFullName->Value(), pMemberName);
+    }
+
+    return EvaluateUInt64(pVisualizedExpression, evalText, pSize);
 }
\ No newline at end of file
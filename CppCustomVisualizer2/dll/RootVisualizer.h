@@ -3,6 +3,10 @@
 #pragma once
 
 #include "ChildVisualizer.h"
+#include "VectorLayout.h"
+#include "ParallelArrayPlanDataItem.h"
+#include "ParallelArrayExport.h"
+#include "ColumnSummary.h"
 
 class ATL_NO_VTABLE __declspec(uuid("1b029bbd-27fa-4872-b27a-bad9a22d6603")) CRootVisualizer :
     public IUnknown,
@@ -10,14 +14,50 @@ class ATL_NO_VTABLE __declspec(uuid("1b029bbd-27fa-4872-b27a-bad9a22d6603")) CRo
 {
 private:
     CComPtr<DkmVisualizedExpression> m_pVisualizedExpression;
+    // The columns of the visualized type
+    ParallelArrayPlan m_plan;
     unsigned long long m_size;
     bool m_fIsPointer;
+    // Begin/end/capacity of each column, indexed like m_plan.Columns. Only valid if m_fHasBounds
+    // is set, which is the case when the vectors were decoded directly from target memory.
+    CAtlArray<VectorBounds> m_bounds;
+    bool m_fHasBounds;
+    // Set for the 'stats' view, which adds summary statistics of the columns to the value
+    bool m_fShowSummary;
+    // Set for the 'buckets' view, which splits large ranges into buckets
+    bool m_fBuckets;
+    // Set for the 'csv' and 'binary' views, which export the rows to a file from
+    // GetUnderlyingString
+    bool m_fExport;
+    ExportFormat::e m_exportFormat;
+    // The file the rows were exported to and the message returned for it, once an export
+    // finished, so that opening the string again doesn't write another file. m_exportLock is held
+    // for the whole export, so concurrent requests wait for the first one and reuse its file.
+    CComAutoCriticalSection m_exportLock;
+    CString m_exportPath;
+    CComPtr<DkmString> m_pExportResult;
+    // Set if the root has a '[Mismatches]' child after its rows, which needs m_fHasBounds and a
+    // column with the same type as the first one to compare it with
+    bool m_fHasMismatches;
+    // Shared by all the rows listed directly under the root
+    CComPtr<CChildVisualizer> m_pRowDescriptor;
+    // Number of GetItems calls and objects allocated by them, for tuning
+    volatile LONG64 m_getItemsCalls;
+    volatile LONG64 m_getItemsAllocations;
 
 public:
     CRootVisualizer()
     {
         m_size = 0;
         m_fIsPointer = false;
+        m_fHasBounds = false;
+        m_fShowSummary = false;
+        m_fBuckets = false;
+        m_fExport = false;
+        m_exportFormat = ExportFormat::Csv;
+        m_fHasMismatches = false;
+        m_getItemsCalls = 0;
+        m_getItemsAllocations = 0;
     }
     ~CRootVisualizer()
     {
@@ -28,12 +68,15 @@ public:
 
     HRESULT STDMETHODCALLTYPE Initialize(
         _In_ DkmVisualizedExpression* pVisualizedExpression,
+        _In_ const ParallelArrayPlan& plan,
         _In_ unsigned long long size,
-        _In_ bool isPointer
+        _In_ bool isPointer,
+        _In_opt_ const CAtlArray<VectorBounds>* pBounds
     );
 
     static HRESULT CreateEvaluationResult(
         _In_ Evaluation::DkmVisualizedExpression* pVisualizedExpression,
+        _In_ const ParallelArrayTypes& types,
         _Deref_out_ Evaluation::DkmEvaluationResult** ppResultObject
     );
 
@@ -60,8 +103,113 @@ public:
         _Out_ DkmArray<Evaluation::DkmChildVisualizedExpression*>* pItems
     );
 
+    // In the 'buckets' view, ranges with more than MaxFlatChildren rows are shown as a tree of
+    // buckets, each holding at most BucketFanout children, instead of one flat list of rows. The
+    // other views only use buckets for ranges of UINT_MAX rows or more, which can't be listed.
+    static const unsigned long long MaxFlatChildren = 1000;
+    static const unsigned long long BucketFanout = 100;
+
+    // Returns the number of rows in each bucket which a range of 'count' rows is split into, or 0
+    // if the rows of the range are listed directly.
+    unsigned long long GetBucketSize(_In_ unsigned long long count);
+
+    // Returns the number of direct children of a range of 'count' rows
+    unsigned long long GetRangeChildCount(_In_ unsigned long long count);
+
+    // GetChildren/GetItems for the rows [first, first + count) which are expanded under 'pParent',
+    // or for the 'count' rows 'pRowIndices' if it is set. '*ppRowDescriptor' is the row data item
+    // shared by the range, created on first use.
+    HRESULT STDMETHODCALLTYPE GetRangeChildren(
+        _In_ Evaluation::DkmVisualizedExpression* pParent,
+        _In_ unsigned long long first,
+        _In_ unsigned long long count,
+        _In_reads_opt_(count) const uint64_t* pRowIndices,
+        _In_ const DkmDataItem& enumDataItem,
+        _Inout_ CComPtr<CChildVisualizer>* ppRowDescriptor,
+        _In_ UINT32 InitialRequestSize,
+        _In_ Evaluation::DkmInspectionContext* pInspectionContext,
+        _Out_ DkmArray<Evaluation::DkmChildVisualizedExpression*>* pInitialChildren,
+        _Deref_out_ Evaluation::DkmEvaluationResultEnumContext** ppEnumContext
+    );
+    HRESULT STDMETHODCALLTYPE GetRangeItems(
+        _In_ Evaluation::DkmVisualizedExpression* pParent,
+        _In_ unsigned long long first,
+        _In_ unsigned long long count,
+        _In_reads_opt_(count) const uint64_t* pRowIndices,
+        _Inout_ CComPtr<CChildVisualizer>* ppRowDescriptor,
+        _In_ UINT32 StartIndex,
+        _In_ UINT32 Count,
+        _Out_ DkmArray<Evaluation::DkmChildVisualizedExpression*>* pItems
+    );
+
+    // Returns the rows listed under '[Mismatches]', from CSummaryCacheDataItem. If they haven't been
+    // looked for yet in this inspection session, they are if 'search' is set, and S_FALSE is
+    // returned otherwise.
+    HRESULT STDMETHODCALLTYPE GetMismatches(
+        _In_ Evaluation::DkmInspectionContext* pInspectionContext,
+        _In_ bool search,
+        _Out_ ParallelArrayMismatches* pMismatches
+    );
+
+    // Writes all of the rows to a file in %TEMP% for the export views, and returns a message with
+    // its path. The file is only written once per root, unless it is deleted. Returns E_NOTIMPL
+    // for the other views, or if the rows aren't read from target memory.
+    HRESULT STDMETHODCALLTYPE Export(
+        _Deref_out_ DkmString** ppResult
+    );
+
+    // Returns how many times GetItems was called for this root and how many objects those calls
+    // created in total, counting each successful Create call
+    void GetAllocationStatistics(
+        _Out_ UINT64* pGetItemsCalls,
+        _Out_ UINT64* pAllocations
+    );
+
 protected:
-    // Evaluate the size of a vector in Sample using EE
+    HRESULT STDMETHODCALLTYPE GetRowDescriptor(
+        _In_ unsigned long long first,
+        _In_reads_opt_(count) const uint64_t* pRowIndices,
+        _In_ unsigned long long count,
+        _Inout_ CComPtr<CChildVisualizer>* ppRowDescriptor,
+        _Deref_out_ CChildVisualizer** ppResult,
+        _Inout_ UINT64* pAllocations
+    );
+
+    // Create the child which represents the bucket of rows [first, first + count)
+    HRESULT STDMETHODCALLTYPE CreateBucket(
+        _In_ Evaluation::DkmVisualizedExpression* pParent,
+        _In_ UINT32 index,
+        _In_ unsigned long long first,
+        _In_ unsigned long long count,
+        _Deref_out_ Evaluation::DkmChildVisualizedExpression** ppResult,
+        _Inout_ UINT64* pAllocations
+    );
+
+    // Create the '[Mismatches]' child, which lists the rows where the columns differ. The rows are
+    // only looked for when the child is expanded, as that streams all of the compared columns.
+    HRESULT STDMETHODCALLTYPE CreateMismatches(
+        _In_ Evaluation::DkmVisualizedExpression* pParent,
+        _In_ UINT32 index,
+        _Deref_out_ Evaluation::DkmChildVisualizedExpression** ppResult
+    );
+
+    // Read all of the column vectors with a single read of target memory. Returns S_FALSE if the
+    // vectors can't be located or decoded, in which case the caller should use GetSize.
+    static HRESULT STDMETHODCALLTYPE ReadVectorBounds(
+        _In_ Evaluation::DkmVisualizedExpression* pVisualizedExpression,
+        _In_ const ParallelArrayPlan& plan,
+        _Out_ CAtlArray<VectorBounds>& bounds
+    );
+
+    // Append the summary statistics of the columns of the object at 'address' to 'value'.
+    // Requires m_fHasBounds.
+    HRESULT STDMETHODCALLTYPE AppendSummary(
+        _In_ UINT64 address,
+        _In_ Evaluation::DkmInspectionContext* pInspectionContext,
+        _Inout_ CString& value
+    );
+
+    // Evaluate the size of one column vector using EE
     static HRESULT STDMETHODCALLTYPE GetSize(
         _In_ Evaluation::DkmVisualizedExpression* pVisualizedExpression,
         _In_ DkmString* pFullName,
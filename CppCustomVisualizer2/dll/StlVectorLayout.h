@@ -0,0 +1,141 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+#pragma once
+
+// This file describes how a std::vector is laid out in target memory and decodes one from raw
+// bytes. It only depends on the C++ standard library, so it can also be compiled and exercised
+// outside of the debugger, ex: against a byte buffer standing in for the target process.
+
+#include <stdint.h>
+#include <string.h>
+
+// Identifies the flavor of STL the target was built against. This decides how a std::vector
+// is laid out in target memory.
+struct StlFlavor
+{
+    enum e
+    {
+        // The layout could not be determined. Callers should fall back to the expression evaluator.
+        Unknown,
+
+        // MSVC STL built with _ITERATOR_DEBUG_LEVEL == 0: { _Myfirst, _Mylast, _Myend }
+        MsvcRelease,
+
+        // MSVC STL built with _ITERATOR_DEBUG_LEVEL != 0: { _Myproxy, _Myfirst, _Mylast, _Myend }
+        MsvcDebugIterators
+    };
+};
+
+// Describes where the begin/end/capacity pointers of a std::vector live for a given target
+// pointer width and STL flavor.
+struct VectorLayout
+{
+    uint32_t PointerSize;
+    uint32_t FirstOffset;
+    uint32_t LastOffset;
+    uint32_t EndOffset;
+    uint32_t VectorSize;
+
+    // Returns the layout for the specified pointer width and STL flavor, or false if the combination
+    // is not known.
+    static bool TryGet(uint32_t pointerSize, StlFlavor::e flavor, VectorLayout* pLayout)
+    {
+        memset(pLayout, 0, sizeof(*pLayout));
+
+        if (pointerSize != 4 && pointerSize != 8)
+        {
+            return false;
+        }
+
+        uint32_t proxySize;
+        switch (flavor)
+        {
+        case StlFlavor::MsvcRelease:
+            proxySize = 0;
+            break;
+
+        case StlFlavor::MsvcDebugIterators:
+            proxySize = pointerSize;
+            break;
+
+        default:
+            return false;
+        }
+
+        pLayout->PointerSize = pointerSize;
+        pLayout->FirstOffset = proxySize;
+        pLayout->LastOffset = proxySize + pointerSize;
+        pLayout->EndOffset = proxySize + 2 * pointerSize;
+        pLayout->VectorSize = proxySize + 3 * pointerSize;
+        return true;
+    }
+
+    // Returns the STL flavor which has a std::vector of 'vectorSize' bytes for the specified pointer
+    // width, or StlFlavor::Unknown.
+    static StlFlavor::e FlavorFromVectorSize(uint32_t pointerSize, uint64_t vectorSize)
+    {
+        if (vectorSize == 3ull * pointerSize)
+        {
+            return StlFlavor::MsvcRelease;
+        }
+        else if (vectorSize == 4ull * pointerSize)
+        {
+            return StlFlavor::MsvcDebugIterators;
+        }
+
+        return StlFlavor::Unknown;
+    }
+};
+
+// Begin/end/capacity addresses of a std::vector in the target process
+struct VectorBounds
+{
+    uint64_t First;
+    uint64_t Last;
+    uint64_t End;
+
+    uint64_t Count(uint32_t elementSize) const
+    {
+        return (Last - First) / elementSize;
+    }
+};
+
+inline uint64_t ReadTargetPointer(const uint8_t* pBytes, uint32_t pointerSize)
+{
+    if (pointerSize == 8)
+    {
+        uint64_t value;
+        memcpy(&value, pBytes, sizeof(value));
+        return value;
+    }
+
+    uint32_t value;
+    memcpy(&value, pBytes, sizeof(value));
+    return value;
+}
+
+// Decodes the std::vector which starts at 'pBytes' (layout.VectorSize bytes) using 'layout'. Returns
+// false if the decoded pointers are not a consistent vector of 'elementSize' byte elements.
+inline bool DecodeVector(const VectorLayout& layout, const uint8_t* pBytes, uint32_t elementSize, VectorBounds* pBounds)
+{
+    pBounds->First = ReadTargetPointer(pBytes + layout.FirstOffset, layout.PointerSize);
+    pBounds->Last = ReadTargetPointer(pBytes + layout.LastOffset, layout.PointerSize);
+    pBounds->End = ReadTargetPointer(pBytes + layout.EndOffset, layout.PointerSize);
+
+    // An empty vector which has never allocated has all three pointers null. Anything else needs
+    // to be ordered and hold a whole number of elements, otherwise the layout guess was wrong or
+    // the object is not initialized.
+    if (pBounds->First == 0)
+    {
+        return pBounds->Last == 0 && pBounds->End == 0;
+    }
+
+    if (pBounds->First > pBounds->Last || pBounds->Last > pBounds->End)
+    {
+        return false;
+    }
+
+    return elementSize != 0 &&
+        (pBounds->Last - pBounds->First) % elementSize == 0 &&
+        (pBounds->End - pBounds->First) % elementSize == 0;
+}
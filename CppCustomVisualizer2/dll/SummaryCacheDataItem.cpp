@@ -0,0 +1,242 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+#include "stdafx.h"
+#include "SummaryCacheDataItem.h"
+
+namespace
+{
+    // Streams the columns straight from the process rather than through CMemoryCacheDataItem. They
+    // are read once, and would only push the pages which the rows are shown from out of its cache.
+    class ProcessReader
+    {
+    public:
+        ProcessReader(_In_ DkmProcess* pProcess) :
+            m_pProcess(pProcess)
+        {
+        }
+
+        bool operator()(uint64_t address, void* pBuffer, uint32_t size)
+        {
+#pragma prefast(suppress:6387, "pBytesRead is unused and can be null")
+            return SUCCEEDED(m_pProcess->ReadMemory(address, DkmReadMemoryFlags::None, pBuffer, size, nullptr));
+        }
+
+    private:
+        DkmProcess* m_pProcess;
+    };
+
+    class Deadline
+    {
+    public:
+        Deadline(ULONGLONG timeoutMs) :
+            m_deadline(GetTickCount64() + timeoutMs)
+        {
+        }
+
+        bool operator()() const
+        {
+            return GetTickCount64() >= m_deadline;
+        }
+
+    private:
+        ULONGLONG m_deadline;
+    };
+}
+
+//static
+HRESULT CSummaryCacheDataItem::GetSummary(
+    _In_ DkmInspectionContext* pInspectionContext,
+    _In_ const ParallelArrayPlan& plan,
+    _In_ UINT64 address,
+    _In_reads_(plan.Columns.size()) const VectorBounds* pBounds,
+    _In_ UINT64 rowCount,
+    _Out_ ParallelArraySummary* pSummary
+)
+{
+    HRESULT hr;
+    *pSummary = ParallelArraySummary();
+
+    CComPtr<CSummaryCacheDataItem> pDataItem;
+    hr = GetInstance(pInspectionContext, &pDataItem);
+    if (FAILED(hr))
+    {
+        return hr;
+    }
+
+    {
+        ObjectLock lock(pDataItem);
+
+        Entry* pEntry = pDataItem->FindEntry(address, pBounds, plan.Columns.size());
+        if (pEntry != nullptr && pEntry->HasSummary)
+        {
+            *pSummary = pEntry->Summary;
+            return S_OK;
+        }
+    }
+
+    ProcessReader reader(pInspectionContext->RuntimeInstance()->Process());
+    Deadline shouldStop(TimeoutMs);
+    SummarizeParallelArrays(plan, pBounds, rowCount, ByteBudget, reader, shouldStop, pSummary);
+
+    ObjectLock lock(pDataItem);
+    Entry* pEntry = pDataItem->AddEntry(address, pBounds, plan.Columns.size());
+    if (pEntry != nullptr)
+    {
+        pEntry->HasSummary = true;
+        pEntry->Summary = *pSummary;
+    }
+
+    return S_OK;
+}
+
+//static
+HRESULT CSummaryCacheDataItem::GetMismatches(
+    _In_ DkmInspectionContext* pInspectionContext,
+    _In_ const ParallelArrayPlan& plan,
+    _In_ UINT64 address,
+    _In_reads_(plan.Columns.size()) const VectorBounds* pBounds,
+    _In_ UINT64 rowCount,
+    _In_ bool search,
+    _Out_ ParallelArrayMismatches* pMismatches
+)
+{
+    HRESULT hr;
+    *pMismatches = ParallelArrayMismatches();
+
+    CComPtr<CSummaryCacheDataItem> pDataItem;
+    hr = GetInstance(pInspectionContext, &pDataItem);
+    if (FAILED(hr))
+    {
+        return hr;
+    }
+
+    {
+        ObjectLock lock(pDataItem);
+
+        Entry* pEntry = pDataItem->FindEntry(address, pBounds, plan.Columns.size());
+        if (pEntry != nullptr && pEntry->HasMismatches)
+        {
+            *pMismatches = pEntry->Mismatches;
+            return S_OK;
+        }
+    }
+
+    if (!search)
+    {
+        return S_FALSE;
+    }
+
+    ProcessReader reader(pInspectionContext->RuntimeInstance()->Process());
+    Deadline shouldStop(TimeoutMs);
+    FindParallelArrayMismatches(plan, pBounds, rowCount, MaxMismatches, ByteBudget, reader, shouldStop, pMismatches);
+
+    ObjectLock lock(pDataItem);
+    Entry* pEntry = pDataItem->AddEntry(address, pBounds, plan.Columns.size());
+    if (pEntry != nullptr)
+    {
+        pEntry->HasMismatches = true;
+        pEntry->Mismatches = *pMismatches;
+    }
+
+    return S_OK;
+}
+
+CSummaryCacheDataItem::Entry* CSummaryCacheDataItem::FindEntry(
+    _In_ UINT64 address,
+    _In_reads_(count) const VectorBounds* pBounds,
+    _In_ size_t count
+)
+{
+    EntryMap::CPair* pPair = m_entries.Lookup(address);
+    if (pPair == nullptr || !BoundsMatch(pPair->m_value->Bounds, pBounds, count))
+    {
+        return nullptr;
+    }
+
+    return pPair->m_value;
+}
+
+CSummaryCacheDataItem::Entry* CSummaryCacheDataItem::AddEntry(
+    _In_ UINT64 address,
+    _In_reads_(count) const VectorBounds* pBounds,
+    _In_ size_t count
+)
+{
+    Entry* pExisting = FindEntry(address, pBounds, count);
+    if (pExisting != nullptr)
+    {
+        return pExisting;
+    }
+
+    CAutoPtr<Entry> pEntry(new (std::nothrow) Entry());
+    if (pEntry == nullptr)
+    {
+        return nullptr;
+    }
+
+    pEntry->Bounds.assign(pBounds, pBounds + count);
+    Entry* pResult = pEntry;
+    m_entries.SetAt(address, pEntry);
+    return pResult;
+}
+
+//static
+HRESULT CSummaryCacheDataItem::GetInstance(
+    _In_ DkmInspectionContext* pInspectionContext,
+    _Deref_out_ CSummaryCacheDataItem** ppDataItem
+)
+{
+    HRESULT hr;
+
+    DkmInspectionSession* pInspectionSession = pInspectionContext->InspectionSession();
+
+    // If there is already an associated item, return it.
+    hr = pInspectionSession->GetDataItem(ppDataItem);
+    if (hr == S_OK)
+    {
+        return hr;
+    }
+
+    // Otherwise create a new object
+    CComObject<CSummaryCacheDataItem>* pComObject;
+    hr = CComObject<CSummaryCacheDataItem>::CreateInstance(&pComObject);
+    if (FAILED(hr))
+    {
+        return hr;
+    }
+    CComPtr<CSummaryCacheDataItem> pCreatedInstance(pComObject);
+
+    // Another thread may have associated an item with the session in the meantime. In that case
+    // use theirs.
+    hr = pInspectionSession->SetDataItem(DkmDataCreationDisposition::CreateNew, pCreatedInstance.p);
+    if (FAILED(hr))
+    {
+        return pInspectionSession->GetDataItem(ppDataItem);
+    }
+
+    *ppDataItem = pCreatedInstance.Detach();
+    return S_OK;
+}
+
+//static
+bool CSummaryCacheDataItem::BoundsMatch(
+    _In_ const std::vector<VectorBounds>& cachedBounds,
+    _In_reads_(count) const VectorBounds* pBounds,
+    _In_ size_t count
+)
+{
+    if (cachedBounds.size() != count)
+    {
+        return false;
+    }
+
+    for (size_t i = 0; i < count; i++)
+    {
+        if (cachedBounds[i].First != pBounds[i].First || cachedBounds[i].Last != pBounds[i].Last)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
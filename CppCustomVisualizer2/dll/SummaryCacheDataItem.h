@@ -0,0 +1,129 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+#pragma once
+
+#include "ColumnSummary.h"
+
+// CSummaryCacheDataItem computes the summary statistics shown by the 'stats' view of a parallel
+// arrays object, and the rows listed by its '[Mismatches]' row. It remembers both by object
+// address for one DkmInspectionSession. Expanding or refreshing the same object while the process
+// is stopped then doesn't stream its columns again. The inspection session is closed when the
+// process continues, which throws the results away.
+class ATL_NO_VTABLE __declspec(uuid("18ab0625-538f-46ae-844a-d814219eb2d4")) CSummaryCacheDataItem :
+    public IUnknown,
+    public CComObjectRootEx<CComMultiThreadModel>
+{
+private:
+    struct Entry
+    {
+        // The columns the summary was computed for. If the object at the address has changed
+        // since, these don't match anymore.
+        std::vector<VectorBounds> Bounds;
+        // Set once Summary has been computed
+        bool HasSummary;
+        ParallelArraySummary Summary;
+        // Set once Mismatches has been found
+        bool HasMismatches;
+        ParallelArrayMismatches Mismatches;
+
+        Entry() :
+            HasSummary(false),
+            HasMismatches(false)
+        {
+        }
+    };
+
+    typedef CAtlMap<UINT64, CAutoPtr<Entry>, CElementTraits<UINT64>, CAutoPtrElementTraits<Entry>> EntryMap;
+
+    EntryMap m_entries;
+
+protected:
+    CSummaryCacheDataItem()
+    {
+    }
+    ~CSummaryCacheDataItem()
+    {
+    }
+
+public:
+    // At most this many bytes of target memory are read for one summary, or one search for
+    // mismatches
+    static const UINT64 ByteBudget = 256 * 1024 * 1024;
+
+    // A summary, or a search for mismatches, stops after this many milliseconds
+    static const ULONGLONG TimeoutMs = 500;
+
+    // '[Mismatches]' lists at most this many rows
+    static const size_t MaxMismatches = 100;
+
+    // Returns the summary of rows [0, rowCount) of the object at 'address', whose column vectors
+    // are 'pBounds' (indexed like plan.Columns). If the summary is not cached yet, it is computed
+    // within ByteBudget and TimeoutMs, so it may only cover part of the rows.
+    static HRESULT GetSummary(
+        _In_ DkmInspectionContext* pInspectionContext,
+        _In_ const ParallelArrayPlan& plan,
+        _In_ UINT64 address,
+        _In_reads_(plan.Columns.size()) const VectorBounds* pBounds,
+        _In_ UINT64 rowCount,
+        _Out_ ParallelArraySummary* pSummary
+    );
+
+    // Returns the first MaxMismatches rows of the object at 'address' where the columns differ
+    // (see FindParallelArrayMismatches), with the same arguments as GetSummary. If they are not
+    // cached yet, they are looked for within ByteBudget and TimeoutMs if 'search' is set, and S_FALSE
+    // is returned otherwise.
+    static HRESULT GetMismatches(
+        _In_ DkmInspectionContext* pInspectionContext,
+        _In_ const ParallelArrayPlan& plan,
+        _In_ UINT64 address,
+        _In_reads_(plan.Columns.size()) const VectorBounds* pBounds,
+        _In_ UINT64 rowCount,
+        _In_ bool search,
+        _Out_ ParallelArrayMismatches* pMismatches
+    );
+
+protected:
+    static HRESULT GetInstance(
+        _In_ DkmInspectionContext* pInspectionContext,
+        _Deref_out_ CSummaryCacheDataItem** ppDataItem
+    );
+
+    // Returns the entry for the object at 'address' if its columns are still 'pBounds', or null.
+    // Must be called with the lock held.
+    Entry* FindEntry(
+        _In_ UINT64 address,
+        _In_reads_(count) const VectorBounds* pBounds,
+        _In_ size_t count
+    );
+
+    // Returns the entry for the object at 'address' with the columns 'pBounds', replacing any
+    // entry for older columns at the same address. Returns null if out of memory. Must be called
+    // with the lock held.
+    Entry* AddEntry(
+        _In_ UINT64 address,
+        _In_reads_(count) const VectorBounds* pBounds,
+        _In_ size_t count
+    );
+
+    static bool BoundsMatch(
+        _In_ const std::vector<VectorBounds>& cachedBounds,
+        _In_reads_(count) const VectorBounds* pBounds,
+        _In_ size_t count
+    );
+
+    HRESULT _InternalQueryInterface(REFIID riid, void** ppvObject)
+    {
+        if (ppvObject == NULL)
+            return E_POINTER;
+
+        if (riid == __uuidof(IUnknown))
+        {
+            *ppvObject = static_cast<IUnknown*>(this);
+            AddRef();
+            return S_OK;
+        }
+
+        *ppvObject = NULL;
+        return E_NOINTERFACE;
+    }
+};
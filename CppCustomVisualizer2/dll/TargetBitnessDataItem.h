@@ -0,0 +1,44 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+#pragma once
+
+// CTargetBitnessDataItem caches the pointer size of a target process, so that formatting an address
+// doesn't need to look at the process's system information every time. It is associated with the
+// DkmProcess.
+class ATL_NO_VTABLE __declspec(uuid("5d8b1f37-a64e-4c2d-b9f0-6e3a7c1d4b85")) CTargetBitnessDataItem :
+    public IUnknown,
+    public CComObjectRootEx<CComMultiThreadModel>
+{
+private:
+    UINT32 m_pointerSize;
+
+protected:
+    CTargetBitnessDataItem() :
+        m_pointerSize(0)
+    {
+    }
+    ~CTargetBitnessDataItem()
+    {
+    }
+
+public:
+    // Returns 8 for 64-bit targets and 4 for 32-bit targets
+    static UINT32 GetPointerSize(_In_ DkmProcess* pProcess);
+
+protected:
+    HRESULT _InternalQueryInterface(REFIID riid, void** ppvObject)
+    {
+        if (ppvObject == NULL)
+            return E_POINTER;
+
+        if (riid == __uuidof(IUnknown))
+        {
+            *ppvObject = static_cast<IUnknown*>(this);
+            AddRef();
+            return S_OK;
+        }
+
+        *ppvObject = NULL;
+        return E_NOINTERFACE;
+    }
+};
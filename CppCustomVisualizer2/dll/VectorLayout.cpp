@@ -0,0 +1,166 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+#include "stdafx.h"
+#include "VectorLayout.h"
+#include "TargetBitnessDataItem.h"
+
+//static
+HRESULT CVectorLayoutDataItem::GetLayout(
+    _In_ DkmVisualizedExpression* pVisualizedExpression,
+    _In_ LPCWSTR probeText,
+    _Out_ VectorLayout* pLayout
+)
+{
+    HRESULT hr = S_OK;
+    memset(pLayout, 0, sizeof(*pLayout));
+
+    DkmProcess* pTargetProcess = pVisualizedExpression->RuntimeInstance()->Process();
+    CComPtr<DkmModuleInstance> pModuleInstance;
+    hr = GetTypeModuleInstance(pVisualizedExpression, &pModuleInstance);
+    if (FAILED(hr))
+    {
+        return hr;
+    }
+
+    // If the flavor was already determined for this module, we are done
+    CComPtr<CVectorLayoutDataItem> pDataItem;
+    if (pModuleInstance != nullptr && pModuleInstance->GetDataItem(&pDataItem) == S_OK)
+    {
+        *pLayout = pDataItem->m_layout;
+        return S_OK;
+    }
+
+    UINT32 pointerSize = CTargetBitnessDataItem::GetPointerSize(pTargetProcess);
+
+    unsigned long long vectorSize;
+    hr = EvaluateUInt64(pVisualizedExpression, probeText, &vectorSize);
+    if (FAILED(hr))
+    {
+        // The probe can fail for reasons which have nothing to do with the layout (ex: the root
+        // is a null pointer), so don't remember anything and let the next evaluation try again.
+        return S_FALSE;
+    }
+
+    CComObject<CVectorLayoutDataItem>* pComObject;
+    hr = CComObject<CVectorLayoutDataItem>::CreateInstance(&pComObject);
+    if (FAILED(hr))
+    {
+        return hr;
+    }
+    CComPtr<CVectorLayoutDataItem> pCreatedInstance(pComObject);
+
+    pCreatedInstance->m_flavor = VectorLayout::FlavorFromVectorSize(pointerSize, vectorSize);
+    if (!VectorLayout::TryGet(pointerSize, pCreatedInstance->m_flavor, &pCreatedInstance->m_layout))
+    {
+        // An unknown size may come from a probe which the EE resolved differently this time (ex:
+        // before the module's symbols were loaded), so it isn't remembered
+        return S_FALSE;
+    }
+
+    // Another thread may have raced us here. Both results are equivalent, so ignore failures.
+    // Without a module there is nothing to remember the result with, so the next evaluation
+    // probes again.
+    if (pModuleInstance != nullptr)
+    {
+        pModuleInstance->SetDataItem(DkmDataCreationDisposition::CreateNew, pCreatedInstance.p);
+    }
+
+    *pLayout = pCreatedInstance->m_layout;
+    return S_OK;
+}
+
+HRESULT GetTypeModuleInstance(
+    _In_ DkmVisualizedExpression* pVisualizedExpression,
+    _Deref_out_opt_ DkmModuleInstance** ppModuleInstance
+)
+{
+    *ppModuleInstance = nullptr;
+
+    // An object in a module's image (ex: a global or a static member) is defined by that module
+    CComPtr<DkmPointerValueHome> pPointerValueHome = DkmPointerValueHome::TryCast(pVisualizedExpression->ValueHome());
+    if (pPointerValueHome != nullptr)
+    {
+        CComPtr<DkmNativeModuleInstance> pNativeModuleInstance;
+        DkmProcess* pProcess = pVisualizedExpression->RuntimeInstance()->Process();
+        if (pProcess->FindNativeModule(pPointerValueHome->Address(), &pNativeModuleInstance) == S_OK && pNativeModuleInstance != nullptr)
+        {
+            *ppModuleInstance = pNativeModuleInstance.Detach();
+            return S_OK;
+        }
+    }
+
+    // Objects on the stack or the heap have their type resolved by the EE with the symbols of the
+    // frame's module
+    DkmStackWalkFrame* pFrame = pVisualizedExpression->StackFrame();
+    if (pFrame == nullptr || pFrame->InstructionAddress() == nullptr || pFrame->InstructionAddress()->ModuleInstance() == nullptr)
+    {
+        return S_FALSE;
+    }
+
+    *ppModuleInstance = pFrame->InstructionAddress()->ModuleInstance();
+    (*ppModuleInstance)->AddRef();
+    return S_OK;
+}
+
+HRESULT EvaluateUInt64(
+    _In_ DkmVisualizedExpression* pVisualizedExpression,
+    _In_ LPCWSTR evalText,
+    _Out_ unsigned long long* pResult
+)
+{
+    HRESULT hr = S_OK;
+    *pResult = 0;
+
+    CComPtr<DkmString> pEvalText;
+    hr = DkmString::Create(DkmSourceString(evalText), &pEvalText);
+    if (FAILED(hr))
+    {
+        return hr;
+    }
+
+    CComPtr<DkmLanguageExpression> pLanguageExpression;
+    hr = DkmLanguageExpression::Create(
+        pVisualizedExpression->InspectionContext()->Language(),
+        DkmEvaluationFlags::TreatAsExpression,
+        pEvalText,
+        DkmDataItem::Null(),
+        &pLanguageExpression
+    );
+    if (FAILED(hr))
+    {
+        return hr;
+    }
+    CComPtr<DkmEvaluationResult> pEvalResult;
+    hr = pVisualizedExpression->EvaluateExpressionCallback(
+        pVisualizedExpression->InspectionContext(),
+        pLanguageExpression,
+        pVisualizedExpression->StackFrame(),
+        &pEvalResult
+    );
+    if (FAILED(hr))
+    {
+        return hr;
+    }
+
+    CComPtr<DkmSuccessEvaluationResult> pSuccessEvalResult = DkmSuccessEvaluationResult::TryCast(pEvalResult);
+    if (pSuccessEvalResult == nullptr)
+    {
+        return E_FAIL;
+    }
+
+    CComPtr<DkmString> pValue = pSuccessEvalResult->Value();
+    if (pValue == nullptr)
+    {
+        return E_FAIL;
+    }
+
+    LPCWSTR valueStr = pValue->Value();
+    LPWSTR endPtr;
+    *pResult = wcstoull(valueStr, &endPtr, 0);
+    if (valueStr == endPtr)
+    {
+        return E_FAIL;
+    }
+
+    return hr;
+}
@@ -0,0 +1,82 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+#pragma once
+
+#include "StlVectorLayout.h"
+
+// CVectorLayoutDataItem caches the std::vector layout profile (pointer width and STL flavor) of a
+// module so that it only needs to be determined with the expression evaluator once. It is
+// associated with the DkmModuleInstance which defines the type being visualized (see
+// GetTypeModuleInstance), since each module of a process can be built with a different
+// _ITERATOR_DEBUG_LEVEL. Only a known layout is remembered.
+class ATL_NO_VTABLE __declspec(uuid("6d1f4c1e-8f0a-4a4b-9f4e-3b0f8d3f6a21")) CVectorLayoutDataItem :
+    public IUnknown,
+    public CComObjectRootEx<CComMultiThreadModel>
+{
+private:
+    VectorLayout m_layout;
+    StlFlavor::e m_flavor;
+
+protected:
+    CVectorLayoutDataItem() :
+        m_flavor(StlFlavor::Unknown)
+    {
+        memset(&m_layout, 0, sizeof(m_layout));
+    }
+    ~CVectorLayoutDataItem()
+    {
+    }
+
+public:
+    StlFlavor::e Flavor() const
+    {
+        return m_flavor;
+    }
+    const VectorLayout& Layout() const
+    {
+        return m_layout;
+    }
+
+    // Returns the layout of std::vector in the module which defines the type of
+    // 'pVisualizedExpression'. If the layout has not been determined for the module yet,
+    // 'probeText' (an expression which evaluates to the sizeof a std::vector) is evaluated to
+    // determine it. Returns S_FALSE if the layout is not known.
+    static HRESULT GetLayout(
+        _In_ DkmVisualizedExpression* pVisualizedExpression,
+        _In_ LPCWSTR probeText,
+        _Out_ VectorLayout* pLayout
+    );
+
+protected:
+    HRESULT _InternalQueryInterface(REFIID riid, void** ppvObject)
+    {
+        if (ppvObject == NULL)
+            return E_POINTER;
+
+        if (riid == __uuidof(IUnknown))
+        {
+            *ppvObject = static_cast<IUnknown*>(this);
+            AddRef();
+            return S_OK;
+        }
+
+        *ppvObject = NULL;
+        return E_NOINTERFACE;
+    }
+};
+
+// Returns the module which defines the type of the root 'pVisualizedExpression', which per-type
+// caches are associated with. That is the module whose image holds the object, if it does (ex: a
+// global). Otherwise it is the module whose code the expression is evaluated in, whose symbols
+// the EE resolves the type with. Returns S_FALSE if neither of them is a module.
+HRESULT GetTypeModuleInstance(
+    _In_ DkmVisualizedExpression* pVisualizedExpression,
+    _Deref_out_opt_ DkmModuleInstance** ppModuleInstance
+);
+
+// Evaluates 'evalText' with the expression evaluator and parses the result as an unsigned integer
+HRESULT EvaluateUInt64(
+    _In_ DkmVisualizedExpression* pVisualizedExpression,
+    _In_ LPCWSTR evalText,
+    _Out_ unsigned long long* pResult
+);
@@ -3,6 +3,62 @@
 #include "stdafx.h"
 #include "_EntryPoint.h"
 
+// CppCustomVisualizer.parallelarrays is at most this big
+static const ULONGLONG MaxTypesFileSize = 1024 * 1024;
+
+// Loads the parallel arrays types from CppCustomVisualizer.parallelarrays, which is deployed next
+// to CppCustomVisualizer.dll. To visualize another type, add its descriptor to that file (see
+// ParallelArrayTypes for the syntax) and a <Type> for it to CppCustomVisualizer.natvis with the
+// same CustomVisualizer entries as Sample. If the file is missing or can't be read, there are no
+// types and every expression is left to the default visualizer.
+HRESULT CCppCustomVisualizerService::FinalConstruct()
+{
+    HRESULT hr;
+
+    WCHAR path[MAX_PATH];
+    DWORD pathLength = GetModuleFileNameW(_AtlBaseModule.GetModuleInstance(), path, _countof(path));
+    WCHAR* pFileName = (pathLength != 0 && pathLength < _countof(path)) ? wcsrchr(path, L'\\') : NULL;
+    if (pFileName == NULL || wcscpy_s(pFileName + 1, _countof(path) - (pFileName + 1 - path), L"CppCustomVisualizer.parallelarrays") != 0)
+    {
+        return S_OK;
+    }
+
+    CAtlFile file;
+    hr = file.Create(path, GENERIC_READ, FILE_SHARE_READ, OPEN_EXISTING);
+    if (FAILED(hr))
+    {
+        ATLTRACE(L"CppCustomVisualizer: %s not found\n", path);
+        return S_OK;
+    }
+
+    ULONGLONG fileSize;
+    hr = file.GetSize(fileSize);
+    if (FAILED(hr) || fileSize == 0 || fileSize > MaxTypesFileSize)
+    {
+        ATLTRACE(L"CppCustomVisualizer: ignoring %s\n", path);
+        return S_OK;
+    }
+
+    std::vector<char> bytes((size_t)fileSize);
+    hr = file.Read(bytes.data(), (DWORD)fileSize);
+    if (FAILED(hr))
+    {
+        ATLTRACE(L"CppCustomVisualizer: failed to read %s\n", path);
+        return S_OK;
+    }
+
+    // The file is UTF-8, possibly with a byte order mark
+    int offset = (fileSize >= 3 && memcmp(bytes.data(), "\xEF\xBB\xBF", 3) == 0) ? 3 : 0;
+    int textLength = MultiByteToWideChar(CP_UTF8, 0, bytes.data() + offset, (int)fileSize - offset, NULL, 0);
+    std::wstring text(textLength, L'\0');
+    MultiByteToWideChar(CP_UTF8, 0, bytes.data() + offset, (int)fileSize - offset, &text[0], textLength);
+
+    m_types.Parse(text);
+
+    ATLTRACE(L"CppCustomVisualizer: loaded %u parallel arrays types from %s\n", (UINT32)m_types.GetCount(), path);
+    return S_OK;
+}
+
 HRESULT STDMETHODCALLTYPE CCppCustomVisualizerService::EvaluateVisualizedExpression(
     _In_ Evaluation::DkmVisualizedExpression* pVisualizedExpression,
     _Deref_out_opt_ Evaluation::DkmEvaluationResult** ppResultObject
@@ -10,7 +66,7 @@ HRESULT STDMETHODCALLTYPE CCppCustomVisualizerService::EvaluateVisualizedExpress
 {
     HRESULT hr;
 
-    hr = CRootVisualizer::CreateEvaluationResult(pVisualizedExpression, ppResultObject);
+    hr = CRootVisualizer::CreateEvaluationResult(pVisualizedExpression, m_types, ppResultObject);
     if (FAILED(hr))
     {
         return hr;
@@ -56,7 +112,17 @@ HRESULT STDMETHODCALLTYPE CCppCustomVisualizerService::GetChildren(
 
         if (SUCCEEDED(hr))
         {
-            hr = PChildVisualizer->GetChildren(InitialRequestSize, pInspectionContext, pInitialChildren, ppEnumContext);
+            hr = PChildVisualizer->GetChildren(pVisualizedExpression, InitialRequestSize, pInspectionContext, pInitialChildren, ppEnumContext);
+        }
+        else
+        {
+            CComPtr<CRangeVisualizer> pRangeVisualizer;
+            hr = pVisualizedExpression->GetDataItem(&pRangeVisualizer);
+
+            if (SUCCEEDED(hr))
+            {
+                hr = pRangeVisualizer->GetChildren(pVisualizedExpression, InitialRequestSize, pInspectionContext, pInitialChildren, ppEnumContext);
+            }
         }
     }
 
@@ -89,6 +155,16 @@ HRESULT STDMETHODCALLTYPE CCppCustomVisualizerService::GetItems(
         {
             hr = PChildVisualizer->GetItems(pVisualizedExpression, pEnumContext, StartIndex, Count, pItems);
         }
+        else
+        {
+            CComPtr<CRangeVisualizer> pRangeVisualizer;
+            hr = pVisualizedExpression->GetDataItem(&pRangeVisualizer);
+
+            if (SUCCEEDED(hr))
+            {
+                hr = pRangeVisualizer->GetItems(pVisualizedExpression, pEnumContext, StartIndex, Count, pItems);
+            }
+        }
     }
 
     return hr;
@@ -110,7 +186,16 @@ HRESULT STDMETHODCALLTYPE CCppCustomVisualizerService::GetUnderlyingString(
     _Deref_out_opt_ DkmString** ppStringValue
     )
 {
-    // Sample doesn't have an underlying string (no DkmEvaluationResultFlags::RawString), so this method
-    // doesn't need to be implemented
-    return E_NOTIMPL;
+    HRESULT hr;
+
+    // Only the root of an export view has an underlying string (DkmEvaluationResultFlags::RawString).
+    // Opening it exports the rows.
+    CComPtr<CRootVisualizer> pRootVisualizer;
+    hr = pVisualizedExpression->GetDataItem(&pRootVisualizer);
+    if (FAILED(hr))
+    {
+        return E_NOTIMPL;
+    }
+
+    return pRootVisualizer->Export(ppStringValue);
 }
\ No newline at end of file
@@ -8,6 +8,7 @@
 
 #include "CppCustomVisualizer.Contract.h"
 #include "RootVisualizer.h"
+#include "RangeVisualizer.h"
 
 class ATL_NO_VTABLE CCppCustomVisualizerService :
     // Inherit from CCppCustomVisualizerServiceContract to provide the list of interfaces that
@@ -22,6 +23,11 @@ class ATL_NO_VTABLE CCppCustomVisualizerService :
     // DllGetClassObject
     public CComCoClass<CCppCustomVisualizerService, &CCppCustomVisualizerServiceContract::ClassId>
 {
+private:
+    // The parallel arrays types from CppCustomVisualizer.parallelarrays, which are the only types
+    // this visualizer shows
+    ParallelArrayTypes m_types;
+
 protected:
     CCppCustomVisualizerService()
     {
@@ -34,6 +40,9 @@ public:
     DECLARE_NO_REGISTRY();
     DECLARE_NOT_AGGREGATABLE(CCppCustomVisualizerService);
 
+    // Called by ATL after the object is created. Loads the parallel arrays types.
+    HRESULT FinalConstruct();
+
 // IDkmCustomVisualizer methods
 public:
     HRESULT STDMETHODCALLTYPE EvaluateVisualizedExpression(
@@ -24,6 +24,7 @@
 #include <atlcom.h>
 #include <atlctl.h>
 #include <atlcoll.h>
+#include <atlfile.h>
 
 #include <vsdebugeng.h>
 #include <vsdebugeng.templates.h>
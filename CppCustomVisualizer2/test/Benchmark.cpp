@@ -0,0 +1,213 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+// Times the two ways CRootVisualizer::CreateEvaluationResult finds the number of rows of a
+// 'Sample' object, on a synthetic image of many such objects:
+//
+//   EE size()       what GetSize does for each column: format '(x).a.size()', have it evaluated,
+//                   and parse the result string back with wcstoull. The expression evaluator is
+//                   modelled by a minimal one which parses the expression, looks the member up,
+//                   reads its vector from the target and formats the size as a string. The real
+//                   EE also goes through the debugger's dispatcher and symbol lookups, so this is
+//                   a lower bound of what the path costs.
+//   direct decode   what ReadVectorBounds does: one read of the object, decoded with
+//                   ReadParallelArrayBounds.
+//
+// Prints the best of several runs in nanoseconds per object, and how many target reads each path
+// made.
+
+#include "TestTarget.h"
+#include "ParallelArrays.h"
+#include <stdlib.h>
+#include <wchar.h>
+#include <chrono>
+#include <map>
+#include <string>
+
+namespace
+{
+    const uint32_t ObjectCount = 1 << 14;
+    const uint32_t RowsPerObject = 16;
+    const int Runs = 5;
+
+    // 'class Sample { std::vector<int> a, b; }' in a 64-bit release build
+    const uint64_t ObjectsAddress = 0x10000000;
+    const uint64_t ElementsAddress = 0x40000000;
+    const uint32_t VectorSize = 24;
+    const uint32_t ObjectSize = 2 * VectorSize;
+
+    // Keeps the compiler from throwing away the results
+    volatile uint64_t g_sink;
+
+    // Builds the objects and their elements in 'pTarget'. Object i is at
+    // ObjectsAddress + i * ObjectSize, with RowsPerObject elements in each vector.
+    void BuildImage(TestTarget* pTarget)
+    {
+        std::vector<uint64_t> objects(ObjectCount * ObjectSize / sizeof(uint64_t));
+        std::vector<int32_t> elements(ObjectCount * 2 * RowsPerObject);
+        for (uint32_t i = 0; i < ObjectCount; i++)
+        {
+            for (uint32_t column = 0; column < 2; column++)
+            {
+                uint32_t firstElement = (i * 2 + column) * RowsPerObject;
+                uint64_t first = ElementsAddress + firstElement * sizeof(int32_t);
+                uint64_t* pVector = &objects[(i * ObjectSize + column * VectorSize) / sizeof(uint64_t)];
+                pVector[0] = first;
+                pVector[1] = first + RowsPerObject * sizeof(int32_t);
+                pVector[2] = pVector[1];
+                for (uint32_t row = 0; row < RowsPerObject; row++)
+                {
+                    elements[firstElement + row] = (int32_t)(column == 0 ? row : -(int32_t)row);
+                }
+            }
+        }
+
+        pTarget->Add(ObjectsAddress, objects.data(), objects.size() * sizeof(uint64_t));
+        pTarget->Add(ElementsAddress, elements.data(), elements.size() * sizeof(int32_t));
+    }
+
+    // Stands in for the expression evaluator: evaluates '(<address>).<member>.size()' for the
+    // members of Sample, and returns the result as text like DkmSuccessEvaluationResult::Value
+    class ModelEvaluator
+    {
+    public:
+        explicit ModelEvaluator(TestTarget* pTarget) :
+            m_pTarget(pTarget)
+        {
+            VectorLayout::TryGet(8, StlFlavor::MsvcRelease, &m_layout);
+            m_members[L"a"] = 0;
+            m_members[L"b"] = VectorSize;
+        }
+
+        bool Evaluate(const wchar_t* evalText, std::wstring* pValue)
+        {
+            // '(' <object address> ').' <member> '.size()'
+            wchar_t* pEnd;
+            uint64_t objectAddress = wcstoull(evalText + 1, &pEnd, 16);
+            if (wcsncmp(pEnd, L").", 2) != 0)
+            {
+                return false;
+            }
+            const wchar_t* pMember = pEnd + 2;
+            const wchar_t* pCall = wcsstr(pMember, L".size()");
+            if (pCall == nullptr)
+            {
+                return false;
+            }
+
+            auto it = m_members.find(std::wstring(pMember, pCall));
+            if (it == m_members.end())
+            {
+                return false;
+            }
+
+            uint8_t vector[VectorSize];
+            VectorBounds bounds;
+            if (!(*m_pTarget)(objectAddress + it->second, vector, VectorSize) ||
+                !DecodeVector(m_layout, vector, sizeof(int32_t), &bounds))
+            {
+                return false;
+            }
+
+            wchar_t value[32];
+            swprintf(value, 32, L"%llu", (unsigned long long)bounds.Count(sizeof(int32_t)));
+            *pValue = value;
+            return true;
+        }
+
+    private:
+        TestTarget* m_pTarget;
+        VectorLayout m_layout;
+        std::map<std::wstring, uint32_t> m_members;
+    };
+
+    template <class TBody>
+    void Measure(const char* name, TestTarget* pTarget, TBody body)
+    {
+        double best = 0;
+        uint32_t reads = 0;
+        for (int run = 0; run < Runs; run++)
+        {
+            uint32_t readsBefore = pTarget->Reads();
+            auto start = std::chrono::steady_clock::now();
+            g_sink += body();
+            double elapsed = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+            if (run == 0 || elapsed < best)
+            {
+                best = elapsed;
+            }
+            reads = pTarget->Reads() - readsBefore;
+        }
+
+        printf("%-20s %8.1f ns/object %6.2f reads/object\n", name, best / ObjectCount, (double)reads / ObjectCount);
+    }
+}
+
+int main()
+{
+    TestTarget target;
+    BuildImage(&target);
+
+    ParallelArrayPlan plan;
+    ParallelArrayPlan::Compile(L"A=a:int, B=b:int", &plan);
+    VectorLayout layout;
+    VectorLayout::TryGet(8, StlFlavor::MsvcRelease, &layout);
+    const uint32_t offsets[2] = { 0, VectorSize };
+    plan.ResolveOffsets(offsets, layout);
+
+    ModelEvaluator evaluator(&target);
+    uint64_t failures = 0;
+
+    Measure("EE size()", &target, [&]() -> uint64_t
+    {
+        uint64_t rows = 0;
+        for (uint32_t i = 0; i < ObjectCount; i++)
+        {
+            uint64_t objectAddress = ObjectsAddress + (uint64_t)i * ObjectSize;
+            for (const ParallelArrayColumn& column : plan.Columns)
+            {
+                wchar_t evalText[128];
+                swprintf(evalText, 128, L"(0x%llx).%ls.size()", (unsigned long long)objectAddress, column.Member.c_str());
+
+                std::wstring value;
+                if (!evaluator.Evaluate(evalText, &value))
+                {
+                    failures++;
+                    continue;
+                }
+
+                wchar_t* pEnd;
+                rows += wcstoull(value.c_str(), &pEnd, 0);
+            }
+        }
+        return rows;
+    });
+
+    Measure("direct decode", &target, [&]() -> uint64_t
+    {
+        uint64_t rows = 0;
+        VectorBounds bounds[2];
+        for (uint32_t i = 0; i < ObjectCount; i++)
+        {
+            uint64_t objectAddress = ObjectsAddress + (uint64_t)i * ObjectSize;
+            if (!ReadParallelArrayBounds(plan, objectAddress, target, bounds))
+            {
+                failures++;
+                continue;
+            }
+
+            for (size_t column = 0; column < plan.Columns.size(); column++)
+            {
+                rows += bounds[column].Count(plan.Columns[column].ElementSize);
+            }
+        }
+        return rows;
+    });
+
+    if (failures != 0)
+    {
+        printf("%llu objects couldn't be read\n", (unsigned long long)failures);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,316 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+#pragma once
+
+// This file defines DumpMemoryImage, which serves target memory out of a Windows minidump or an ELF
+// core file instead of a live process. It satisfies the same reader contract as MemoryPageCache and
+// ParallelArrays.h ('bool reader(uint64_t address, void* pBuffer, uint32_t size)'), so the portable
+// parts of the visualizer can be replayed offline against captured heaps (see ReplayDump.cpp). It
+// only depends on the C++ standard library and doesn't own the dump bytes: the caller maps (or
+// reads) the file and keeps it alive for as long as the image is used. Lookups return pointers into
+// that mapping, so reading a range which lies within one captured region doesn't copy anything.
+
+#include <stdint.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+
+class DumpMemoryImage
+{
+public:
+    DumpMemoryImage()
+    {
+    }
+
+    // Indexes the memory regions of the dump in 'pFile'. Returns false if the bytes are neither a
+    // minidump with a memory list nor a little endian ELF core.
+    bool Load(const uint8_t* pFile, size_t fileSize)
+    {
+        m_regions.clear();
+
+        bool loaded = LoadMinidump(pFile, fileSize) || LoadElfCore(pFile, fileSize);
+        if (!loaded)
+        {
+            m_regions.clear();
+            return false;
+        }
+
+        std::sort(m_regions.begin(), m_regions.end(), [](const Region& left, const Region& right)
+        {
+            return left.Start < right.Start;
+        });
+        return true;
+    }
+
+    // Returns a pointer to 'size' bytes of target memory at 'address' if they were all captured in
+    // one region of the dump, or nullptr otherwise
+    const uint8_t* TryGetSpan(uint64_t address, uint64_t size) const
+    {
+        const Region* pRegion = FindRegion(address);
+        if (pRegion == nullptr || size > pRegion->Start + pRegion->Size - address)
+        {
+            return nullptr;
+        }
+
+        return pRegion->pData + (address - pRegion->Start);
+    }
+
+    // Copies 'size' bytes at 'address' into 'pBuffer'. Reads can span adjacent regions. Returns
+    // false if any of the bytes were not captured.
+    bool operator()(uint64_t address, void* pBuffer, uint32_t size) const
+    {
+        uint8_t* pDest = static_cast<uint8_t*>(pBuffer);
+        uint64_t remaining = size;
+        while (remaining != 0)
+        {
+            const Region* pRegion = FindRegion(address);
+            if (pRegion == nullptr)
+            {
+                return false;
+            }
+
+            uint64_t offset = address - pRegion->Start;
+            uint64_t chunk = std::min<uint64_t>(remaining, pRegion->Size - offset);
+            memcpy(pDest, pRegion->pData + offset, (size_t)chunk);
+            pDest += chunk;
+            address += chunk;
+            remaining -= chunk;
+        }
+
+        return true;
+    }
+
+    size_t RegionCount() const
+    {
+        return m_regions.size();
+    }
+
+private:
+    struct Region
+    {
+        uint64_t Start;
+        uint64_t Size;
+        const uint8_t* pData;
+    };
+
+    // Finds the region containing 'address' with a binary search over the sorted region starts
+    const Region* FindRegion(uint64_t address) const
+    {
+        auto next = std::upper_bound(m_regions.begin(), m_regions.end(), address, [](uint64_t value, const Region& region)
+        {
+            return value < region.Start;
+        });
+        if (next == m_regions.begin())
+        {
+            return nullptr;
+        }
+
+        const Region& region = *(next - 1);
+        return address - region.Start < region.Size ? &region : nullptr;
+    }
+
+    void AddRegion(uint64_t start, uint64_t size, const uint8_t* pData)
+    {
+        if (size != 0 && start + size > start)
+        {
+            Region region = { start, size, pData };
+            m_regions.push_back(region);
+        }
+    }
+
+    template <class T>
+    static bool ReadField(const uint8_t* pFile, size_t fileSize, uint64_t offset, T* pValue)
+    {
+        if (offset > fileSize || sizeof(T) > fileSize - offset)
+        {
+            return false;
+        }
+
+        memcpy(pValue, pFile + offset, sizeof(T));
+        return true;
+    }
+
+    static bool IsInFile(size_t fileSize, uint64_t offset, uint64_t size)
+    {
+        return offset <= fileSize && size <= fileSize - offset;
+    }
+
+    // See MINIDUMP_HEADER, MINIDUMP_DIRECTORY, MINIDUMP_MEMORY_LIST and MINIDUMP_MEMORY64_LIST in minidumpapiset.h
+    bool LoadMinidump(const uint8_t* pFile, size_t fileSize)
+    {
+        const uint32_t MinidumpSignature = 0x504d444d; // 'MDMP'
+        const uint32_t MemoryListStream = 5;
+        const uint32_t Memory64ListStream = 9;
+
+        uint32_t signature, streamCount, directoryRva;
+        if (!ReadField(pFile, fileSize, 0, &signature) || signature != MinidumpSignature ||
+            !ReadField(pFile, fileSize, 8, &streamCount) ||
+            !ReadField(pFile, fileSize, 12, &directoryRva))
+        {
+            return false;
+        }
+
+        bool hasMemory = false;
+        for (uint32_t i = 0; i < streamCount; i++)
+        {
+            uint64_t entry = directoryRva + 12ull * i;
+            uint32_t streamType, dataSize, rva;
+            if (!ReadField(pFile, fileSize, entry, &streamType) ||
+                !ReadField(pFile, fileSize, entry + 4, &dataSize) ||
+                !ReadField(pFile, fileSize, entry + 8, &rva))
+            {
+                return false;
+            }
+
+            if (streamType == MemoryListStream)
+            {
+                uint32_t rangeCount;
+                if (!ReadField(pFile, fileSize, rva, &rangeCount))
+                {
+                    return false;
+                }
+
+                for (uint32_t range = 0; range < rangeCount; range++)
+                {
+                    uint64_t descriptor = rva + 4ull + 16ull * range;
+                    uint64_t start;
+                    uint32_t size, memoryRva;
+                    if (!ReadField(pFile, fileSize, descriptor, &start) ||
+                        !ReadField(pFile, fileSize, descriptor + 8, &size) ||
+                        !ReadField(pFile, fileSize, descriptor + 12, &memoryRva) ||
+                        !IsInFile(fileSize, memoryRva, size))
+                    {
+                        return false;
+                    }
+
+                    AddRegion(start, size, pFile + memoryRva);
+                }
+                hasMemory = true;
+            }
+            else if (streamType == Memory64ListStream)
+            {
+                // The memory of all ranges follows each other starting at 'baseRva'
+                uint64_t rangeCount, baseRva;
+                if (!ReadField(pFile, fileSize, rva, &rangeCount) ||
+                    !ReadField(pFile, fileSize, rva + 8ull, &baseRva))
+                {
+                    return false;
+                }
+
+                uint64_t memoryRva = baseRva;
+                for (uint64_t range = 0; range < rangeCount; range++)
+                {
+                    uint64_t descriptor = rva + 16ull + 16ull * range;
+                    uint64_t start, size;
+                    if (!ReadField(pFile, fileSize, descriptor, &start) ||
+                        !ReadField(pFile, fileSize, descriptor + 8, &size) ||
+                        !IsInFile(fileSize, memoryRva, size))
+                    {
+                        return false;
+                    }
+
+                    AddRegion(start, size, pFile + memoryRva);
+                    memoryRva += size;
+                }
+                hasMemory = true;
+            }
+        }
+
+        return hasMemory;
+    }
+
+    // See Elf32_Ehdr/Elf64_Ehdr and Elf32_Phdr/Elf64_Phdr in elf.h. Only the parts of PT_LOAD
+    // segments which are present in the file (p_filesz) are indexed.
+    bool LoadElfCore(const uint8_t* pFile, size_t fileSize)
+    {
+        const uint8_t ElfClass32 = 1;
+        const uint8_t ElfClass64 = 2;
+        const uint8_t ElfDataLittleEndian = 1;
+        const uint16_t ElfTypeCore = 4;
+        const uint32_t ProgramTypeLoad = 1;
+
+        if (fileSize < 52 || memcmp(pFile, "\x7f" "ELF", 4) != 0 || pFile[5] != ElfDataLittleEndian)
+        {
+            return false;
+        }
+
+        uint8_t elfClass = pFile[4];
+        uint16_t type;
+        if ((elfClass != ElfClass32 && elfClass != ElfClass64) ||
+            !ReadField(pFile, fileSize, 16, &type) || type != ElfTypeCore)
+        {
+            return false;
+        }
+
+        bool is64Bit = elfClass == ElfClass64;
+        uint64_t programHeaderOffset;
+        uint16_t programHeaderSize, programHeaderCount;
+        if (is64Bit)
+        {
+            if (!ReadField(pFile, fileSize, 32, &programHeaderOffset) ||
+                !ReadField(pFile, fileSize, 54, &programHeaderSize) ||
+                !ReadField(pFile, fileSize, 56, &programHeaderCount))
+            {
+                return false;
+            }
+        }
+        else
+        {
+            uint32_t programHeaderOffset32;
+            if (!ReadField(pFile, fileSize, 28, &programHeaderOffset32) ||
+                !ReadField(pFile, fileSize, 42, &programHeaderSize) ||
+                !ReadField(pFile, fileSize, 44, &programHeaderCount))
+            {
+                return false;
+            }
+            programHeaderOffset = programHeaderOffset32;
+        }
+
+        for (uint16_t i = 0; i < programHeaderCount; i++)
+        {
+            uint64_t header = programHeaderOffset + (uint64_t)programHeaderSize * i;
+            uint32_t programType;
+            uint64_t offset, address, size;
+            if (is64Bit)
+            {
+                if (!ReadField(pFile, fileSize, header, &programType) ||
+                    !ReadField(pFile, fileSize, header + 8, &offset) ||
+                    !ReadField(pFile, fileSize, header + 16, &address) ||
+                    !ReadField(pFile, fileSize, header + 32, &size))
+                {
+                    return false;
+                }
+            }
+            else
+            {
+                uint32_t offset32, address32, size32;
+                if (!ReadField(pFile, fileSize, header, &programType) ||
+                    !ReadField(pFile, fileSize, header + 4, &offset32) ||
+                    !ReadField(pFile, fileSize, header + 8, &address32) ||
+                    !ReadField(pFile, fileSize, header + 16, &size32))
+                {
+                    return false;
+                }
+                offset = offset32;
+                address = address32;
+                size = size32;
+            }
+
+            if (programType != ProgramTypeLoad)
+            {
+                continue;
+            }
+
+            if (!IsInFile(fileSize, offset, size))
+            {
+                return false;
+            }
+
+            AddRegion(address, size, pFile + offset);
+        }
+
+        return true;
+    }
+
+    std::vector<Region> m_regions;
+};
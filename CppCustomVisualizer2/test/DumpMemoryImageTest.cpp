@@ -0,0 +1,297 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+// Tests DumpMemoryImage against minidumps and ELF cores built in memory. It also writes
+// Sample.dmp and Sample.core to the directory given on the command line, which ReplayDump is run
+// against (see CMakeLists.txt).
+
+#include "TestTarget.h"
+#include "DumpMemoryImage.h"
+#include <string.h>
+#include <string>
+
+namespace
+{
+    // Builds a dump of a few memory regions in any of the formats DumpMemoryImage reads
+    class DumpBuilder
+    {
+    public:
+        void Add(uint64_t address, const void* pData, size_t size)
+        {
+            Region region;
+            region.Address = address;
+            region.Bytes.assign(static_cast<const uint8_t*>(pData), static_cast<const uint8_t*>(pData) + size);
+            m_regions.push_back(region);
+        }
+
+        // A minidump with a MemoryListStream, or a Memory64ListStream if 'memory64' is set
+        std::vector<uint8_t> BuildMinidump(bool memory64) const
+        {
+            const uint32_t HeaderSize = 32;
+            const uint32_t DirectoryEntrySize = 12;
+
+            // One unrelated stream in front of the memory list, so the directory has to be searched
+            std::vector<uint8_t> file;
+            Put<uint32_t>(&file, 0x504d444d);
+            Put<uint32_t>(&file, 0xa793);
+            Put<uint32_t>(&file, 2);
+            Put<uint32_t>(&file, HeaderSize);
+            Put<uint32_t>(&file, 0);
+            Put<uint32_t>(&file, 0);
+            Put<uint64_t>(&file, 0);
+
+            uint32_t listRva = HeaderSize + 2 * DirectoryEntrySize;
+            uint32_t listSize = memory64 ? 16 + 16 * (uint32_t)m_regions.size() : 4 + 16 * (uint32_t)m_regions.size();
+            Put<uint32_t>(&file, 3);
+            Put<uint32_t>(&file, 0);
+            Put<uint32_t>(&file, 0);
+            Put<uint32_t>(&file, memory64 ? 9 : 5);
+            Put<uint32_t>(&file, listSize);
+            Put<uint32_t>(&file, listRva);
+
+            uint64_t memoryRva = listRva + listSize;
+            if (memory64)
+            {
+                Put<uint64_t>(&file, m_regions.size());
+                Put<uint64_t>(&file, memoryRva);
+                for (const Region& region : m_regions)
+                {
+                    Put<uint64_t>(&file, region.Address);
+                    Put<uint64_t>(&file, region.Bytes.size());
+                }
+            }
+            else
+            {
+                Put<uint32_t>(&file, (uint32_t)m_regions.size());
+                for (const Region& region : m_regions)
+                {
+                    Put<uint64_t>(&file, region.Address);
+                    Put<uint32_t>(&file, (uint32_t)region.Bytes.size());
+                    Put<uint32_t>(&file, (uint32_t)memoryRva);
+                    memoryRva += region.Bytes.size();
+                }
+            }
+
+            for (const Region& region : m_regions)
+            {
+                file.insert(file.end(), region.Bytes.begin(), region.Bytes.end());
+            }
+            return file;
+        }
+
+        // An ELF core with a PT_NOTE segment followed by one PT_LOAD segment per region
+        std::vector<uint8_t> BuildElfCore(bool is64Bit) const
+        {
+            const uint16_t HeaderSize = is64Bit ? 64 : 52;
+            const uint16_t ProgramHeaderSize = is64Bit ? 56 : 32;
+            const uint16_t ProgramHeaderCount = (uint16_t)(m_regions.size() + 1);
+
+            std::vector<uint8_t> file;
+            const uint8_t identity[16] = { 0x7f, 'E', 'L', 'F', (uint8_t)(is64Bit ? 2 : 1), 1, 1 };
+            file.insert(file.end(), identity, identity + sizeof(identity));
+            Put<uint16_t>(&file, 4);
+            Put<uint16_t>(&file, is64Bit ? 62 : 3);
+            Put<uint32_t>(&file, 1);
+            PutAddress(&file, is64Bit, 0);
+            PutAddress(&file, is64Bit, HeaderSize);
+            PutAddress(&file, is64Bit, 0);
+            Put<uint32_t>(&file, 0);
+            Put<uint16_t>(&file, HeaderSize);
+            Put<uint16_t>(&file, ProgramHeaderSize);
+            Put<uint16_t>(&file, ProgramHeaderCount);
+            Put<uint16_t>(&file, 0);
+            Put<uint16_t>(&file, 0);
+            Put<uint16_t>(&file, 0);
+
+            uint64_t offset = HeaderSize + (uint64_t)ProgramHeaderSize * ProgramHeaderCount;
+            PutProgramHeader(&file, is64Bit, 4, offset, 0, 0);
+            for (const Region& region : m_regions)
+            {
+                PutProgramHeader(&file, is64Bit, 1, offset, region.Address, region.Bytes.size());
+                offset += region.Bytes.size();
+            }
+
+            for (const Region& region : m_regions)
+            {
+                file.insert(file.end(), region.Bytes.begin(), region.Bytes.end());
+            }
+            return file;
+        }
+
+    private:
+        struct Region
+        {
+            uint64_t Address;
+            std::vector<uint8_t> Bytes;
+        };
+
+        template <class T>
+        static void Put(std::vector<uint8_t>* pFile, T value)
+        {
+            const uint8_t* pBytes = reinterpret_cast<const uint8_t*>(&value);
+            pFile->insert(pFile->end(), pBytes, pBytes + sizeof(value));
+        }
+
+        static void PutAddress(std::vector<uint8_t>* pFile, bool is64Bit, uint64_t value)
+        {
+            if (is64Bit)
+            {
+                Put<uint64_t>(pFile, value);
+            }
+            else
+            {
+                Put<uint32_t>(pFile, (uint32_t)value);
+            }
+        }
+
+        static void PutProgramHeader(std::vector<uint8_t>* pFile, bool is64Bit, uint32_t type, uint64_t offset, uint64_t address, uint64_t size)
+        {
+            Put<uint32_t>(pFile, type);
+            if (is64Bit)
+            {
+                Put<uint32_t>(pFile, 4);
+            }
+            PutAddress(pFile, is64Bit, offset);
+            PutAddress(pFile, is64Bit, address);
+            PutAddress(pFile, is64Bit, 0);
+            PutAddress(pFile, is64Bit, size);
+            PutAddress(pFile, is64Bit, size);
+            if (!is64Bit)
+            {
+                Put<uint32_t>(pFile, 4);
+            }
+            PutAddress(pFile, is64Bit, 0x1000);
+        }
+
+        std::vector<Region> m_regions;
+    };
+
+    // The regions are added out of order and two of them are adjacent, so a read can span them
+    void AddTestRegions(DumpBuilder* pBuilder)
+    {
+        std::vector<uint8_t> low(0x100), high(0x200), next(0x100);
+        for (size_t i = 0; i < low.size(); i++)
+        {
+            low[i] = (uint8_t)i;
+        }
+        for (size_t i = 0; i < high.size(); i++)
+        {
+            high[i] = (uint8_t)(0x80 + i);
+        }
+        for (size_t i = 0; i < next.size(); i++)
+        {
+            next[i] = (uint8_t)(0x40 + i);
+        }
+
+        pBuilder->Add(0x8000, high.data(), high.size());
+        pBuilder->Add(0x1000, low.data(), low.size());
+        pBuilder->Add(0x8200, next.data(), next.size());
+    }
+
+    void CheckTestRegions(const std::vector<uint8_t>& file)
+    {
+        DumpMemoryImage image;
+        CHECK(image.Load(file.data(), file.size()));
+        CHECK(image.RegionCount() == 3);
+
+        uint8_t buffer[16];
+        CHECK(image(0x1010, buffer, 4) && buffer[0] == 0x10 && buffer[3] == 0x13);
+        CHECK(image(0x81fe, buffer, 4) && buffer[0] == (uint8_t)(0x80 + 0x1fe) && buffer[2] == 0x40 && buffer[3] == 0x41);
+        CHECK(!image(0x10fe, buffer, 4));
+        CHECK(!image(0x0ffc, buffer, 4));
+        CHECK(!image(0x8300, buffer, 1));
+
+        // Spans point into the file, and only cover one region
+        const uint8_t* pSpan = image.TryGetSpan(0x1020, 0x20);
+        CHECK(pSpan != nullptr && pSpan >= file.data() && pSpan < file.data() + file.size() && pSpan[0] == 0x20);
+        CHECK(image.TryGetSpan(0x10f0, 0x20) == nullptr);
+        CHECK(image.TryGetSpan(0x81f0, 0x20) == nullptr);
+    }
+
+    void TestFormats()
+    {
+        DumpBuilder builder;
+        AddTestRegions(&builder);
+
+        CheckTestRegions(builder.BuildMinidump(false));
+        CheckTestRegions(builder.BuildMinidump(true));
+        CheckTestRegions(builder.BuildElfCore(true));
+        CheckTestRegions(builder.BuildElfCore(false));
+
+        DumpMemoryImage image;
+        const uint8_t notADump[64] = { 'M', 'Z' };
+        CHECK(!image.Load(notADump, sizeof(notADump)));
+        CHECK(image.RegionCount() == 0);
+
+        // A region which claims more bytes than the file has
+        std::vector<uint8_t> truncated = builder.BuildMinidump(true);
+        truncated.resize(truncated.size() - 1);
+        CHECK(!image.Load(truncated.data(), truncated.size()));
+        truncated = builder.BuildElfCore(true);
+        truncated.resize(truncated.size() - 1);
+        CHECK(!image.Load(truncated.data(), truncated.size()));
+    }
+
+    // A 64-bit 'struct { std::vector<int> a; std::vector<int> b; }' at 0x10010 with SampleRows
+    // rows, a[i] = i and b[i] = -i. Like in a minidump, which captures heap blocks rather than
+    // pages, no region is made of whole pages: the object is only its 48 bytes, the elements end
+    // in the middle of a page, and the elements of b are split over two regions in the middle of
+    // a page. Reading the rows depends on MemoryPageCache falling back to exact reads.
+    const uint32_t SampleRows = 5000;
+
+    void WriteSampleDumps(const std::string& directory)
+    {
+        const uint64_t ObjectAddress = 0x10010;
+        const uint64_t AAddress = 0x200000;
+        const uint64_t BAddress = 0x300040;
+        const uint32_t FirstBRegionRows = 1000;
+
+        std::vector<int32_t> a(SampleRows), b(SampleRows);
+        for (uint32_t i = 0; i < SampleRows; i++)
+        {
+            a[i] = (int32_t)i;
+            b[i] = -(int32_t)i;
+        }
+
+        const uint64_t object[6] =
+        {
+            AAddress, AAddress + SampleRows * 4, AAddress + SampleRows * 4,
+            BAddress, BAddress + SampleRows * 4, BAddress + SampleRows * 4,
+        };
+
+        DumpBuilder builder;
+        builder.Add(ObjectAddress, object, sizeof(object));
+        builder.Add(AAddress, a.data(), a.size() * 4);
+        builder.Add(BAddress, b.data(), FirstBRegionRows * 4);
+        builder.Add(BAddress + FirstBRegionRows * 4, b.data() + FirstBRegionRows, (b.size() - FirstBRegionRows) * 4);
+
+        const char* names[2] = { "Sample.dmp", "Sample.core" };
+        for (int i = 0; i < 2; i++)
+        {
+            std::vector<uint8_t> file = (i == 0) ? builder.BuildMinidump(true) : builder.BuildElfCore(true);
+            std::string path = directory + "/" + names[i];
+            FILE* pFile = fopen(path.c_str(), "wb");
+            CHECK(pFile != nullptr);
+            if (pFile != nullptr)
+            {
+                CHECK(fwrite(file.data(), 1, file.size(), pFile) == file.size());
+                fclose(pFile);
+            }
+        }
+    }
+}
+
+int main(int argc, char** argv)
+{
+    TestFormats();
+    WriteSampleDumps(argc > 1 ? argv[1] : ".");
+
+    if (g_failures != 0)
+    {
+        fprintf(stderr, "%d checks failed\n", g_failures);
+        return 1;
+    }
+
+    printf("All checks passed\n");
+    return 0;
+}
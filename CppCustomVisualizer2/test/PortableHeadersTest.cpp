@@ -0,0 +1,297 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+// Tests StlVectorLayout.h, ParallelArrays.h and MemoryCache.h against a TestTarget
+
+#include "TestTarget.h"
+#include "MemoryCache.h"
+#include "ParallelArrays.h"
+#include "StlVectorLayout.h"
+
+static void TestVectorLayout()
+{
+    VectorLayout layout;
+    CHECK(VectorLayout::TryGet(8, StlFlavor::MsvcRelease, &layout));
+    CHECK(layout.FirstOffset == 0 && layout.LastOffset == 8 && layout.EndOffset == 16 && layout.VectorSize == 24);
+    CHECK(VectorLayout::TryGet(4, StlFlavor::MsvcDebugIterators, &layout));
+    CHECK(layout.FirstOffset == 4 && layout.LastOffset == 8 && layout.EndOffset == 12 && layout.VectorSize == 16);
+    CHECK(!VectorLayout::TryGet(2, StlFlavor::MsvcRelease, &layout));
+    CHECK(!VectorLayout::TryGet(8, StlFlavor::Unknown, &layout));
+
+    CHECK(VectorLayout::FlavorFromVectorSize(8, 24) == StlFlavor::MsvcRelease);
+    CHECK(VectorLayout::FlavorFromVectorSize(8, 32) == StlFlavor::MsvcDebugIterators);
+    CHECK(VectorLayout::FlavorFromVectorSize(4, 12) == StlFlavor::MsvcRelease);
+    CHECK(VectorLayout::FlavorFromVectorSize(4, 24) == StlFlavor::Unknown);
+
+    // { _Myfirst, _Mylast, _Myend } of a 32-bit vector<int> with 3 elements and room for 4
+    VectorLayout layout32;
+    VectorLayout::TryGet(4, StlFlavor::MsvcRelease, &layout32);
+    uint32_t pointers32[3] = { 0x1000, 0x100c, 0x1010 };
+    VectorBounds bounds;
+    CHECK(DecodeVector(layout32, (const uint8_t*)pointers32, 4, &bounds));
+    CHECK(bounds.First == 0x1000 && bounds.Count(4) == 3 && bounds.End == 0x1010);
+
+    // A vector which never allocated, and ones which aren't vectors of the element type
+    uint64_t empty[3] = { 0, 0, 0 };
+    uint64_t unordered[3] = { 0x2000, 0x1000, 0x3000 };
+    uint64_t partial[3] = { 0x1000, 0x1006, 0x1008 };
+    uint64_t dangling[3] = { 0, 0x1000, 0 };
+    CHECK(DecodeVector(layout, (const uint8_t*)empty, 4, &bounds) && bounds.Count(4) == 0);
+    VectorLayout::TryGet(8, StlFlavor::MsvcRelease, &layout);
+    CHECK(!DecodeVector(layout, (const uint8_t*)unordered, 4, &bounds));
+    CHECK(!DecodeVector(layout, (const uint8_t*)partial, 4, &bounds));
+    CHECK(!DecodeVector(layout, (const uint8_t*)dangling, 4, &bounds));
+}
+
+static void TestCompile()
+{
+    ParallelArrayPlan plan;
+    CHECK(ParallelArrayPlan::Compile(L"A=a:int, B = b : unsigned short", &plan));
+    CHECK(plan.Columns.size() == 2 && !plan.HasOffsets);
+    CHECK(plan.Columns[0].DisplayName == L"A" && plan.Columns[0].Member == L"a" && plan.Columns[0].Type == ColumnType::Int32);
+    CHECK(plan.Columns[1].DisplayName == L"B" && plan.Columns[1].Member == L"b" && plan.Columns[1].ElementSize == 2);
+
+    CHECK(ParallelArrayPlan::Compile(L"x:float,mass:double,id:uint64_t", &plan));
+    CHECK(plan.Columns.size() == 3 && plan.Columns[1].DisplayName == L"mass" && plan.Columns[2].Type == ColumnType::UInt64);
+
+    CHECK(!ParallelArrayPlan::Compile(L"", &plan));
+    CHECK(!ParallelArrayPlan::Compile(L"x", &plan));
+    CHECK(!ParallelArrayPlan::Compile(L"x:flot", &plan));
+    CHECK(!ParallelArrayPlan::Compile(L"=x:int", &plan));
+    CHECK(!ParallelArrayPlan::Compile(L"x:int,,y:int", &plan));
+
+    std::wstring tooMany;
+    for (size_t i = 0; i <= ParallelArrayPlan::MaxColumns; i++)
+    {
+        tooMany += L"c:char,";
+    }
+    CHECK(!ParallelArrayPlan::Compile(tooMany.c_str(), &plan));
+
+    VectorLayout layout;
+    VectorLayout::TryGet(8, StlFlavor::MsvcRelease, &layout);
+    ParallelArrayPlan::Compile(L"x:int, y:short", &plan);
+    uint32_t offsets[2] = { 40, 8 };
+    CHECK(plan.ResolveOffsets(offsets, layout));
+    CHECK(plan.HasOffsets && plan.ReadOffset == 8 && plan.ReadSize == 56);
+    CHECK(plan.Columns[0].Offset == 32 && plan.Columns[1].Offset == 0);
+
+    uint32_t farApart[2] = { 0, 8192 };
+    CHECK(!plan.ResolveOffsets(farApart, layout));
+}
+
+static void TestParallelArrayTypes()
+{
+    ParallelArrayTypes types;
+    types.Parse(L"# comment\r\n Sample = A=a:int, B=b:int \r\n\r\nnot a type\nBad=x:flot\nSample=c:char\nPoint=x:double,y:double");
+    CHECK(types.GetCount() == 2);
+    CHECK(types.Find(L"Sample") != nullptr && std::wstring(types.Find(L"Sample")) == L"A=a:int, B=b:int");
+    CHECK(types.Find(L"Point") != nullptr && std::wstring(types.Find(L"Point")) == L"x:double,y:double");
+    CHECK(types.Find(L"Bad") == nullptr && types.Find(L"sample") == nullptr);
+
+    // The file deployed next to the dll lists the types of TargetApp
+    FILE* pFile = fopen(PARALLEL_ARRAY_TYPES_PATH, "rb");
+    CHECK(pFile != nullptr);
+    if (pFile != nullptr)
+    {
+        std::wstring text;
+        int c;
+        while ((c = fgetc(pFile)) != EOF)
+        {
+            text += (wchar_t)c;
+        }
+        fclose(pFile);
+
+        ParallelArrayTypes deployed;
+        deployed.Parse(text);
+        CHECK(deployed.GetCount() == 2 && deployed.Find(L"Sample") != nullptr && deployed.Find(L"Particles") != nullptr);
+    }
+}
+
+static void TestReadRows()
+{
+    // 'struct { int id; std::vector<int> x; std::vector<short> y; }' at 0x1000, with its elements
+    // at 0x2000 and 0x3000
+    const uint64_t ObjectAddress = 0x1000;
+    const uint64_t XAddress = 0x2000;
+    const uint64_t YAddress = 0x3000;
+    static const int32_t xs[5] = { 1, -2, 3, 4, 5 };
+    static const int16_t ys[5] = { 10, 20, 30, 40, -50 };
+
+    uint8_t object[56] = {};
+    uint64_t x[3] = { XAddress, XAddress + sizeof(xs), XAddress + sizeof(xs) };
+    uint64_t y[3] = { YAddress, YAddress + sizeof(ys), YAddress + sizeof(ys) };
+    memcpy(object + 8, x, sizeof(x));
+    memcpy(object + 32, y, sizeof(y));
+
+    TestTarget target;
+    target.Add(ObjectAddress, object, sizeof(object));
+    target.Add(XAddress, xs, sizeof(xs));
+    target.Add(YAddress, ys, sizeof(ys));
+
+    ParallelArrayPlan plan;
+    VectorLayout layout;
+    VectorLayout::TryGet(8, StlFlavor::MsvcRelease, &layout);
+    uint32_t offsets[2] = { 8, 32 };
+    CHECK(ParallelArrayPlan::Compile(L"x:int, y:short", &plan) && plan.ResolveOffsets(offsets, layout));
+
+    VectorBounds bounds[2];
+    CHECK(ReadParallelArrayBounds(plan, ObjectAddress, target, bounds));
+    CHECK(target.Reads() == 1);
+    CHECK(bounds[0].Count(4) == 5 && bounds[1].Count(2) == 5);
+
+    ParallelArrayWindow window;
+    CHECK(ReadParallelArrayWindow(plan, bounds, 1, 4, target, &window));
+    CHECK(target.Reads() == 3);
+
+    ParallelArrayRow row;
+    CHECK(!window.TryGetRow(plan, 0, &row));
+    CHECK(!window.TryGetRow(plan, 5, &row));
+    CHECK(window.TryGetRow(plan, 4, &row));
+    CHECK(row.Addresses[0] == XAddress + 16 && row.Addresses[1] == YAddress + 8);
+
+    wchar_t buffer[ColumnValueBufferLength];
+    CHECK(FormatColumnValue(ColumnType::Int16, row.Values[1], false, buffer) == 3 && wcscmp(buffer, L"-50") == 0);
+    FormatColumnValue(ColumnType::Int16, row.Values[1], true, buffer);
+    CHECK(wcscmp(buffer, L"0xffce") == 0);
+    CHECK(window.TryGetRow(plan, 1, &row));
+    FormatColumnValue(ColumnType::Int32, row.Values[0], false, buffer);
+    CHECK(wcscmp(buffer, L"-2") == 0);
+    FormatColumnValue(ColumnType::Int32, row.Values[0], true, buffer);
+    CHECK(wcscmp(buffer, L"0xfffffffe") == 0);
+
+    uint64_t largest = UINT64_MAX;
+    FormatColumnValue(ColumnType::UInt64, (const uint8_t*)&largest, false, buffer);
+    CHECK(wcscmp(buffer, L"18446744073709551615") == 0);
+
+    // Like the EE: chars with their character, and floating point values with all of their digits
+    const uint8_t chars[] = { 'a', 0, '\n', '\'', 0x01, 0x80, 0xe9 };
+    CHECK(FormatColumnValue(ColumnType::Int8, &chars[0], false, buffer) == 6 && wcscmp(buffer, L"97 'a'") == 0);
+    FormatColumnValue(ColumnType::Int8, &chars[0], true, buffer);
+    CHECK(wcscmp(buffer, L"0x61 'a'") == 0);
+    FormatColumnValue(ColumnType::UInt8, &chars[1], false, buffer);
+    CHECK(wcscmp(buffer, L"0 '\\0'") == 0);
+    FormatColumnValue(ColumnType::Int8, &chars[2], false, buffer);
+    CHECK(wcscmp(buffer, L"10 '\\n'") == 0);
+    FormatColumnValue(ColumnType::Int8, &chars[3], false, buffer);
+    CHECK(wcscmp(buffer, L"39 '\\''") == 0);
+    FormatColumnValue(ColumnType::Int8, &chars[4], false, buffer);
+    CHECK(wcscmp(buffer, L"1 '\\x1'") == 0);
+    FormatColumnValue(ColumnType::Int8, &chars[5], false, buffer);
+    CHECK(wcscmp(buffer, L"-128 '\x20ac'") == 0);
+    FormatColumnValue(ColumnType::UInt8, &chars[6], false, buffer);
+    CHECK(wcscmp(buffer, L"233 '\xe9'") == 0);
+    CHECK(FormatColumnNumber(ColumnType::Int8, &chars[0], false, buffer) == 2 && wcscmp(buffer, L"97") == 0);
+
+    const float floats[] = { 1.0f, 0.1f, 1e20f };
+    FormatColumnValue(ColumnType::Float, (const uint8_t*)&floats[0], false, buffer);
+    CHECK(wcscmp(buffer, L"1.00000000") == 0);
+    FormatColumnValue(ColumnType::Float, (const uint8_t*)&floats[1], true, buffer);
+    CHECK(wcscmp(buffer, L"0.100000001") == 0);
+    FormatColumnValue(ColumnType::Float, (const uint8_t*)&floats[2], false, buffer);
+    CHECK(wcscmp(buffer, L"1.00000002e+20") == 0);
+    const double doubles[] = { 1.0, 0.1, -1.7976931348623157e308 };
+    FormatColumnValue(ColumnType::Double, (const uint8_t*)&doubles[0], false, buffer);
+    CHECK(wcscmp(buffer, L"1.0000000000000000") == 0);
+    FormatColumnValue(ColumnType::Double, (const uint8_t*)&doubles[1], false, buffer);
+    CHECK(wcscmp(buffer, L"0.10000000000000001") == 0);
+    FormatColumnValue(ColumnType::Double, (const uint8_t*)&doubles[2], false, buffer);
+    CHECK(wcscmp(buffer, L"-1.7976931348623157e+308") == 0);
+
+    // Rows past the end of the elements can't be read
+    CHECK(!ReadParallelArrayWindow(plan, bounds, 3, 4, target, &window));
+}
+
+static void TestMemoryCache()
+{
+    const uint64_t Base = 0x10000;
+    const uint32_t PageSize = MemoryPageCache::PageSize;
+    std::vector<uint8_t> bytes(4 * PageSize);
+    for (size_t i = 0; i < bytes.size(); i++)
+    {
+        bytes[i] = (uint8_t)(i * 7);
+    }
+
+    TestTarget target;
+    target.Add(Base, bytes.data(), bytes.size());
+
+    MemoryPageCache cache;
+    uint8_t buffer[2 * MemoryPageCache::PageSize];
+
+    // A read which straddles two pages fetches both with one call
+    CHECK(cache.Read(Base + PageSize - 8, buffer, 16, target));
+    CHECK(memcmp(buffer, bytes.data() + PageSize - 8, 16) == 0);
+    CHECK(target.Reads() == 1 && cache.Misses() == 2 && cache.Hits() == 0);
+
+    // Reading inside those pages again doesn't go to the target
+    CHECK(cache.Read(Base + 100, buffer, 200, target));
+    CHECK(memcmp(buffer, bytes.data() + 100, 200) == 0);
+    CHECK(target.Reads() == 1 && cache.Hits() == 1);
+
+    // Only the missing page is fetched
+    CHECK(cache.Read(Base + PageSize, buffer, 2 * PageSize, target));
+    CHECK(memcmp(buffer, bytes.data() + PageSize, 2 * PageSize) == 0);
+    CHECK(target.Reads() == 2 && cache.Misses() == 3);
+
+    // The run of pages past the end fails as a whole, then each page is tried on its own, then
+    // the exact range. The readable page is kept, and the unreadable one isn't fetched again:
+    // reads which touch it only read their own bytes.
+    uint32_t readsBefore = target.Reads();
+    CHECK(!cache.Read(Base + 3 * PageSize, buffer, 2 * PageSize, target));
+    CHECK(target.Reads() == readsBefore + 4 && cache.ExactReads() == 1);
+    CHECK(cache.Read(Base + 3 * PageSize, buffer, PageSize, target));
+    CHECK(memcmp(buffer, bytes.data() + 3 * PageSize, PageSize) == 0);
+    CHECK(!cache.Read(Base + 4 * PageSize, buffer, 1, target));
+    CHECK(target.Reads() == readsBefore + 5 && cache.ExactReads() == 2);
+
+    CHECK(cache.Read(0, buffer, 0, target));
+    CHECK(!cache.Read(UINT64_MAX, buffer, 2, target));
+
+    cache.Clear();
+    readsBefore = target.Reads();
+    CHECK(cache.Read(Base, buffer, 1, target) && buffer[0] == bytes[0]);
+    CHECK(target.Reads() == readsBefore + 1);
+}
+
+// A minidump captures ranges of memory which aren't whole pages, ex: a heap block. Reads inside
+// them succeed even though their page can't be read.
+static void TestMemoryCachePartialPages()
+{
+    const uint64_t BlockAddress = 0x20010;
+    const uint8_t block[0x30] = { 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12 };
+
+    TestTarget target;
+    target.Add(BlockAddress, block, sizeof(block));
+
+    MemoryPageCache cache;
+    uint64_t value = 0;
+    CHECK(cache.Read(BlockAddress + 4, &value, sizeof(value), target));
+    CHECK(memcmp(&value, block + 4, sizeof(value)) == 0);
+    CHECK(target.Reads() == 2 && cache.ExactReads() == 1);
+
+    // The page isn't fetched again
+    CHECK(cache.Read(BlockAddress, &value, sizeof(value), target));
+    CHECK(memcmp(&value, block, sizeof(value)) == 0);
+    CHECK(target.Reads() == 3 && cache.ExactReads() == 2);
+
+    // Bytes outside of the block still can't be read
+    CHECK(!cache.Read(BlockAddress + sizeof(block) - 4, &value, sizeof(value), target));
+}
+
+int main()
+{
+    TestVectorLayout();
+    TestCompile();
+    TestParallelArrayTypes();
+    TestReadRows();
+    TestMemoryCache();
+    TestMemoryCachePartialPages();
+
+    if (g_failures != 0)
+    {
+        fprintf(stderr, "%d checks failed\n", g_failures);
+        return 1;
+    }
+
+    printf("All checks passed\n");
+    return 0;
+}
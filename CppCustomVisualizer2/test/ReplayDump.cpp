@@ -0,0 +1,322 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+// ReplayDump replays the expansion of a parallel arrays object (see ParallelArrays.h) against a
+// minidump or ELF core, without a debugger. It reads the object's vectors and then pages through
+// all of its rows the way CChildVisualizer does when someone scrolls through '[Index]' rows: one
+// page per GetItems call, each read through a MemoryPageCache, with the next pages prefetched once
+// the pages are listed in order. Every cell is formatted with FormatColumnValue. It prints how long
+// each page took, so that changes to the row reading can be measured against real captured heaps.
+// Like the visualizer, it reads whole pages through MemoryPageCache, and reads exactly the bytes it
+// needs where a dump only captured part of a page.
+//
+// Usage: ReplayDump <dump> <object address> <descriptor> <offsets> [options]
+//   <object address>  hex address of the object in the dump
+//   <descriptor>      the object's columns, ex: "A=a:int, B=b:int"
+//   <offsets>         comma separated offset of each column's std::vector in the object, ex: 0,24
+// Options:
+//   -pointersize 4|8  pointer size of the target (default 8)
+//   -debugiterators   the target was built with _ITERATOR_DEBUG_LEVEL != 0
+//   -pagerows N       rows per page (default 100)
+//   -print N          print the first N rows
+
+#include "DumpMemoryImage.h"
+#include "MemoryCache.h"
+#include "ParallelArrays.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iterator>
+
+namespace
+{
+    // The same as CChildVisualizer::PrefetchPages and CChildVisualizer::PrefetchByteBudget
+    const uint32_t PrefetchPages = 2;
+    const uint32_t PrefetchByteBudget = 1024 * 1024;
+
+    struct Options
+    {
+        const char* DumpPath;
+        uint64_t ObjectAddress;
+        std::wstring Descriptor;
+        std::vector<uint32_t> Offsets;
+        uint32_t PointerSize;
+        StlFlavor::e Flavor;
+        uint32_t PageRows;
+        uint64_t PrintRows;
+    };
+
+    bool ParseOptions(int argc, char** argv, Options* pOptions)
+    {
+        if (argc < 5)
+        {
+            return false;
+        }
+
+        pOptions->DumpPath = argv[1];
+        pOptions->ObjectAddress = strtoull(argv[2], nullptr, 16);
+        std::string descriptor(argv[3]);
+        pOptions->Descriptor.assign(descriptor.begin(), descriptor.end());
+        for (const char* pOffset = argv[4]; *pOffset != '\0'; )
+        {
+            char* pEnd;
+            pOptions->Offsets.push_back((uint32_t)strtoul(pOffset, &pEnd, 0));
+            if (pEnd == pOffset)
+            {
+                return false;
+            }
+            pOffset = (*pEnd == ',') ? pEnd + 1 : pEnd;
+        }
+
+        pOptions->PointerSize = 8;
+        pOptions->Flavor = StlFlavor::MsvcRelease;
+        pOptions->PageRows = 100;
+        pOptions->PrintRows = 0;
+        for (int i = 5; i < argc; i++)
+        {
+            std::string option(argv[i]);
+            bool hasValue = i + 1 < argc;
+            if (option == "-pointersize" && hasValue)
+            {
+                pOptions->PointerSize = (uint32_t)atoi(argv[++i]);
+            }
+            else if (option == "-debugiterators")
+            {
+                pOptions->Flavor = StlFlavor::MsvcDebugIterators;
+            }
+            else if (option == "-pagerows" && hasValue)
+            {
+                pOptions->PageRows = (uint32_t)atoi(argv[++i]);
+            }
+            else if (option == "-print" && hasValue)
+            {
+                pOptions->PrintRows = strtoull(argv[++i], nullptr, 10);
+            }
+            else
+            {
+                return false;
+            }
+        }
+
+        return pOptions->PageRows != 0;
+    }
+
+    double Percentile(const std::vector<double>& sorted, double fraction)
+    {
+        if (sorted.empty())
+        {
+            return 0;
+        }
+        return sorted[std::min(sorted.size() - 1, (size_t)(fraction * sorted.size()))];
+    }
+
+    // The two windows of rows which CChildVisualizer keeps, and the same logic to fill them
+    class RowReader
+    {
+    public:
+        RowReader(const ParallelArrayPlan& plan, const VectorBounds* pBounds, uint64_t rowCount) :
+            m_plan(plan),
+            m_pBounds(pBounds),
+            m_rowCount(rowCount),
+            m_newestWindow(0),
+            m_pageFirst(0),
+            m_pageCount(0),
+            m_fSequential(false),
+            m_prefetchHits(0),
+            m_prefetchMisses(0)
+        {
+            m_prefetchedFirst[0] = m_prefetchedFirst[1] = 0;
+        }
+
+        void SetPage(uint64_t first, uint32_t count)
+        {
+            m_fSequential = (m_pageCount != 0 && first == m_pageFirst + m_pageCount);
+            m_pageFirst = first;
+            m_pageCount = count;
+        }
+
+        template <class TReader>
+        bool TryGetRow(uint64_t index, TReader& reader, ParallelArrayRow* pRow)
+        {
+            for (size_t i = 0; i < 2; i++)
+            {
+                size_t window = (m_newestWindow + i) % 2;
+                if (m_windows[window].TryGetRow(m_plan, index, pRow))
+                {
+                    m_prefetchHits += (index >= m_prefetchedFirst[window]) ? 1 : 0;
+                    return true;
+                }
+            }
+            m_prefetchMisses++;
+
+            uint64_t first = m_pageFirst;
+            uint32_t count = m_pageCount;
+            uint32_t prefetchCount = 0;
+            if (m_fSequential && first + count < m_rowCount)
+            {
+                uint32_t rowSize = 0;
+                for (size_t i = 0; i < m_plan.Columns.size(); i++)
+                {
+                    rowSize += m_plan.Columns[i].ElementSize;
+                }
+
+                uint64_t rows = std::min((uint64_t)PrefetchPages * count, m_rowCount - (first + count));
+                rows = std::min(rows, (uint64_t)(PrefetchByteBudget / rowSize));
+                prefetchCount = (uint32_t)rows;
+            }
+
+            ParallelArrayWindow window;
+            if (!ReadParallelArrayWindow(m_plan, m_pBounds, first, count + prefetchCount, reader, &window) &&
+                (prefetchCount == 0 || !ReadParallelArrayWindow(m_plan, m_pBounds, first, count, reader, &window)))
+            {
+                return false;
+            }
+            bool hasRow = window.TryGetRow(m_plan, index, pRow);
+
+            std::swap(m_windows[1 - m_newestWindow], window);
+            m_newestWindow = 1 - m_newestWindow;
+            m_prefetchedFirst[m_newestWindow] = first + count;
+            return hasRow;
+        }
+
+        uint64_t PrefetchHits() const
+        {
+            return m_prefetchHits;
+        }
+
+        uint64_t PrefetchMisses() const
+        {
+            return m_prefetchMisses;
+        }
+
+    private:
+        const ParallelArrayPlan& m_plan;
+        const VectorBounds* m_pBounds;
+        uint64_t m_rowCount;
+        ParallelArrayWindow m_windows[2];
+        uint64_t m_prefetchedFirst[2];
+        size_t m_newestWindow;
+        uint64_t m_pageFirst;
+        uint32_t m_pageCount;
+        bool m_fSequential;
+        uint64_t m_prefetchHits;
+        uint64_t m_prefetchMisses;
+    };
+}
+
+int main(int argc, char** argv)
+{
+    Options options;
+    if (!ParseOptions(argc, argv, &options))
+    {
+        fprintf(stderr, "Usage: ReplayDump <dump> <object address> <descriptor> <offsets> [-pointersize 4|8] [-debugiterators] [-pagerows N] [-print N]\n");
+        return 2;
+    }
+
+    std::ifstream file(options.DumpPath, std::ios::binary);
+    std::vector<uint8_t> dump((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    DumpMemoryImage image;
+    if (!file || !image.Load(dump.data(), dump.size()))
+    {
+        fprintf(stderr, "%s is not a minidump or ELF core with memory\n", options.DumpPath);
+        return 1;
+    }
+    printf("Dump: %zu bytes, %zu memory regions\n", dump.size(), image.RegionCount());
+
+    ParallelArrayPlan plan;
+    VectorLayout layout;
+    if (!ParallelArrayPlan::Compile(options.Descriptor.c_str(), &plan) ||
+        options.Offsets.size() != plan.Columns.size() ||
+        !VectorLayout::TryGet(options.PointerSize, options.Flavor, &layout) ||
+        !plan.ResolveOffsets(options.Offsets.data(), layout))
+    {
+        fprintf(stderr, "The descriptor, offsets or pointer size aren't valid\n");
+        return 1;
+    }
+
+    // Count the reads which get past the cache, as the debugger would send them to the target
+    uint64_t targetReads = 0;
+    auto targetReader = [&image, &targetReads](uint64_t address, void* pBuffer, uint32_t size) -> bool
+    {
+        targetReads++;
+        return image(address, pBuffer, size);
+    };
+    MemoryPageCache cache;
+    auto reader = [&cache, &targetReader](uint64_t address, void* pBuffer, uint32_t size) -> bool
+    {
+        return cache.Read(address, pBuffer, size, targetReader);
+    };
+
+    typedef std::chrono::steady_clock Clock;
+    Clock::time_point start = Clock::now();
+
+    std::vector<VectorBounds> bounds(plan.Columns.size());
+    if (!ReadParallelArrayBounds(plan, options.ObjectAddress, reader, bounds.data()))
+    {
+        fprintf(stderr, "The object at 0x%llx doesn't hold vectors of the descriptor's types\n", (unsigned long long)options.ObjectAddress);
+        return 1;
+    }
+
+    uint64_t rowCount = UINT64_MAX;
+    for (size_t i = 0; i < plan.Columns.size(); i++)
+    {
+        rowCount = std::min(rowCount, bounds[i].Count(plan.Columns[i].ElementSize));
+    }
+    double boundsMicroseconds = std::chrono::duration<double, std::micro>(Clock::now() - start).count();
+    printf("Rows: %llu in %zu columns, vectors read in %.1f us\n", (unsigned long long)rowCount, plan.Columns.size(), boundsMicroseconds);
+
+    RowReader rows(plan, bounds.data(), rowCount);
+    std::vector<double> pageMicroseconds;
+    uint64_t unreadableRows = 0;
+    size_t formattedLength = 0;
+    for (uint64_t first = 0; first < rowCount; first += options.PageRows)
+    {
+        uint32_t count = (uint32_t)std::min<uint64_t>(options.PageRows, rowCount - first);
+        Clock::time_point pageStart = Clock::now();
+
+        rows.SetPage(first, count);
+        for (uint64_t index = first; index < first + count; index++)
+        {
+            ParallelArrayRow row;
+            if (!rows.TryGetRow(index, reader, &row))
+            {
+                unreadableRows++;
+                continue;
+            }
+
+            std::wstring line;
+            for (size_t i = 0; i < plan.Columns.size(); i++)
+            {
+                wchar_t value[ColumnValueBufferLength];
+                FormatColumnValue(plan.Columns[i].Type, row.Values[i], false, value);
+                line += (i == 0) ? L"" : L" ";
+                line += plan.Columns[i].DisplayName + L"=" + value;
+            }
+            formattedLength += line.size();
+
+            if (index < options.PrintRows)
+            {
+                printf("[%llu] %ls\n", (unsigned long long)index, line.c_str());
+            }
+        }
+
+        pageMicroseconds.push_back(std::chrono::duration<double, std::micro>(Clock::now() - pageStart).count());
+    }
+
+    double totalMilliseconds = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    std::vector<double> sorted(pageMicroseconds);
+    std::sort(sorted.begin(), sorted.end());
+
+    printf("Pages: %zu of %u rows, p50 %.1f us, p90 %.1f us, p99 %.1f us, max %.1f us\n",
+        pageMicroseconds.size(), options.PageRows,
+        Percentile(sorted, 0.5), Percentile(sorted, 0.9), Percentile(sorted, 0.99), sorted.empty() ? 0.0 : sorted.back());
+    printf("Total: %.2f ms, %zu characters formatted, %llu unreadable rows\n", totalMilliseconds, formattedLength, (unsigned long long)unreadableRows);
+    printf("Page cache: %llu hits, %llu misses, %llu reads of the dump, %llu exact reads\n",
+        (unsigned long long)cache.Hits(), (unsigned long long)cache.Misses(), (unsigned long long)targetReads,
+        (unsigned long long)cache.ExactReads());
+    printf("Prefetch: %llu hits, %llu misses\n", (unsigned long long)rows.PrefetchHits(), (unsigned long long)rows.PrefetchMisses());
+
+    return unreadableRows == 0 ? 0 : 1;
+}
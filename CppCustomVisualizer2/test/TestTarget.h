@@ -0,0 +1,72 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+#pragma once
+
+// Helpers shared by the tests in this directory: a check macro which also works in release
+// builds, and TestTarget, a reader over byte buffers which stands in for the target process.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <map>
+#include <vector>
+
+static int g_failures = 0;
+
+#define CHECK(condition) \
+    do \
+    { \
+        if (!(condition)) \
+        { \
+            fprintf(stderr, "%s(%d): CHECK(%s) failed\n", __FILE__, __LINE__, #condition); \
+            g_failures++; \
+        } \
+    } while (0)
+
+// Target memory made of regions at fixed addresses. Reads which are not entirely inside one
+// region fail, like a read from the target which touches an unmapped page.
+class TestTarget
+{
+public:
+    TestTarget() :
+        m_reads(0)
+    {
+    }
+
+    void Add(uint64_t address, const void* pData, size_t size)
+    {
+        const uint8_t* pBytes = static_cast<const uint8_t*>(pData);
+        m_regions[address].assign(pBytes, pBytes + size);
+    }
+
+    bool operator()(uint64_t address, void* pBuffer, uint32_t size)
+    {
+        m_reads++;
+
+        auto it = m_regions.upper_bound(address);
+        if (it == m_regions.begin())
+        {
+            return false;
+        }
+        --it;
+
+        uint64_t offset = address - it->first;
+        if (offset > it->second.size() || size > it->second.size() - offset)
+        {
+            return false;
+        }
+
+        memcpy(pBuffer, it->second.data() + offset, size);
+        return true;
+    }
+
+    // Number of calls to the reader so far
+    uint32_t Reads() const
+    {
+        return m_reads;
+    }
+
+private:
+    std::map<uint64_t, std::vector<uint8_t>> m_regions;
+    uint32_t m_reads;
+};
@@ -0,0 +1,123 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#pragma once
+
+// AnnotationFrameCache remembers the annotation frames the filter inserted in a thread's stack,
+// so that the next walk of the thread can return the same frame objects instead of creating
+// them again. Each step in the debugger walks the stack of the thread again, and most of the
+// frames in the new walk (everything outside of the function being stepped through) are the same
+// as in the last one. An annotation frame only depends on the thread, the frame base of the frame
+// below it and the rule it shows, so it is keyed by that frame base and checked against the
+// rule. Which rule applies to a frame is remembered by the module (see
+// CModuleAnnotationDataItem), so it isn't kept here. TFrame is what the caller holds a frame with
+// (ex: CComPtr<DkmStackWalkFrame>).
+//
+// Every annotation frame is stamped with the last walk which used it, and only the ones the last
+// two walks used are kept, so the cache is never bigger than twice the annotations of a stack.
+// The cache isn't locked; CAnnotationFrameCacheDataItem locks around it. It only depends on the
+// C++ standard library, so that the replay tool in ..\test runs the same code as the filter.
+
+#include <stddef.h>
+#include <stdint.h>
+#include <unordered_map>
+
+template <class TFrame>
+class AnnotationFrameCache
+{
+public:
+    AnnotationFrameCache() :
+        m_walk(0),
+        m_walkHits(0),
+        m_walkMisses(0),
+        m_totalHits(0),
+        m_totalMisses(0)
+    {
+    }
+
+    // Called when a new walk of the thread starts. The frames which neither of the last two
+    // walks used are dropped.
+    void BeginWalk()
+    {
+        m_walk++;
+        m_walkHits = 0;
+        m_walkMisses = 0;
+
+        for (auto it = m_frames.begin(); it != m_frames.end(); )
+        {
+            if (m_walk - it->second.Walk > 1)
+            {
+                it = m_frames.erase(it);
+            }
+            else
+            {
+                ++it;
+            }
+        }
+    }
+
+    // Looks up the annotation frame showing rule 'rule' above the frame at 'frameBase'. Returns
+    // false if this walk or the previous one didn't create one.
+    bool Lookup(uint64_t frameBase, int rule, TFrame* pFrame)
+    {
+        auto it = m_frames.find(frameBase);
+        if (it == m_frames.end() || it->second.Rule != rule)
+        {
+            m_walkMisses++;
+            m_totalMisses++;
+            return false;
+        }
+
+        m_walkHits++;
+        m_totalHits++;
+
+        // Stamping the frame with this walk keeps it for the next one
+        it->second.Walk = m_walk;
+        *pFrame = it->second.Frame;
+        return true;
+    }
+
+    // Stores the annotation frame created to show rule 'rule' above the frame at 'frameBase'
+    void Add(uint64_t frameBase, int rule, const TFrame& frame)
+    {
+        Entry& entry = m_frames[frameBase];
+        entry.Rule = rule;
+        entry.Frame = frame;
+        entry.Walk = m_walk;
+    }
+
+    // Returns the number of hits and misses in the current walk, and since the cache was created
+    void GetStatistics(uint32_t* pWalkHits, uint32_t* pWalkMisses, uint64_t* pTotalHits, uint64_t* pTotalMisses) const
+    {
+        *pWalkHits = m_walkHits;
+        *pWalkMisses = m_walkMisses;
+        *pTotalHits = m_totalHits;
+        *pTotalMisses = m_totalMisses;
+    }
+
+    // Returns the number of annotation frames in the cache
+    size_t GetCount() const
+    {
+        return m_frames.size();
+    }
+
+private:
+    struct Entry
+    {
+        // Index of the annotation rule the frame shows
+        int Rule;
+        TFrame Frame;
+        // The last walk which used the frame
+        uint32_t Walk;
+    };
+
+    // Keyed by the frame base of the frame below the annotation
+    std::unordered_map<uint64_t, Entry> m_frames;
+    uint32_t m_walk;
+
+    // Lookups which found a frame, and which didn't, in the current walk and in total
+    uint32_t m_walkHits;
+    uint32_t m_walkMisses;
+    uint64_t m_totalHits;
+    uint64_t m_totalMisses;
+};
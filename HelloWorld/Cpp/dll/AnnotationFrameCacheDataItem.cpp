@@ -0,0 +1,84 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include "StdAfx.h"
+#include "AnnotationFrameCacheDataItem.h"
+
+void CAnnotationFrameCacheDataItem::BeginWalk()
+{
+    ObjectLock lock(this);
+
+    m_cache.BeginWalk();
+}
+
+CComPtr<DkmStackWalkFrame> CAnnotationFrameCacheDataItem::Lookup(
+    UINT64 frameBase,
+    int rule
+    )
+{
+    ObjectLock lock(this);
+
+    CComPtr<DkmStackWalkFrame> pFrame;
+    m_cache.Lookup(frameBase, rule, &pFrame);
+    return pFrame;
+}
+
+void CAnnotationFrameCacheDataItem::Add(
+    UINT64 frameBase,
+    int rule,
+    DkmStackWalkFrame* pFrame
+    )
+{
+    ObjectLock lock(this);
+
+    m_cache.Add(frameBase, rule, pFrame);
+}
+
+void CAnnotationFrameCacheDataItem::GetStatistics(
+    UINT32* pWalkHits,
+    UINT32* pWalkMisses,
+    UINT64* pTotalHits,
+    UINT64* pTotalMisses
+    )
+{
+    ObjectLock lock(this);
+
+    m_cache.GetStatistics(pWalkHits, pWalkMisses, pTotalHits, pTotalMisses);
+}
+
+// Returns the instance of CAnnotationFrameCacheDataItem associated with the input DkmThread
+// object. If there is not currently an associated CAnnotationFrameCacheDataItem, a new data item
+// will be created.
+HRESULT CAnnotationFrameCacheDataItem::GetInstance(
+    DkmThread* pThread,
+    CAnnotationFrameCacheDataItem** ppCache
+    )
+{
+    HRESULT hr;
+
+    // If there is already an associated item, return it.
+    hr = pThread->GetDataItem(ppCache);
+    if (hr == S_OK)
+        return hr;
+
+    // Otherwise create a new object
+    CComObject<CAnnotationFrameCacheDataItem>* pComObject;
+    hr = CComObject<CAnnotationFrameCacheDataItem>::CreateInstance(&pComObject);
+    if (FAILED(hr))
+    {
+        return hr;
+    }
+
+    CComPtr<CAnnotationFrameCacheDataItem> pCreatedInstance(pComObject);
+
+    // Unlike the stack context, the thread can be walked from several places at once. If
+    // another walk set the data item first, use that one.
+    hr = pThread->SetDataItem(DkmDataCreationDisposition::CreateNew, pCreatedInstance);
+    if (FAILED(hr))
+    {
+        return pThread->GetDataItem(ppCache);
+    }
+
+    *ppCache = pCreatedInstance.Detach();
+    return S_OK;
+}
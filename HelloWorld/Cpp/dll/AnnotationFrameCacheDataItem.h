@@ -0,0 +1,78 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#pragma once
+
+#include "AnnotationFrameCache.h"
+
+// CAnnotationFrameCacheDataItem is an internal COM object which the HelloWorld component
+// associates with a DkmThread, to hold the thread's AnnotationFrameCache. Several windows can
+// walk the same thread at once, so every call is locked. The cache is only used for the frames
+// which get an annotation, so most frames never touch it.
+class ATL_NO_VTABLE __declspec(uuid("9a3bf5de-c4f3-4157-8e53-53cbe3417659")) CAnnotationFrameCacheDataItem :
+    public IUnknown,
+    public CComObjectRootEx<CComMultiThreadModel>
+{
+private:
+    AnnotationFrameCache<CComPtr<DkmStackWalkFrame>> m_cache;
+
+// CAnnotationFrameCacheDataItem is created through CComObject<CAnnotationFrameCacheDataItem>::CreateInstance
+protected:
+    CAnnotationFrameCacheDataItem()
+    {
+    }
+    ~CAnnotationFrameCacheDataItem()
+    {
+    }
+
+public:
+    // Called when a new walk of the thread starts
+    void BeginWalk();
+
+    // Returns the annotation frame showing rule 'rule' above the frame at 'frameBase' which an
+    // earlier walk created, or NULL
+    CComPtr<DkmStackWalkFrame> Lookup(
+        UINT64 frameBase,
+        int rule
+        );
+
+    // Stores the annotation frame created to show rule 'rule' above the frame at 'frameBase'
+    void Add(
+        UINT64 frameBase,
+        int rule,
+        DkmStackWalkFrame* pFrame
+        );
+
+    // See AnnotationFrameCache::GetStatistics
+    void GetStatistics(
+        UINT32* pWalkHits,
+        UINT32* pWalkMisses,
+        UINT64* pTotalHits,
+        UINT64* pTotalMisses
+        );
+
+    // Returns the instance of CAnnotationFrameCacheDataItem associated with the input DkmThread
+    // object. If there is not currently an associated CAnnotationFrameCacheDataItem, a new data
+    // item will be created.
+    static HRESULT GetInstance(
+        DkmThread* pThread,
+        CAnnotationFrameCacheDataItem** ppCache
+        );
+
+protected:
+    HRESULT _InternalQueryInterface(REFIID riid, void **ppvObject)
+    {
+        if (ppvObject == NULL)
+            return E_POINTER;
+
+        if (riid == __uuidof(IUnknown))
+        {
+            *ppvObject = static_cast<IUnknown*>(this);
+            AddRef();
+            return S_OK;
+        }
+
+        *ppvObject = NULL;
+        return E_NOINTERFACE;
+    }
+};
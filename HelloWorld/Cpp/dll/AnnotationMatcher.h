@@ -0,0 +1,224 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#pragma once
+
+// This file defines AnnotationMatcher, which finds the annotation rule (see HelloWorld.rules)
+// that applies to a module name. The patterns of all of the rules are compiled into a single
+// Aho-Corasick automaton, so matching a name is one pass over its characters however many rules
+// there are. Patterns and names are compared ignoring case. The file also has the parser for
+// the rules. It only depends on the C++ standard library.
+
+#include <stdint.h>
+#include <wctype.h>
+#include <queue>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class AnnotationMatcher
+{
+public:
+    // Returned by Match when no pattern occurs in the text
+    enum { NoMatch = -1 };
+
+    AnnotationMatcher()
+    {
+        Build(std::vector<std::wstring>());
+    }
+
+    // Compiles 'patterns'. The index of a pattern in 'patterns' is the index of its rule. Empty
+    // patterns never match.
+    void Build(const std::vector<std::wstring>& patterns)
+    {
+        // Number the characters which occur in the patterns from 1. Everything else is class 0,
+        // which always leads back to the root.
+        m_asciiClasses.assign(128, 0);
+        m_otherClasses.clear();
+        m_classCount = 1;
+        for (const std::wstring& pattern : patterns)
+        {
+            for (wchar_t c : pattern)
+            {
+                c = Fold(c);
+                if (CharClass(c) != 0)
+                {
+                    continue;
+                }
+                if (c < 128)
+                {
+                    m_asciiClasses[c] = m_classCount;
+                }
+                else
+                {
+                    m_otherClasses[c] = m_classCount;
+                }
+                m_classCount++;
+            }
+        }
+
+        // Build the trie of the patterns. State 0 is the root, so a 0 transition out of any
+        // other state means there is no edge yet.
+        m_transitions.assign(m_classCount, 0);
+        m_matches.assign(1, NoMatch);
+        for (size_t i = 0; i < patterns.size(); i++)
+        {
+            if (patterns[i].empty())
+            {
+                continue;
+            }
+
+            uint32_t state = 0;
+            for (wchar_t c : patterns[i])
+            {
+                uint32_t& next = m_transitions[state * m_classCount + CharClass(Fold(c))];
+                if (next == 0)
+                {
+                    next = (uint32_t)m_matches.size();
+                    m_matches.push_back(NoMatch);
+                    m_transitions.resize(m_transitions.size() + m_classCount, 0);
+                }
+                // 'next' may have moved with the resize
+                state = m_transitions[state * m_classCount + CharClass(Fold(c))];
+            }
+
+            // Patterns are added in rule order, so the first rule wins if two are the same
+            if (m_matches[state] == NoMatch)
+            {
+                m_matches[state] = (int)i;
+            }
+        }
+
+        // Turn the trie into a DFA in breadth first order: every missing edge goes where the
+        // failure link's edge goes, and every state also matches what its failure link matches.
+        std::vector<uint32_t> failures(m_matches.size(), 0);
+        std::queue<uint32_t> pending;
+        for (uint32_t cls = 1; cls < m_classCount; cls++)
+        {
+            uint32_t child = m_transitions[cls];
+            if (child != 0)
+            {
+                pending.push(child);
+            }
+        }
+
+        while (!pending.empty())
+        {
+            uint32_t state = pending.front();
+            pending.pop();
+
+            uint32_t failure = failures[state];
+            m_matches[state] = Lowest(m_matches[state], m_matches[failure]);
+
+            for (uint32_t cls = 1; cls < m_classCount; cls++)
+            {
+                uint32_t& next = m_transitions[state * m_classCount + cls];
+                uint32_t failureNext = m_transitions[failure * m_classCount + cls];
+                if (next != 0)
+                {
+                    failures[next] = failureNext;
+                    pending.push(next);
+                }
+                else
+                {
+                    next = failureNext;
+                }
+            }
+        }
+    }
+
+    // Returns the index of the first rule whose pattern occurs in the 'length' characters at
+    // 'pText', or NoMatch
+    int Match(const wchar_t* pText, size_t length) const
+    {
+        uint32_t state = 0;
+        int result = NoMatch;
+        for (size_t i = 0; i < length && result != 0; i++)
+        {
+            state = m_transitions[state * m_classCount + CharClass(Fold(pText[i]))];
+            result = Lowest(result, m_matches[state]);
+        }
+        return result;
+    }
+
+private:
+    static wchar_t Fold(wchar_t c)
+    {
+        if (c < 128)
+        {
+            return (c >= L'A' && c <= L'Z') ? (wchar_t)(c - L'A' + L'a') : c;
+        }
+        return (wchar_t)towlower(c);
+    }
+
+    static int Lowest(int a, int b)
+    {
+        if (a == NoMatch)
+        {
+            return b;
+        }
+        return (b == NoMatch || a < b) ? a : b;
+    }
+
+    uint32_t CharClass(wchar_t c) const
+    {
+        if (c < 128)
+        {
+            return m_asciiClasses[c];
+        }
+        auto it = m_otherClasses.find(c);
+        return (it == m_otherClasses.end()) ? 0 : it->second;
+    }
+
+    // Character class of each (folded) character
+    std::vector<uint32_t> m_asciiClasses;
+    std::unordered_map<wchar_t, uint32_t> m_otherClasses;
+    uint32_t m_classCount;
+    // The DFA: m_classCount transitions for each state
+    std::vector<uint32_t> m_transitions;
+    // For each state, the first rule whose pattern ends there, or NoMatch
+    std::vector<int> m_matches;
+};
+
+// Parses the text of HelloWorld.rules. Each rule is a line '<pattern>=<annotation>': frames of
+// modules whose name contains <pattern> get a frame showing <annotation> above them. White space
+// around either part is ignored, as are blank lines, lines starting with '#' and lines which
+// aren't a rule. The patterns and annotations of the rules are appended to 'pPatterns' and
+// 'pAnnotations' in the order of the file.
+inline void ParseAnnotationRules(const std::wstring& text, std::vector<std::wstring>* pPatterns, std::vector<std::wstring>* pAnnotations)
+{
+    const wchar_t* WhiteSpace = L" \t\r\n";
+
+    size_t lineStart = 0;
+    while (lineStart < text.size())
+    {
+        size_t lineEnd = text.find(L'\n', lineStart);
+        if (lineEnd == std::wstring::npos)
+        {
+            lineEnd = text.size();
+        }
+        std::wstring line = text.substr(lineStart, lineEnd - lineStart);
+        lineStart = lineEnd + 1;
+
+        size_t first = line.find_first_not_of(WhiteSpace);
+        size_t separator = line.find(L'=');
+        if (first == std::wstring::npos || line[first] == L'#' || separator == std::wstring::npos)
+        {
+            continue;
+        }
+
+        std::wstring pattern = line.substr(0, separator);
+        std::wstring annotation = line.substr(separator + 1);
+        pattern.erase(pattern.find_last_not_of(WhiteSpace) + 1);
+        pattern.erase(0, pattern.find_first_not_of(WhiteSpace));
+        annotation.erase(annotation.find_last_not_of(WhiteSpace) + 1);
+        annotation.erase(0, annotation.find_first_not_of(WhiteSpace));
+        if (pattern.empty() || annotation.empty())
+        {
+            continue;
+        }
+
+        pPatterns->push_back(pattern);
+        pAnnotations->push_back(annotation);
+    }
+}
@@ -30,6 +30,13 @@ HRESULT CHelloWorldDataItem::GetInstance(
     // Assign it to a CComPtr so that it is AddRef'ed
     CComPtr<CHelloWorldDataItem> pCreatedInstance(pComObject);
 
+    // A new data item means a new stack walk of the thread. Without the annotation cache,
+    // every annotation frame is created again.
+    if (SUCCEEDED(CAnnotationFrameCacheDataItem::GetInstance(pContext->Thread(), &pCreatedInstance->m_pAnnotationCache)))
+    {
+        pCreatedInstance->m_pAnnotationCache->BeginWalk();
+    }
+
     // Then associate the new data item with pContext
     hr = pContext->SetDataItem(DkmDataCreationDisposition::CreateNew, pCreatedInstance);
     if (FAILED(hr))
@@ -56,3 +63,61 @@ HRESULT CHelloWorldDataItem::GetExistingInstance(
 {
     return pContext->GetDataItem(ppStateObject);
 }
+
+void CHelloWorldDataItem::TraceThroughput()
+{
+    LARGE_INTEGER endTime;
+    LARGE_INTEGER frequency;
+    QueryPerformanceCounter(&endTime);
+    QueryPerformanceFrequency(&frequency);
+
+    ULONGLONG elapsedUs = (ULONGLONG)(endTime.QuadPart - m_startTime.QuadPart) * 1000000 / (ULONGLONG)frequency.QuadPart;
+    ULONGLONG framesPerSecond = (elapsedUs == 0) ? 0 : (ULONGLONG)m_frameCount * 1000000 / elapsedUs;
+
+    UINT32 walkHits = 0;
+    UINT32 walkMisses = 0;
+    UINT64 totalHits = 0;
+    UINT64 totalMisses = 0;
+    if (m_pAnnotationCache != NULL)
+    {
+        m_pAnnotationCache->GetStatistics(&walkHits, &walkMisses, &totalHits, &totalMisses);
+    }
+
+    ATLTRACE(L"HelloWorld: %u frames in %llu us (%llu frames/s), annotation cache %u hits %u misses (total %llu hits %llu misses)\n",
+        m_frameCount, elapsedUs, framesPerSecond, walkHits, walkMisses, totalHits, totalMisses);
+}
+
+UINT64 CHelloWorldDataItem::GetFrameAddress(DkmStackWalkFrame* pFrame)
+{
+    DkmInstructionAddress* pAddress = pFrame->InstructionAddress();
+    if (pAddress == NULL || pAddress->CPUInstructionPart() == NULL)
+        return 0;
+
+    return pAddress->CPUInstructionPart()->InstructionPointer;
+}
+
+void CHelloWorldDataItem::RecordFrame(DkmStackContext* pStackContext, DkmStackWalkFrame* pFrame)
+{
+    if (m_trace.Buffer().empty())
+    {
+        DkmThread* pThread = pStackContext->Thread();
+        m_trace.BeginWalk(
+            (pThread->SystemPart() != NULL) ? pThread->SystemPart()->Id : 0,
+            (uint32_t)pStackContext->FilterOptions());
+    }
+
+    StackWalkTraceFrame frame;
+    frame.InstructionPointer = GetFrameAddress(pFrame);
+    frame.FrameBase = pFrame->FrameBase();
+    frame.Flags = (uint32_t)pFrame->Flags();
+    m_trace.AddFrame(frame);
+}
+
+const std::vector<uint8_t>& CHelloWorldDataItem::EndRecording()
+{
+    if (!m_trace.Buffer().empty())
+    {
+        m_trace.EndWalk();
+    }
+    return m_trace.Buffer();
+}
@@ -3,19 +3,12 @@
 
 #pragma once
 
-// Defines the two possible states the HelloWorld stack frame filter can be in.
-struct State
-{
-    enum e
-    {
-        // The initial state (state that we start out in). At this point, we
-        // haven't seen any stack frames.
-        Initial,
+#include "AnnotationFrameCacheDataItem.h"
+#include "StackWalkFilter.h"
+#include "StackWalkTrace.h"
 
-        // The state that we are in after we added the '[Hello World]' frame.
-        HelloWorldFrameAdded
-    };
-};
+// Decides what to do with each frame of a walk (see StackWalkFilter.h)
+typedef StackWalkFilter<CComPtr<DkmStackWalkFrame>> FrameFilter;
 
 // CHelloWorldDataItem is an internal COM object used to hold the data which the HelloWorld 
 // component associates with a DkmStackContext. In other words, this is a state-store which
@@ -27,28 +20,67 @@ class ATL_NO_VTABLE __declspec(uuid("0ac2b7f8-b29f-460c-b82d-311fd536624f")) CHe
     public CComObjectRootEx<CComMultiThreadModel>
 {
 private:
-    State::e m_state;
+    // What has been decided for the frames of this walk so far
+    FrameFilter m_filter;
+
+    // The annotation frames which earlier walks of the thread inserted. NULL if the cache
+    // couldn't be created.
+    CComPtr<CAnnotationFrameCacheDataItem> m_pAnnotationCache;
+
+    // Number of frames which went through the filter in this stack walk, and when the walk
+    // started (from QueryPerformanceCounter). This measures how much the filter costs.
+    UINT32 m_frameCount;
+    LARGE_INTEGER m_startTime;
+
+    // The frames of this walk, if walks are being recorded
+    StackWalkTraceEncoder m_trace;
 
 // CHelloWorldDataItem is created through CComObject<CHelloWorldDataItem>::CreateInstance
 protected:
     CHelloWorldDataItem() :
-        m_state(State::Initial)
+        m_frameCount(0)
     {
+        // The data item is created on the first frame of the stack walk
+        QueryPerformanceCounter(&m_startTime);
     }
     ~CHelloWorldDataItem()
     {
     }
 
 public:
-    State::e CurrentState()
+    FrameFilter& Filter()
     {
-        return m_state;
+        return m_filter;
     }
-    void SetState(State::e newValue)
+    CAnnotationFrameCacheDataItem* AnnotationCache()
     {
-        m_state = newValue;
+        return m_pAnnotationCache;
     }
 
+    // Returns the return address of a frame, or 0 for frames without one (ex: annotated frames)
+    static UINT64 GetFrameAddress(DkmStackWalkFrame* pFrame);
+
+    // Adds a frame to the recording of this walk. Called for every frame, before the filter
+    // changes anything, when walks are being recorded. The first frame also records the thread
+    // and the filter options of the walk.
+    void RecordFrame(DkmStackContext* pStackContext, DkmStackWalkFrame* pFrame);
+
+    // Ends the recording of this walk and returns it, in the format of StackWalkTrace.h. Empty
+    // if no frames were recorded.
+    const std::vector<uint8_t>& EndRecording();
+
+    // Called for every frame which goes through the filter
+    void OnFrameFiltered()
+    {
+        m_frameCount++;
+    }
+
+    // Called at the end of the stack walk if HELLOWORLD_TRACE_STATISTICS is set. Traces the
+    // number of frames filtered, how many frames per second went through the filter and how
+    // often annotation frames were reused, ex: 'HelloWorld: 5000 frames in 812 us (6157635
+    // frames/s), annotation cache 12 hits 1 misses (total 120 hits 13 misses)'.
+    void TraceThroughput();
+
     // Returns the instance of CHelloWorldDataItem associated with the input DkmStackContext
     // object. If there is not currently an associated CHelloWorldDataItem, a new data item
     // will be created.
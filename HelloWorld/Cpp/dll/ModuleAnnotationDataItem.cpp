@@ -0,0 +1,40 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#include "StdAfx.h"
+#include "ModuleAnnotationDataItem.h"
+
+int CModuleAnnotationDataItem::GetRule(
+    DkmModuleInstance* pModuleInstance,
+    const AnnotationMatcher& matcher
+    )
+{
+    HRESULT hr;
+
+    // If the module has been matched already, return the stored rule
+    CComPtr<CModuleAnnotationDataItem> pExisting;
+    hr = pModuleInstance->GetDataItem(&pExisting);
+    if (hr == S_OK)
+        return pExisting->m_rule;
+
+    DkmString* pName = pModuleInstance->Name();
+    int rule = matcher.Match(pName->Value(), pName->Length());
+
+    CComObject<CModuleAnnotationDataItem>* pComObject;
+    hr = CComObject<CModuleAnnotationDataItem>::CreateInstance(&pComObject);
+    if (FAILED(hr))
+    {
+        // The rule is still right, it just won't be remembered
+        return rule;
+    }
+
+    CComPtr<CModuleAnnotationDataItem> pCreatedInstance(pComObject);
+    pCreatedInstance->m_rule = rule;
+
+    // Unlike a stack walk, frames of the same module can be filtered on several threads at
+    // once, so another thread may get to set the data item first. It holds the same rule, so
+    // that failure is ignored.
+    pModuleInstance->SetDataItem(DkmDataCreationDisposition::CreateNew, pCreatedInstance);
+
+    return rule;
+}
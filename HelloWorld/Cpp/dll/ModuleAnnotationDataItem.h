@@ -0,0 +1,55 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#pragma once
+
+#include "AnnotationMatcher.h"
+
+// CModuleAnnotationDataItem is an internal COM object which the HelloWorld component
+// associates with a DkmModuleInstance. It remembers which annotation rule applies to the
+// module, so that the rules only need to be matched against the module name once. Since the
+// data item belongs to the module instance, it goes away when the module is unloaded.
+class ATL_NO_VTABLE __declspec(uuid("23cc4d13-f0cf-4193-b5ff-37881e04f20d")) CModuleAnnotationDataItem :
+    public IUnknown,
+    public CComObjectRootEx<CComMultiThreadModel>
+{
+private:
+    // Index of the rule which applies to the module, or AnnotationMatcher::NoMatch
+    int m_rule;
+
+// CModuleAnnotationDataItem is created through CComObject<CModuleAnnotationDataItem>::CreateInstance
+protected:
+    CModuleAnnotationDataItem() :
+        m_rule(AnnotationMatcher::NoMatch)
+    {
+    }
+    ~CModuleAnnotationDataItem()
+    {
+    }
+
+public:
+    // Returns the index of the rule in 'matcher' which applies to the input module instance,
+    // or AnnotationMatcher::NoMatch. The first call for a module matches its name and stores
+    // the result in a data item; later calls just return what was stored.
+    static int GetRule(
+        DkmModuleInstance* pModuleInstance,
+        const AnnotationMatcher& matcher
+        );
+
+protected:
+    HRESULT _InternalQueryInterface(REFIID riid, void **ppvObject)
+    {
+        if (ppvObject == NULL)
+            return E_POINTER;
+
+        if (riid == __uuidof(IUnknown))
+        {
+            *ppvObject = static_cast<IUnknown*>(this);
+            AddRef();
+            return S_OK;
+        }
+
+        *ppvObject = NULL;
+        return E_NOINTERFACE;
+    }
+};
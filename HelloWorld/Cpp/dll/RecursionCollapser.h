@@ -0,0 +1,175 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#pragma once
+
+// This file defines RecursionCollapser, which finds the runs of recursive frames in a stack walk
+// that the HelloWorld filter replaces with a single '[N recursive frames collapsed]' frame. The
+// frames of a walk are given to it in order, with their return address and frame base. TFrame is
+// what the caller holds a frame with (ex: CComPtr<DkmStackWalkFrame>). It only depends on the
+// C++ standard library, so that the replay tool in ..\test runs the same code as the filter.
+
+#include <stdint.h>
+#include <vector>
+
+template <class TFrame>
+class RecursionCollapser
+{
+public:
+    // Recursion is only looked for with periods of at most MaxRecursionPeriod frames, and a
+    // run is only collapsed once it is MinCollapsedFrames frames long. These bound the memory
+    // a stack walk uses, however deep the stack is.
+    enum
+    {
+        MaxRecursionPeriod = 16,
+        MinCollapsedFrames = 64
+    };
+
+    // What a recursive run which ended leaves to show above the frame which ended it (or at the
+    // bottom of the stack): either the number of frames it collapsed and the frame base of the
+    // last of them, or the frames it held back because it was too short to collapse
+    struct Released
+    {
+        uint32_t CollapsedCount;
+        uint64_t CollapsedFrameBase;
+        std::vector<TFrame> Frames;
+
+        Released() :
+            CollapsedCount(0),
+            CollapsedFrameBase(0)
+        {
+        }
+
+        // Returns the number of frames it takes to show this
+        uint32_t GetFrameCount() const
+        {
+            return ((CollapsedCount != 0) ? 1 : 0) + (uint32_t)Frames.size();
+        }
+    };
+
+    RecursionCollapser() :
+        m_recentCount(0),
+        m_runPeriod(0),
+        m_runLength(0),
+        m_runFrameBase(0)
+    {
+    }
+
+    // Called for every frame, in order. 'address' is the frame's return address, or 0 for
+    // frames without one (ex: annotated frames), which are never part of a run. Returns true if
+    // the frame repeats the frames above it and should be hidden for now. Otherwise, TakeReleased
+    // returns what the run that just ended leaves to show above this frame. 'frame' is only
+    // converted to a TFrame if it has to be held.
+    template <class TFramePointer>
+    bool CollapseFrame(uint64_t address, uint64_t frameBase, const TFramePointer& frame)
+    {
+        // A frame which has the same address as the frame 'period' frames above it repeats
+        // them. If there is a run, the frame continues it if it repeats with the run's period.
+        // Otherwise it starts a run with the shortest period it repeats with.
+        uint32_t period = 0;
+        if (address != 0)
+        {
+            uint32_t maxPeriod = (m_recentCount < MaxRecursionPeriod) ? m_recentCount : (uint32_t)MaxRecursionPeriod;
+            for (uint32_t p = (m_runPeriod != 0) ? m_runPeriod : 1; p <= maxPeriod; p++)
+            {
+                if (m_recentAddresses[(m_recentCount - p) % MaxRecursionPeriod] == address)
+                {
+                    period = p;
+                    break;
+                }
+                if (m_runPeriod != 0)
+                {
+                    break;
+                }
+            }
+        }
+
+        m_recentAddresses[m_recentCount % MaxRecursionPeriod] = address;
+        m_recentCount++;
+
+        if (period == 0)
+        {
+            // This frame isn't part of a run, so any run ends above it
+            EndRun();
+            return false;
+        }
+
+        m_runPeriod = period;
+        m_runLength++;
+        m_runFrameBase = frameBase;
+
+        // Once the run is long enough to be collapsed, its frames only need to be counted
+        if (m_runLength < MinCollapsedFrames)
+        {
+            m_heldFrames.push_back(TFrame(frame));
+        }
+        else
+        {
+            m_heldFrames.clear();
+        }
+        return true;
+    }
+
+    // Ends the current run, if there is one, releasing what it holds. Called at the end of the
+    // stack, and by CollapseFrame for a frame which doesn't continue the run.
+    void EndRun()
+    {
+        if (m_runPeriod == 0)
+        {
+            return;
+        }
+
+        if (m_runLength >= MinCollapsedFrames)
+        {
+            m_released.CollapsedCount = m_runLength;
+            m_released.CollapsedFrameBase = m_runFrameBase;
+        }
+        else
+        {
+            // Too short to collapse, so the frames are shown after all
+            m_released.Frames.insert(m_released.Frames.end(), m_heldFrames.begin(), m_heldFrames.end());
+            m_heldFrames.clear();
+        }
+
+        m_runPeriod = 0;
+        m_runLength = 0;
+    }
+
+    // Returns true if a run ended since the last call to TakeReleased. Most frames end no run,
+    // so this lets them skip TakeReleased.
+    bool HasReleased() const
+    {
+        return m_released.CollapsedCount != 0 || !m_released.Frames.empty();
+    }
+
+    // Moves what the last run to end released into 'pReleased', so that it is only returned
+    // once. Leaves 'pReleased' empty if nothing was released since the last call.
+    void TakeReleased(Released* pReleased)
+    {
+        pReleased->CollapsedCount = m_released.CollapsedCount;
+        pReleased->CollapsedFrameBase = m_released.CollapsedFrameBase;
+        pReleased->Frames.clear();
+        pReleased->Frames.swap(m_released.Frames);
+
+        m_released.CollapsedCount = 0;
+        m_released.CollapsedFrameBase = 0;
+    }
+
+private:
+    // Return addresses of the last MaxRecursionPeriod frames, used as a ring buffer.
+    // m_recentCount is the total number of addresses added to it.
+    uint64_t m_recentAddresses[MaxRecursionPeriod];
+    uint32_t m_recentCount;
+
+    // The recursive run which the previous frames are part of. m_runPeriod is the number of
+    // frames in each repetition, or 0 if there is no run. Until the run reaches
+    // MinCollapsedFrames frames, they are held in m_heldFrames in case the run turns out to be
+    // too short to collapse.
+    uint32_t m_runPeriod;
+    uint32_t m_runLength;
+    uint64_t m_runFrameBase;
+    std::vector<TFrame> m_heldFrames;
+
+    // What the run which just ended left to return, until it is taken with TakeReleased
+    Released m_released;
+};
@@ -0,0 +1,138 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#pragma once
+
+// This file defines StackWalkFilter, which decides what the HelloWorld filter does with each frame
+// of a stack walk: whether the frame is hidden in a recursive run, and otherwise which frames go
+// above it ('[Hello World]' on the top frame, what a recursive run which ended released, and the
+// annotation of the rule which applies). CHelloWorldService::FilterNextFrame only turns the
+// decision into DkmStackWalkFrames. TFrame is what the caller holds a frame with (ex:
+// CComPtr<DkmStackWalkFrame>). It only depends on the C++ standard library, so that the replay
+// tool in ..\test runs the same code as the filter.
+
+#include "AnnotationMatcher.h"
+#include "RecursionCollapser.h"
+
+template <class TFrame>
+class StackWalkFilter
+{
+public:
+    typedef typename RecursionCollapser<TFrame>::Released Released;
+
+    // The frames to return above a frame which isn't hidden, besides what GetReleased holds
+    struct Decision
+    {
+        // Set on the top frame of the walk
+        bool AddHelloWorld;
+        // Index of the rule whose annotation goes above the frame, or AnnotationMatcher::NoMatch
+        int AnnotationRule;
+        // Number of frames it takes to show what GetReleased holds
+        uint32_t ReleasedCount;
+
+        // Returns true if the frame is returned unchanged, which is the case for most frames
+        bool PassThrough() const
+        {
+            return !AddHelloWorld && AnnotationRule == AnnotationMatcher::NoMatch && ReleasedCount == 0;
+        }
+    };
+
+    StackWalkFilter() :
+        m_fHelloWorldAdded(false),
+        m_pLastModule(nullptr),
+        m_lastRule(AnnotationMatcher::NoMatch)
+    {
+    }
+
+    // Called for every frame, in order. 'address' is the frame's return address, or 0 for frames
+    // without one (ex: annotated frames). Returns false if the frame repeats the frames above it
+    // and should be hidden for now, which is never the case unless 'collapseRecursion' is set.
+    // Otherwise fills in 'pDecision'.
+    //
+    // 'pModule' identifies the module of the frame, or is null if the frame isn't annotated (ex:
+    // it has no module, or there are no rules), and 'getRule' returns the index of the rule which
+    // applies to that module, or AnnotationMatcher::NoMatch. When several frames in a row have
+    // the same rule (ex: a run of frames in the same module), only the first of them is
+    // annotated.
+    //
+    // Most frames have nothing added above them, and are in the same module as the frame above,
+    // so for them this only checks for recursion: the rule is only looked up when the module
+    // changes, and what a run released is only taken when one ended.
+    template <class TFramePointer, class TGetRule>
+    bool FilterFrame(
+        uint64_t address,
+        uint64_t frameBase,
+        const TFramePointer& frame,
+        const void* pModule,
+        bool collapseRecursion,
+        TGetRule getRule,
+        Decision* pDecision
+        )
+    {
+        if (collapseRecursion && m_recursion.CollapseFrame(address, frameBase, frame))
+        {
+            return false;
+        }
+
+        if (m_recursion.HasReleased())
+        {
+            m_recursion.TakeReleased(&m_released);
+            pDecision->ReleasedCount = m_released.GetFrameCount();
+        }
+        else
+        {
+            pDecision->ReleasedCount = 0;
+        }
+
+        pDecision->AnnotationRule = AnnotationMatcher::NoMatch;
+        if (pModule != m_pLastModule)
+        {
+            int rule = (pModule != nullptr) ? getRule() : (int)AnnotationMatcher::NoMatch;
+            if (rule != m_lastRule)
+            {
+                pDecision->AnnotationRule = rule;
+            }
+            m_pLastModule = pModule;
+            m_lastRule = rule;
+        }
+
+        pDecision->AddHelloWorld = !m_fHelloWorldAdded;
+        return true;
+    }
+
+    // Called once the frames of a decision which isn't a pass through were returned, so that
+    // '[Hello World]' is only added once
+    void OnFramesAdded()
+    {
+        m_fHelloWorldAdded = true;
+    }
+
+    // Called at the end of the stack. If the stack ends in a recursive run, GetReleased then holds
+    // what it released, which goes at the bottom. Returns the number of frames it takes to show it.
+    uint32_t EndWalk()
+    {
+        m_recursion.EndRun();
+        m_recursion.TakeReleased(&m_released);
+        return m_released.GetFrameCount();
+    }
+
+    // What the recursive run which ended above the last frame released (see
+    // RecursionCollapser::Released). Only set if the decision for the frame, or EndWalk, counted
+    // released frames.
+    const Released& GetReleased() const
+    {
+        return m_released;
+    }
+
+private:
+    bool m_fHelloWorldAdded;
+
+    // The module of the previous frame which wasn't hidden, and the annotation rule which
+    // applies to it
+    const void* m_pLastModule;
+    int m_lastRule;
+
+    // Finds the runs of recursive frames in the walk, and holds what the last one released
+    RecursionCollapser<TFrame> m_recursion;
+    Released m_released;
+};
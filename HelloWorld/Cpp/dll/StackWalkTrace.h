@@ -0,0 +1,212 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+#pragma once
+
+// This file defines the format of the stack walk traces which the HelloWorld filter records
+// when HELLOWORLD_STACK_TRACE is set (see CHelloWorldService::FinalConstruct). A trace holds the
+// frames which went into the filter, so that the walks can be replayed without a debuggee. It
+// only depends on the C++ standard library, so that tools which read traces can include it.
+//
+// A trace file is the 4 bytes 'HWST', a 4 byte little endian version (StackWalkTraceVersion),
+// and then one record per walk:
+//   - the system id of the thread which was walked
+//   - the DkmFilterOptionFlags of the walk (since version 2), which change what the filter
+//     does, ex: recursion isn't collapsed with ShowNonUserCode
+//   - for each frame: its flags plus one, then the difference between its return address and
+//     the previous frame's, then the same for its frame base. The first frame of a walk is
+//     compared to 0.
+//   - a 0, which ends the walk
+// All of the numbers in a record are LEB128 varints, and the differences are zigzag encoded.
+// Frames next to each other are close together, which keeps the differences short.
+
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+
+const char StackWalkTraceMagic[4] = { 'H', 'W', 'S', 'T' };
+const uint32_t StackWalkTraceVersion = 2;
+
+// One frame of a recorded walk
+struct StackWalkTraceFrame
+{
+    uint64_t InstructionPointer;
+    uint64_t FrameBase;
+    uint32_t Flags;
+};
+
+// Encodes walks in the trace format into a buffer
+class StackWalkTraceEncoder
+{
+public:
+    StackWalkTraceEncoder()
+    {
+        Clear();
+    }
+
+    // Empties the buffer
+    void Clear()
+    {
+        m_buffer.clear();
+        m_previousInstructionPointer = 0;
+        m_previousFrameBase = 0;
+    }
+
+    // Appends the file header to the buffer
+    void AddHeader()
+    {
+        m_buffer.insert(m_buffer.end(), StackWalkTraceMagic, StackWalkTraceMagic + sizeof(StackWalkTraceMagic));
+        for (int i = 0; i < 4; i++)
+        {
+            m_buffer.push_back((uint8_t)(StackWalkTraceVersion >> (i * 8)));
+        }
+    }
+
+    void BeginWalk(uint32_t threadId, uint32_t filterOptions)
+    {
+        AddVarint(threadId);
+        AddVarint(filterOptions);
+        m_previousInstructionPointer = 0;
+        m_previousFrameBase = 0;
+    }
+
+    void AddFrame(const StackWalkTraceFrame& frame)
+    {
+        AddVarint((uint64_t)frame.Flags + 1);
+        AddVarint(ZigZag(frame.InstructionPointer - m_previousInstructionPointer));
+        AddVarint(ZigZag(frame.FrameBase - m_previousFrameBase));
+        m_previousInstructionPointer = frame.InstructionPointer;
+        m_previousFrameBase = frame.FrameBase;
+    }
+
+    void EndWalk()
+    {
+        AddVarint(0);
+    }
+
+    const std::vector<uint8_t>& Buffer() const
+    {
+        return m_buffer;
+    }
+
+private:
+    static uint64_t ZigZag(uint64_t difference)
+    {
+        return (difference << 1) ^ (uint64_t)((int64_t)difference >> 63);
+    }
+
+    void AddVarint(uint64_t value)
+    {
+        while (value >= 0x80)
+        {
+            m_buffer.push_back((uint8_t)(value | 0x80));
+            value >>= 7;
+        }
+        m_buffer.push_back((uint8_t)value);
+    }
+
+    std::vector<uint8_t> m_buffer;
+    uint64_t m_previousInstructionPointer;
+    uint64_t m_previousFrameBase;
+};
+
+// Reads the walks of a trace recorded by StackWalkTraceEncoder
+class StackWalkTraceDecoder
+{
+public:
+    StackWalkTraceDecoder(const uint8_t* pData, size_t size) :
+        m_pData(pData),
+        m_size(size),
+        m_offset(0),
+        m_version(0)
+    {
+    }
+
+    // Checks the file header. Returns false if this isn't a trace of a version this can read.
+    // Traces of version 1 are read with filter options of 0.
+    bool ReadHeader()
+    {
+        if (m_size < 8 || memcmp(m_pData, StackWalkTraceMagic, sizeof(StackWalkTraceMagic)) != 0)
+        {
+            return false;
+        }
+
+        uint32_t version = 0;
+        for (int i = 0; i < 4; i++)
+        {
+            version |= (uint32_t)m_pData[4 + i] << (i * 8);
+        }
+        m_offset = 8;
+        m_version = version;
+        return version >= 1 && version <= StackWalkTraceVersion;
+    }
+
+    // Reads the next walk into '*pThreadId', '*pFilterOptions' and 'pFrames'. Returns false at
+    // the end of the trace, or if the rest of it is truncated or corrupt.
+    bool ReadWalk(uint32_t* pThreadId, uint32_t* pFilterOptions, std::vector<StackWalkTraceFrame>* pFrames)
+    {
+        pFrames->clear();
+
+        uint64_t threadId;
+        uint64_t filterOptions = 0;
+        if (!ReadVarint(&threadId) || (m_version >= 2 && !ReadVarint(&filterOptions)))
+        {
+            return false;
+        }
+        *pThreadId = (uint32_t)threadId;
+        *pFilterOptions = (uint32_t)filterOptions;
+
+        StackWalkTraceFrame frame = {};
+        for (;;)
+        {
+            uint64_t flags;
+            if (!ReadVarint(&flags))
+            {
+                return false;
+            }
+            if (flags == 0)
+            {
+                return true;
+            }
+
+            uint64_t instructionPointerDifference;
+            uint64_t frameBaseDifference;
+            if (!ReadVarint(&instructionPointerDifference) || !ReadVarint(&frameBaseDifference))
+            {
+                return false;
+            }
+
+            frame.Flags = (uint32_t)(flags - 1);
+            frame.InstructionPointer += UnZigZag(instructionPointerDifference);
+            frame.FrameBase += UnZigZag(frameBaseDifference);
+            pFrames->push_back(frame);
+        }
+    }
+
+private:
+    static uint64_t UnZigZag(uint64_t value)
+    {
+        return (value >> 1) ^ (0 - (value & 1));
+    }
+
+    bool ReadVarint(uint64_t* pValue)
+    {
+        uint64_t value = 0;
+        for (int shift = 0; shift < 64 && m_offset < m_size; shift += 7)
+        {
+            uint8_t b = m_pData[m_offset++];
+            value |= (uint64_t)(b & 0x7f) << shift;
+            if ((b & 0x80) == 0)
+            {
+                *pValue = value;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    const uint8_t* m_pData;
+    size_t m_size;
+    size_t m_offset;
+    uint32_t m_version;
+};
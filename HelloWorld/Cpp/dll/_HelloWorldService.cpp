@@ -6,82 +6,265 @@
 #include "stdafx.h"
 #include "_HelloWorldService.h"
 #include "HelloWorldDataItem.h"
+#include "ModuleAnnotationDataItem.h"
 
-HRESULT STDMETHODCALLTYPE CHelloWorldService::FilterNextFrame(
-    DkmStackContext* pStackContext,
-    DkmStackWalkFrame* pInput,
-    DkmArray<DkmStackWalkFrame*>* pResult
-    )
+// HelloWorld.rules is at most this big
+static const ULONGLONG MaxRulesFileSize = 1024 * 1024;
+
+// Opens the stack walk trace file, and loads the annotation rules from HelloWorld.rules, which
+// is deployed next to HelloWorld.dll. If the rules file is missing or can't be read, there are
+// no rules and only '[Hello World]' is added.
+HRESULT CHelloWorldService::FinalConstruct()
 {
     HRESULT hr;
 
-    // The HelloWorld sample is a very simple debugger component which modified the call stack
-    // so that there is a '[Hello World]' frame at the top of the call stack. All the frames
-    // below this are left the same.
+    // If HELLOWORLD_STACK_TRACE is set to a file path, every walk is recorded to that file.
+    // The trace can then be used to measure the filter without a debuggee.
+    WCHAR path[MAX_PATH];
+    DWORD pathLength = GetEnvironmentVariableW(L"HELLOWORLD_STACK_TRACE", path, _countof(path));
+    if (pathLength != 0 && pathLength < _countof(path) &&
+        SUCCEEDED(m_traceFile.Create(path, GENERIC_WRITE, FILE_SHARE_READ, CREATE_ALWAYS)))
+    {
+        StackWalkTraceEncoder header;
+        header.AddHeader();
+        m_fRecording = SUCCEEDED(m_traceFile.Write(header.Buffer().data(), (DWORD)header.Buffer().size()));
+        ATLTRACE(L"HelloWorld: recording stack walks to %s\n", path);
+    }
+
+    // If HELLOWORLD_TRACE_STATISTICS is set, how fast each walk went through the filter is traced
+    // at the end of the walk
+    m_fTraceStatistics = (GetEnvironmentVariableW(L"HELLOWORLD_TRACE_STATISTICS", NULL, 0) != 0);
 
-    if (pInput == NULL) // NULL input frame indicates the end of the call stack. This sample does nothing on end-of-stack.
-        return S_OK; 
-    
-    // Get the CHelloWorldDataItem which is associated with this stack walk. This
-    // lets us keep data associated with this stack walk.
-    CComPtr<CHelloWorldDataItem> pDataItem;
-    hr = CHelloWorldDataItem::GetInstance(pStackContext, &pDataItem);
+    pathLength = GetModuleFileNameW(_AtlBaseModule.GetModuleInstance(), path, _countof(path));
+    WCHAR* pFileName = (pathLength != 0 && pathLength < _countof(path)) ? wcsrchr(path, L'\\') : NULL;
+    if (pFileName == NULL || wcscpy_s(pFileName + 1, _countof(path) - (pFileName + 1 - path), L"HelloWorld.rules") != 0)
+    {
+        return S_OK;
+    }
+
+    CAtlFile file;
+    hr = file.Create(path, GENERIC_READ, FILE_SHARE_READ, OPEN_EXISTING);
     if (FAILED(hr))
-        return hr;
+    {
+        return S_OK;
+    }
 
-    // Now use this data item to see if we are looking at the first (top-most) frame
-    if (pDataItem->CurrentState() == State::Initial)
+    ULONGLONG fileSize;
+    hr = file.GetSize(fileSize);
+    if (FAILED(hr) || fileSize == 0 || fileSize > MaxRulesFileSize)
     {
-        // On the top most frame, we want to return back two different frames. First 
-        // we place the '[Hello World]' frame, and under that we put the input frame.
+        ATLTRACE(L"HelloWorld: ignoring %s\n", path);
+        return S_OK;
+    }
 
-        // Allocate an array with two elements. Store it in a CAutoDkmArray so that
-        // if anything fails, the memory will be automatically freed.
-        CAutoDkmArray<DkmStackWalkFrame*> result;
-        hr = DkmAllocArray(2, &result);
+    std::vector<char> bytes((size_t)fileSize);
+    hr = file.Read(bytes.data(), (DWORD)fileSize);
+    if (FAILED(hr))
+    {
+        ATLTRACE(L"HelloWorld: failed to read %s\n", path);
+        return S_OK;
+    }
+
+    // The file is UTF-8, possibly with a byte order mark
+    int offset = (fileSize >= 3 && memcmp(bytes.data(), "\xEF\xBB\xBF", 3) == 0) ? 3 : 0;
+    int textLength = MultiByteToWideChar(CP_UTF8, 0, bytes.data() + offset, (int)fileSize - offset, NULL, 0);
+    std::wstring text(textLength, L'\0');
+    MultiByteToWideChar(CP_UTF8, 0, bytes.data() + offset, (int)fileSize - offset, &text[0], textLength);
+
+    std::vector<std::wstring> patterns;
+    std::vector<std::wstring> annotations;
+    ParseAnnotationRules(text, &patterns, &annotations);
+
+    // The annotation strings are created once here and shared by all of the frames which show
+    // them.
+    for (const std::wstring& annotation : annotations)
+    {
+        CComPtr<DkmString> pAnnotation;
+        hr = DkmString::Create(annotation.c_str(), &pAnnotation);
         if (FAILED(hr))
         {
             return hr;
         }
+        m_annotations.Add(pAnnotation);
+    }
+    m_matcher.Build(patterns);
+
+    ATLTRACE(L"HelloWorld: loaded %u annotation rules from %s\n", (UINT32)m_annotations.GetCount(), path);
+    return S_OK;
+}
+
+// Creates an annotated frame which shows 'pDescription', to be placed above the frame whose
+// frame base is 'frameBase'
+static HRESULT CreateAnnotationFrame(
+    DkmStackContext* pStackContext,
+    UINT64 frameBase,
+    DkmString* pDescription,
+    DkmStackWalkFrame** ppFrame
+    )
+{
+    return DkmStackWalkFrame::Create(
+        pStackContext->Thread(),
+        NULL,                           // Annotated frame, so no instruction address
+        frameBase,                      // Use the same frame base as the frame below
+        0,                              // annoted frame uses zero bytes
+        DkmStackWalkFrameFlags::None,
+        pDescription,
+        NULL,                           // Annotated frame, so no registers
+        NULL,
+        ppFrame
+        );
+}
+
+// Adds what a recursive run released to 'pResult', starting at '*pNext': either a
+// '[N recursive frames collapsed]' frame, or the frames the run held back
+static HRESULT AddReleasedFrames(
+    DkmStackContext* pStackContext,
+    const FrameFilter::Released& released,
+    DkmArray<DkmStackWalkFrame*>* pResult,
+    UINT32* pNext
+    )
+{
+    HRESULT hr;
+
+    if (released.CollapsedCount != 0)
+    {
+        WCHAR text[64];
+        swprintf_s(text, L"[%u recursive frames collapsed]", released.CollapsedCount);
 
-        // Create a string object for 'hello world'
         CComPtr<DkmString> pDescription;
-        hr = DkmString::Create(L"[Hello World]", &pDescription);
+        hr = DkmString::Create(text, &pDescription);
         if (FAILED(hr))
         {
             return hr;
         }
 
-        // Create the hello world frame object, and stick it in the array
-        hr = DkmStackWalkFrame::Create(
-            pStackContext->Thread(),
-            NULL,                           // Annotated frame, so no instruction address
-            pInput->FrameBase(),            // Use the same frame base as the input frame
-            0,                              // annoted frame uses zero bytes
-            DkmStackWalkFrameFlags::None,
-            pDescription,
-            NULL,                           // Annotated frame, so no registers
-            NULL,
-            &result.Members[0]
-            );
+        hr = CreateAnnotationFrame(pStackContext, released.CollapsedFrameBase, pDescription, &pResult->Members[(*pNext)++]);
         if (FAILED(hr))
         {
             return hr;
         }
+    }
 
-        // Add the input frame into the array as well
-        result.Members[1] = pInput;
-        result.Members[1]->AddRef();
+    for (size_t i = 0; i < released.Frames.size(); i++)
+    {
+        pResult->Members[*pNext] = released.Frames[i];
+        pResult->Members[(*pNext)++]->AddRef();
+    }
+
+    return S_OK;
+}
+
+HRESULT STDMETHODCALLTYPE CHelloWorldService::FilterNextFrame(
+    DkmStackContext* pStackContext,
+    DkmStackWalkFrame* pInput,
+    DkmArray<DkmStackWalkFrame*>* pResult
+    )
+{
+    HRESULT hr;
+
+    // The HelloWorld sample is a simple debugger component which modifies the call stack so
+    // that there is a '[Hello World]' frame at the top of the call stack. It also inserts an
+    // annotation above frames whose module matches one of the rules in HelloWorld.rules, and
+    // replaces long runs of recursive frames with a single '[N recursive frames collapsed]'
+    // frame. All other frames are left the same.
+
+    if (pInput == NULL) // NULL input frame indicates the end of the call stack.
+    {
+        // There is no data item if the stack was empty
+        CComPtr<CHelloWorldDataItem> pDataItem;
+        if (CHelloWorldDataItem::GetExistingInstance(pStackContext, &pDataItem) != S_OK)
+        {
+            return S_OK;
+        }
+
+        // Report how fast the frames of this stack walk went through the filter
+        if (m_fTraceStatistics)
+        {
+            pDataItem->TraceThroughput();
+        }
+
+        if (m_fRecording)
+        {
+            const std::vector<uint8_t>& trace = pDataItem->EndRecording();
+            if (!trace.empty())
+            {
+                CComCritSecLock<CComAutoCriticalSection> lock(m_traceLock);
+                m_traceFile.Write(trace.data(), (DWORD)trace.size());
+            }
+        }
+
+        // If the stack ends in a recursive run, the frames it released go at the bottom. What
+        // runs which ended earlier released was returned with the frame which ended them.
+        FrameFilter& filter = pDataItem->Filter();
+        UINT32 releasedCount = filter.EndWalk();
+        if (releasedCount == 0)
+        {
+            return S_OK;
+        }
+
+        CAutoDkmArray<DkmStackWalkFrame*> result;
+        hr = DkmAllocArray(releasedCount, &result);
+        if (FAILED(hr))
+        {
+            return hr;
+        }
+
+        UINT32 next = 0;
+        hr = AddReleasedFrames(pStackContext, filter.GetReleased(), &result, &next);
+        if (FAILED(hr))
+        {
+            return hr;
+        }
 
-        // Array succesfully created, so return the value in the out param, and update our
-        // state so that on the next frame we know not to add '[Hello World]' again.
         *pResult = result.Detach();
-        pDataItem->SetState(State::HelloWorldFrameAdded);
+        return S_OK;
     }
-    else
+
+    // Get the CHelloWorldDataItem which is associated with this stack walk. This
+    // lets us keep data associated with this stack walk.
+    CComPtr<CHelloWorldDataItem> pDataItem;
+    hr = CHelloWorldDataItem::GetInstance(pStackContext, &pDataItem);
+    if (FAILED(hr))
+        return hr;
+
+    pDataItem->OnFrameFiltered();
+
+    if (m_fRecording)
+    {
+        pDataItem->RecordFrame(pStackContext, pInput);
+    }
+
+    // Decide what goes above the frame. Frames which repeat the frames above them are hidden,
+    // and returning no frames removes the input frame from the call stack. When 'Show External
+    // Code' is on, recursion isn't collapsed, which is how the hidden frames can be seen.
+    //
+    // Annotated frames from other components have no instruction address, and code which isn't
+    // in a module (ex: JIT'ed code) has no module instance. Neither of them gets annotated. The
+    // module's data item remembers which rule applies to it, and it is only asked for when the
+    // module changes from one frame to the next.
+    DkmInstructionAddress* pAddress = pInput->InstructionAddress();
+    DkmModuleInstance* pModuleInstance = (pAddress != NULL && !m_annotations.IsEmpty()) ? pAddress->ModuleInstance() : NULL;
+    FrameFilter& filter = pDataItem->Filter();
+    FrameFilter::Decision decision;
+    bool collapseRecursion = ((pStackContext->FilterOptions() & DkmFilterOptionFlags::ShowNonUserCode) == 0);
+    if (!filter.FilterFrame(
+        CHelloWorldDataItem::GetFrameAddress(pInput),
+        pInput->FrameBase(),
+        pInput,
+        pModuleInstance,
+        collapseRecursion,
+        [this, pModuleInstance]() { return CModuleAnnotationDataItem::GetRule(pModuleInstance, m_matcher); },
+        &decision))
+    {
+        return S_OK;
+    }
+
+    // Most frames get nothing added above them, so that case is kept as short as possible
+    if (decision.PassThrough())
     {
-        // We have already added '[Hello World]' to this call stack, so just return
-        // the input frame.
+        // Just return the input frame. The dispatcher takes ownership of the result array
+        // and frees it, so it can't be reused from one frame to the next; a one element
+        // array is the cheapest way to leave a frame unchanged.
 
         hr = DkmAllocArray(1, pResult);
         if (FAILED(hr))
@@ -92,6 +275,88 @@ HRESULT STDMETHODCALLTYPE CHelloWorldService::FilterNextFrame(
         pResult->Members[0] = pInput;
         pResult->Members[0]->AddRef();
     }
+    else
+    {
+        // Otherwise we return back several frames. On the top most frame, we first place
+        // the '[Hello World]' frame. Then what a recursive run which ended above this frame
+        // released, then the annotation of the rule which applies, and under that we put the
+        // input frame.
+
+        // Allocate an array with room for all of them. Store it in a CAutoDkmArray so that
+        // if anything fails, the memory will be automatically freed.
+        bool addAnnotation = (decision.AnnotationRule != AnnotationMatcher::NoMatch);
+        UINT32 count = 1 + (decision.AddHelloWorld ? 1 : 0) + decision.ReleasedCount + (addAnnotation ? 1 : 0);
+        CAutoDkmArray<DkmStackWalkFrame*> result;
+        hr = DkmAllocArray(count, &result);
+        if (FAILED(hr))
+        {
+            return hr;
+        }
+
+        UINT32 next = 0;
+        if (decision.AddHelloWorld)
+        {
+            // Create a string object for 'hello world'
+            CComPtr<DkmString> pDescription;
+            hr = DkmString::Create(L"[Hello World]", &pDescription);
+            if (FAILED(hr))
+            {
+                return hr;
+            }
+
+            // Create the hello world frame object, and stick it in the array
+            hr = CreateAnnotationFrame(pStackContext, pInput->FrameBase(), pDescription, &result.Members[next++]);
+            if (FAILED(hr))
+            {
+                return hr;
+            }
+        }
+
+        if (decision.ReleasedCount != 0)
+        {
+            hr = AddReleasedFrames(pStackContext, filter.GetReleased(), &result, &next);
+            if (FAILED(hr))
+            {
+                return hr;
+            }
+        }
+
+        if (addAnnotation)
+        {
+            // An annotated frame only depends on the thread, the frame base and the text, so
+            // if the previous walk of this thread created it, the same object is returned
+            CAnnotationFrameCacheDataItem* pAnnotationCache = pDataItem->AnnotationCache();
+            CComPtr<DkmStackWalkFrame> pAnnotationFrame;
+            if (pAnnotationCache != NULL)
+            {
+                pAnnotationFrame = pAnnotationCache->Lookup(pInput->FrameBase(), decision.AnnotationRule);
+            }
+            if (pAnnotationFrame == NULL)
+            {
+                hr = CreateAnnotationFrame(pStackContext, pInput->FrameBase(), m_annotations[decision.AnnotationRule], &pAnnotationFrame);
+                if (FAILED(hr))
+                {
+                    return hr;
+                }
+
+                if (pAnnotationCache != NULL)
+                {
+                    pAnnotationCache->Add(pInput->FrameBase(), decision.AnnotationRule, pAnnotationFrame);
+                }
+            }
+
+            result.Members[next++] = pAnnotationFrame.Detach();
+        }
+
+        // Add the input frame into the array as well
+        result.Members[next] = pInput;
+        result.Members[next]->AddRef();
+
+        // Array succesfully created, so return the value in the out param, and update our
+        // state so that on the next frame we know not to add '[Hello World]' again.
+        *pResult = result.Detach();
+        filter.OnFramesAdded();
+    }
 
     return S_OK;
 }
\ No newline at end of file
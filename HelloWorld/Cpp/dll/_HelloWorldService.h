@@ -7,6 +7,8 @@
 // COM object exported from the sample dll.
 
 #include "HelloWorld.Contract.h"
+#include "AnnotationMatcher.h"
+#include "StackWalkTrace.h"
 
 class ATL_NO_VTABLE CHelloWorldService :
     // Inherit from CHelloWorldServiceContract to provide the list of interfaces that
@@ -21,8 +23,25 @@ class ATL_NO_VTABLE CHelloWorldService :
     // DllGetClassObject
     public CComCoClass<CHelloWorldService, &CHelloWorldServiceContract::ClassId>
 {
+private:
+    // The annotation rules from HelloWorld.rules. m_matcher finds the rule for a module name,
+    // and m_annotations holds the text of the frame to insert for each rule.
+    AnnotationMatcher m_matcher;
+    CAtlArray<CComPtr<DkmString>> m_annotations;
+
+    // The file which walks are recorded to (see StackWalkTrace.h), if HELLOWORLD_STACK_TRACE is
+    // set. Walks of different threads end at the same time, so writes to it are locked.
+    CAtlFile m_traceFile;
+    bool m_fRecording;
+    CComAutoCriticalSection m_traceLock;
+
+    // Set if HELLOWORLD_TRACE_STATISTICS is set, to trace the throughput of every walk
+    bool m_fTraceStatistics;
+
 protected:
-    CHelloWorldService()
+    CHelloWorldService() :
+        m_fRecording(false),
+        m_fTraceStatistics(false)
     {
     }
     ~CHelloWorldService()
@@ -33,6 +52,10 @@ public:
     DECLARE_NO_REGISTRY();
     DECLARE_NOT_AGGREGATABLE(CHelloWorldService);
 
+    // Called by ATL after the object is created. Opens the trace file and loads the annotation
+    // rules.
+    HRESULT FinalConstruct();
+
 // IDkmCallStackFilter methods
 // For documentation of this interface, open <Visual Studio Install Directory>\VSSDK\VisualStudioIntegration\Common\inc\vsdebugeng.h
 // Then search for "IDkmCallStackFilter"
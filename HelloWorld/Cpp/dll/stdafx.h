@@ -22,6 +22,8 @@
 #include <atlbase.h>
 #include <atlcom.h>
 #include <atlctl.h>
+#include <atlcoll.h>
+#include <atlfile.h>
 
 #include <vsdebugeng.h>
 #include <vsdebugeng.templates.h>
@@ -0,0 +1,288 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+// Tests the parts of the HelloWorld filter which only depend on the C++ standard library: the
+// annotation rules, the stack walk trace format, the recursion collapser, the per-frame decisions
+// and the annotation frame cache. Frames are stood in for by ints.
+
+#include "TestCheck.h"
+#include "AnnotationMatcher.h"
+#include "AnnotationFrameCache.h"
+#include "RecursionCollapser.h"
+#include "StackWalkFilter.h"
+#include "StackWalkTrace.h"
+
+namespace
+{
+    void TestAnnotationRules()
+    {
+        std::vector<std::wstring> patterns;
+        std::vector<std::wstring> annotations;
+        ParseAnnotationRules(L"# comment\r\n ntdll.dll = [Windows] \r\n\r\nnot a rule\nKernel=[Kernel]", &patterns, &annotations);
+        CHECK(patterns.size() == 2 && annotations.size() == 2);
+        CHECK(patterns[0] == L"ntdll.dll" && annotations[0] == L"[Windows]");
+        CHECK(patterns[1] == L"Kernel" && annotations[1] == L"[Kernel]");
+
+        AnnotationMatcher matcher;
+        matcher.Build(patterns);
+        std::wstring ntdll(L"C:\\Windows\\System32\\NTDLL.DLL");
+        std::wstring kernelBase(L"KernelBase.dll");
+        std::wstring app(L"app.exe");
+        CHECK(matcher.Match(ntdll.c_str(), ntdll.size()) == 0);
+        CHECK(matcher.Match(kernelBase.c_str(), kernelBase.size()) == 1);
+        CHECK(matcher.Match(app.c_str(), app.size()) == AnnotationMatcher::NoMatch);
+    }
+
+    void TestTraceRoundTrip()
+    {
+        const StackWalkTraceFrame frames[3] =
+        {
+            { 0x7ff612341000ull, 0x000000e8f5aff000ull, 0 },
+            { 0x7ffa00002000ull, 0x000000e8f5aff100ull, 4 },
+            { 0x7ff612340800ull, 0x000000e8f5aff080ull, 0 },
+        };
+
+        StackWalkTraceEncoder encoder;
+        encoder.AddHeader();
+        encoder.BeginWalk(1234, 1);
+        for (const StackWalkTraceFrame& frame : frames)
+        {
+            encoder.AddFrame(frame);
+        }
+        encoder.EndWalk();
+        encoder.BeginWalk(5678, 0);
+        encoder.AddFrame(frames[2]);
+        encoder.EndWalk();
+        std::vector<uint8_t> trace(encoder.Buffer());
+
+        StackWalkTraceDecoder decoder(trace.data(), trace.size());
+        CHECK(decoder.ReadHeader());
+
+        uint32_t threadId = 0;
+        uint32_t filterOptions = 0;
+        std::vector<StackWalkTraceFrame> decoded;
+        CHECK(decoder.ReadWalk(&threadId, &filterOptions, &decoded));
+        CHECK(threadId == 1234 && filterOptions == 1 && decoded.size() == 3);
+        for (size_t i = 0; i < decoded.size() && i < 3; i++)
+        {
+            CHECK(decoded[i].InstructionPointer == frames[i].InstructionPointer);
+            CHECK(decoded[i].FrameBase == frames[i].FrameBase);
+            CHECK(decoded[i].Flags == frames[i].Flags);
+        }
+
+        // Each walk starts from 0 again
+        CHECK(decoder.ReadWalk(&threadId, &filterOptions, &decoded));
+        CHECK(threadId == 5678 && filterOptions == 0 && decoded.size() == 1);
+        CHECK(decoded.size() == 1 && decoded[0].InstructionPointer == frames[2].InstructionPointer && decoded[0].FrameBase == frames[2].FrameBase);
+        CHECK(!decoder.ReadWalk(&threadId, &filterOptions, &decoded));
+
+        // A truncated walk isn't returned
+        StackWalkTraceDecoder truncated(trace.data(), trace.size() - 1);
+        CHECK(truncated.ReadHeader());
+        CHECK(truncated.ReadWalk(&threadId, &filterOptions, &decoded));
+        CHECK(!truncated.ReadWalk(&threadId, &filterOptions, &decoded));
+    }
+
+    void TestTraceVersions()
+    {
+        // A version 1 walk of thread 5 with one frame at 0x10, frame base 0x100. It has no
+        // filter options.
+        const uint8_t version1[] = { 'H', 'W', 'S', 'T', 1, 0, 0, 0, 5, 1, 0x20, 0x80, 0x04, 0 };
+        StackWalkTraceDecoder decoder(version1, sizeof(version1));
+        CHECK(decoder.ReadHeader());
+
+        uint32_t threadId = 0;
+        uint32_t filterOptions = 1;
+        std::vector<StackWalkTraceFrame> frames;
+        CHECK(decoder.ReadWalk(&threadId, &filterOptions, &frames));
+        CHECK(threadId == 5 && filterOptions == 0);
+        CHECK(frames.size() == 1 && frames[0].InstructionPointer == 0x10 && frames[0].FrameBase == 0x100 && frames[0].Flags == 0);
+
+        const uint8_t version3[] = { 'H', 'W', 'S', 'T', 3, 0, 0, 0 };
+        StackWalkTraceDecoder future(version3, sizeof(version3));
+        CHECK(!future.ReadHeader());
+
+        const uint8_t notATrace[] = { 'M', 'Z', 0, 0, 2, 0, 0, 0 };
+        StackWalkTraceDecoder other(notATrace, sizeof(notATrace));
+        CHECK(!other.ReadHeader());
+    }
+
+    typedef RecursionCollapser<int> Collapser;
+
+    // Runs the frames of a stack with the given return addresses through 'pCollapser'. Frame i
+    // is i, with frame base 0x1000 + i * 0x10. Returns the frames which weren't hidden.
+    std::vector<int> CollapseFrames(Collapser* pCollapser, const std::vector<uint64_t>& addresses)
+    {
+        std::vector<int> shown;
+        for (size_t i = 0; i < addresses.size(); i++)
+        {
+            if (!pCollapser->CollapseFrame(addresses[i], 0x1000 + i * 0x10, (int)i))
+            {
+                shown.push_back((int)i);
+            }
+        }
+        return shown;
+    }
+
+    void TestRecursionCollapser()
+    {
+        // Two frames, a run of 100 frames repeating two addresses, and a frame which ends it
+        std::vector<uint64_t> addresses = { 0x10, 0x20 };
+        for (int i = 0; i < 100; i++)
+        {
+            addresses.push_back((i % 2 == 0) ? 0x10 : 0x20);
+        }
+        addresses.push_back(0x30);
+
+        Collapser collapser;
+        std::vector<int> shown = CollapseFrames(&collapser, addresses);
+        CHECK(shown.size() == 3 && shown[0] == 0 && shown[1] == 1 && shown[2] == 102);
+
+        Collapser::Released released;
+        CHECK(collapser.HasReleased());
+        collapser.TakeReleased(&released);
+        CHECK(!collapser.HasReleased());
+        CHECK(released.CollapsedCount == 100);
+        CHECK(released.CollapsedFrameBase == 0x1000 + 101 * 0x10);
+        CHECK(released.Frames.empty() && released.GetFrameCount() == 1);
+
+        // What was released is only returned once
+        collapser.TakeReleased(&released);
+        CHECK(released.GetFrameCount() == 0);
+        collapser.EndRun();
+        collapser.TakeReleased(&released);
+        CHECK(released.GetFrameCount() == 0);
+
+        // A run which is too short to collapse gives its frames back
+        Collapser shortRun;
+        shown = CollapseFrames(&shortRun, { 0x10, 0x10, 0x10, 0x30 });
+        CHECK(shown.size() == 2 && shown[0] == 0 && shown[1] == 3);
+        CHECK(shortRun.HasReleased());
+        shortRun.TakeReleased(&released);
+        CHECK(released.CollapsedCount == 0 && released.Frames.size() == 2);
+        CHECK(released.Frames.size() == 2 && released.Frames[0] == 1 && released.Frames[1] == 2);
+        shortRun.TakeReleased(&released);
+        CHECK(released.GetFrameCount() == 0);
+
+        // A run at the bottom of the stack is released by EndRun
+        Collapser bottomRun;
+        std::vector<uint64_t> recursive(Collapser::MinCollapsedFrames + 1, 0x40);
+        shown = CollapseFrames(&bottomRun, recursive);
+        CHECK(shown.size() == 1);
+        bottomRun.TakeReleased(&released);
+        CHECK(released.GetFrameCount() == 0);
+        bottomRun.EndRun();
+        bottomRun.TakeReleased(&released);
+        CHECK(released.CollapsedCount == Collapser::MinCollapsedFrames && released.Frames.empty());
+
+        // Frames without a return address are never part of a run
+        Collapser annotated;
+        shown = CollapseFrames(&annotated, { 0, 0, 0 });
+        CHECK(shown.size() == 3);
+    }
+
+    void TestStackWalkFilter()
+    {
+        typedef StackWalkFilter<int> Filter;
+        Filter filter;
+        Filter::Decision decision;
+
+        // Stand-ins for modules, of which only the address matters. The rule of a module is only
+        // asked for when it differs from the module of the frame above.
+        const char app = 0;
+        const char ucrt = 0;
+        int getRuleCalls = 0;
+        auto appRule = [&getRuleCalls]() { getRuleCalls++; return 1; };
+        auto ucrtRule = [&getRuleCalls]() { getRuleCalls++; return (int)AnnotationMatcher::NoMatch; };
+
+        // '[Hello World]' goes above the top frame, and an annotation above the first of a run
+        // of frames with the same rule
+        CHECK(filter.FilterFrame(0x10, 0x1000, 0, &app, true, appRule, &decision));
+        CHECK(decision.AddHelloWorld && decision.AnnotationRule == 1 && decision.ReleasedCount == 0);
+        CHECK(!decision.PassThrough());
+        filter.OnFramesAdded();
+        CHECK(filter.FilterFrame(0x20, 0x1010, 1, &app, true, appRule, &decision));
+        CHECK(decision.PassThrough());
+        CHECK(getRuleCalls == 1);
+        CHECK(filter.FilterFrame(0x30, 0x1020, 2, &ucrt, true, ucrtRule, &decision));
+        CHECK(decision.PassThrough());
+        CHECK(filter.FilterFrame(0x40, 0x1030, 3, &app, true, appRule, &decision));
+        CHECK(!decision.AddHelloWorld && decision.AnnotationRule == 1);
+        CHECK(getRuleCalls == 3);
+
+        // Frames without a module have no rule
+        CHECK(filter.FilterFrame(0, 0x1038, 6, nullptr, true, appRule, &decision));
+        CHECK(decision.PassThrough() && getRuleCalls == 3);
+        CHECK(filter.FilterFrame(0x70, 0x1039, 7, &app, true, appRule, &decision));
+        CHECK(decision.AnnotationRule == 1);
+
+        // A recursive run is hidden, and the frame which ends it gets what the run released.
+        // The frames after that get nothing.
+        CHECK(filter.FilterFrame(0x70, 0x1040, 4, &app, true, appRule, &decision) == false);
+        CHECK(filter.FilterFrame(0x50, 0x1050, 5, &app, true, appRule, &decision));
+        CHECK(decision.ReleasedCount == 1 && filter.GetReleased().Frames.size() == 1 && filter.GetReleased().Frames[0] == 4);
+        CHECK(decision.AnnotationRule == AnnotationMatcher::NoMatch);
+        CHECK(filter.FilterFrame(0x60, 0x1060, 6, &app, true, appRule, &decision));
+        CHECK(decision.PassThrough());
+
+        // Unless recursion isn't collapsed
+        Filter showAll;
+        CHECK(showAll.FilterFrame(0x40, 0x1000, 0, nullptr, false, appRule, &decision));
+        CHECK(showAll.FilterFrame(0x40, 0x1010, 1, nullptr, false, appRule, &decision));
+        CHECK(decision.AddHelloWorld && decision.ReleasedCount == 0);
+
+        // A run at the bottom of the stack is released at the end of the walk
+        Filter bottomRun;
+        CHECK(bottomRun.FilterFrame(0x40, 0x1000, 0, nullptr, true, appRule, &decision));
+        CHECK(!bottomRun.FilterFrame(0x40, 0x1010, 1, nullptr, true, appRule, &decision));
+        CHECK(bottomRun.EndWalk() == 1 && bottomRun.GetReleased().Frames[0] == 1);
+        CHECK(bottomRun.EndWalk() == 0);
+    }
+
+    void TestAnnotationFrameCache()
+    {
+        AnnotationFrameCache<int> cache;
+        int frame = 0;
+        cache.BeginWalk();
+        CHECK(!cache.Lookup(0x1000, 2, &frame));
+        cache.Add(0x1000, 2, 7);
+        cache.Add(0x2000, 1, 8);
+
+        CHECK(cache.Lookup(0x1000, 2, &frame) && frame == 7);
+        // The frame above the same frame base shows another rule
+        CHECK(!cache.Lookup(0x1000, 3, &frame));
+
+        // Only the first frame is used in the second walk, so the other one is dropped when the
+        // third starts
+        cache.BeginWalk();
+        CHECK(cache.Lookup(0x1000, 2, &frame));
+        cache.BeginWalk();
+        CHECK(cache.GetCount() == 1);
+        CHECK(!cache.Lookup(0x2000, 1, &frame));
+        frame = 0;
+        CHECK(cache.Lookup(0x1000, 2, &frame) && frame == 7);
+
+        // Adding a frame again replaces it
+        cache.Add(0x1000, 3, 9);
+        CHECK(!cache.Lookup(0x1000, 2, &frame));
+        CHECK(cache.Lookup(0x1000, 3, &frame) && frame == 9);
+
+        uint32_t walkHits, walkMisses;
+        uint64_t totalHits, totalMisses;
+        cache.GetStatistics(&walkHits, &walkMisses, &totalHits, &totalMisses);
+        CHECK(walkHits == 2 && walkMisses == 2);
+        CHECK(totalHits == 4 && totalMisses == 4);
+    }
+}
+
+int main()
+{
+    TestAnnotationRules();
+    TestTraceRoundTrip();
+    TestTraceVersions();
+    TestRecursionCollapser();
+    TestStackWalkFilter();
+    TestAnnotationFrameCache();
+
+    return ReportChecks();
+}
@@ -0,0 +1,782 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+
+// StackFilterReplay feeds stack walks through the HelloWorld filter without a debugger, and
+// reports how long each call to the filter took and how much it allocated. The walks are either
+// synthetic stacks of 10 to 100000 frames, or the walks of a trace recorded with
+// HELLOWORLD_STACK_TRACE (see StackWalkTrace.h).
+//
+// CHelloWorldService needs Concord, so ReplayFilter::FilterNextFrame below mirrors it against
+// stand-ins for the Concord objects it uses: ReplayStackContext for DkmStackContext (the thread,
+// the filter options and the data item of the walk), ReplayThread for the annotation cache data
+// item of a DkmThread, and reference counted ReplayFrames for DkmStackWalkFrame. What to do with
+// each frame is decided by the same code as in the filter, StackWalkFilter, so the mirror only
+// creates the frames it decides on and reuses annotation frames through AnnotationFrameCache. Traces don't have module names, so each 16 MB of address space stands in
+// for a module, named after one of the modules in ModuleNames.
+//
+// Usage: StackFilterReplay [options]
+// Options:
+//   -trace <file>       replay the walks of a trace instead of the synthetic stacks
+//   -writetrace <file>  write the synthetic walks to a trace, which -trace can replay
+//   -walks N            walks of each synthetic stack (default 10). The first walk of a stack
+//                       creates its annotation frames, and the top frame moves in each of the
+//                       others, like stepping does.
+//   -showexternal       walk the synthetic stacks with DkmFilterOptionFlags::ShowNonUserCode
+//   -baseline           replay through the filter of the original sample instead, which only
+//                       adds '[Hello World]', to compare what each frame costs with it
+//   -rules <file>       the annotation rules (default: the HelloWorld.rules next to the filter)
+
+#include "AnnotationFrameCache.h"
+#include "StackWalkFilter.h"
+#include "StackWalkTrace.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <wchar.h>
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <memory>
+#include <new>
+#include <string>
+#include <unordered_map>
+
+namespace
+{
+    // Allocations made through operator new, which the filter's allocations are counted from
+    uint64_t g_allocations = 0;
+    uint64_t g_allocatedBytes = 0;
+}
+
+void* operator new(size_t size)
+{
+    g_allocations++;
+    g_allocatedBytes += size;
+    void* pMemory = malloc((size != 0) ? size : 1);
+    if (pMemory == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+    return pMemory;
+}
+
+void operator delete(void* pMemory) noexcept
+{
+    free(pMemory);
+}
+
+void operator delete(void* pMemory, size_t) noexcept
+{
+    free(pMemory);
+}
+
+namespace
+{
+    // DkmFilterOptionFlags::ShowNonUserCode
+    const uint32_t ShowNonUserCode = 0x1;
+
+    // Each 16 MB of address space stands in for a module
+    const int ModuleShift = 24;
+    const wchar_t* const ModuleNames[8] =
+    {
+        L"app.exe", L"ntdll.dll", L"KernelBase.dll", L"kernel32.dll",
+        L"ucrtbase.dll", L"vcruntime140.dll", L"render.dll", L"parser.dll",
+    };
+
+    // Stands in for a DkmModuleInstance
+    struct ReplayModule
+    {
+        std::wstring Name;
+    };
+
+    // Stands in for DkmStackWalkFrame. Frames are reference counted like Concord's, so holding
+    // one costs what holding a CComPtr<DkmStackWalkFrame> does.
+    struct ReplayFrame
+    {
+        // 0 for annotated frames, which have no instruction address
+        uint64_t InstructionPointer;
+        uint64_t FrameBase;
+        uint32_t Flags;
+        // The module of the instruction address (DkmInstructionAddress::ModuleInstance), set by
+        // ReplayFilter::AddModules. Null for annotated frames.
+        const ReplayModule* pModule = nullptr;
+        // The text of an annotated frame, which stands in for DkmString
+        std::shared_ptr<const std::wstring> pDescription;
+    };
+    typedef std::shared_ptr<ReplayFrame> FramePtr;
+
+    typedef StackWalkFilter<FramePtr> FrameFilter;
+
+    // Stands in for a DkmThread, with the data item which holds the thread's annotation cache
+    struct ReplayThread
+    {
+        AnnotationFrameCache<FramePtr> Cache;
+    };
+
+    // Stands in for CHelloWorldDataItem
+    struct ReplayDataItem
+    {
+        FrameFilter Filter;
+        AnnotationFrameCache<FramePtr>* pAnnotationCache;
+
+        ReplayDataItem() :
+            pAnnotationCache(nullptr)
+        {
+        }
+    };
+
+    // Stands in for the CHelloWorldDataItem of the original sample, which only had its State
+    struct BaselineDataItem
+    {
+        bool HelloWorldFrameAdded;
+
+        BaselineDataItem() :
+            HelloWorldFrameAdded(false)
+        {
+        }
+    };
+
+    // Stands in for DkmStackContext: one walk of a thread. Only one of the data items is used,
+    // depending on the filter.
+    struct ReplayStackContext
+    {
+        ReplayThread* pThread;
+        uint32_t FilterOptions;
+        std::unique_ptr<ReplayDataItem> pDataItem;
+        std::unique_ptr<BaselineDataItem> pBaselineDataItem;
+    };
+
+    // Mirrors CHelloWorldService
+    class ReplayFilter
+    {
+    public:
+        ReplayFilter(const std::vector<std::wstring>& patterns, const std::vector<std::wstring>& annotations)
+        {
+            for (const std::wstring& annotation : annotations)
+            {
+                m_annotations.push_back(std::make_shared<const std::wstring>(annotation));
+            }
+            m_matcher.Build(patterns);
+        }
+
+        // Makes sure there is a module for every frame, and sets the module of the frames.
+        // Modules are loaded before the stack is walked, so this isn't part of what is measured.
+        void AddModules(const std::vector<FramePtr>& frames)
+        {
+            for (const FramePtr& pFrame : frames)
+            {
+                if (pFrame->InstructionPointer == 0)
+                {
+                    continue;
+                }
+
+                uint64_t key = pFrame->InstructionPointer >> ModuleShift;
+                auto it = m_modules.find(key);
+                if (it == m_modules.end())
+                {
+                    ReplayModule module = { ModuleNames[key % 8] };
+                    it = m_modules.emplace(key, module).first;
+                }
+                pFrame->pModule = &it->second;
+            }
+        }
+
+        ReplayThread* GetThread(uint32_t threadId)
+        {
+            std::unique_ptr<ReplayThread>& pThread = m_threads[threadId];
+            if (!pThread)
+            {
+                pThread.reset(new ReplayThread());
+            }
+            return pThread.get();
+        }
+
+        // Mirrors CHelloWorldService::FilterNextFrame. 'pResult' is empty on entry, and the
+        // caller frees it, like the dispatcher frees the DkmArray.
+        void FilterNextFrame(ReplayStackContext* pStackContext, const FramePtr& pInput, std::vector<FramePtr>* pResult)
+        {
+            if (!pInput)
+            {
+                ReplayDataItem* pDataItem = pStackContext->pDataItem.get();
+                if (pDataItem == nullptr)
+                {
+                    return;
+                }
+
+                uint32_t releasedCount = pDataItem->Filter.EndWalk();
+                if (releasedCount == 0)
+                {
+                    return;
+                }
+
+                pResult->reserve(releasedCount);
+                AddReleasedFrames(pDataItem->Filter.GetReleased(), pResult);
+                return;
+            }
+
+            ReplayDataItem* pDataItem = GetDataItem(pStackContext);
+
+            const ReplayModule* pModule = m_annotations.empty() ? nullptr : pInput->pModule;
+            FrameFilter::Decision decision;
+            bool collapseRecursion = ((pStackContext->FilterOptions & ShowNonUserCode) == 0);
+            if (!pDataItem->Filter.FilterFrame(
+                pInput->InstructionPointer,
+                pInput->FrameBase,
+                pInput,
+                pModule,
+                collapseRecursion,
+                [this, pModule]() { return GetRule(pModule); },
+                &decision))
+            {
+                return;
+            }
+
+            if (decision.PassThrough())
+            {
+                pResult->reserve(1);
+                pResult->push_back(pInput);
+                return;
+            }
+
+            bool addAnnotation = (decision.AnnotationRule != AnnotationMatcher::NoMatch);
+            uint32_t count = 1 + (decision.AddHelloWorld ? 1 : 0) + decision.ReleasedCount + (addAnnotation ? 1 : 0);
+            pResult->reserve(count);
+            if (decision.AddHelloWorld)
+            {
+                pResult->push_back(CreateAnnotationFrame(pInput->FrameBase, std::make_shared<const std::wstring>(L"[Hello World]")));
+            }
+
+            if (decision.ReleasedCount != 0)
+            {
+                AddReleasedFrames(pDataItem->Filter.GetReleased(), pResult);
+            }
+
+            if (addAnnotation)
+            {
+                AnnotationFrameCache<FramePtr>* pAnnotationCache = pDataItem->pAnnotationCache;
+                FramePtr pAnnotationFrame;
+                if (!pAnnotationCache->Lookup(pInput->FrameBase, decision.AnnotationRule, &pAnnotationFrame))
+                {
+                    pAnnotationFrame = CreateAnnotationFrame(pInput->FrameBase, m_annotations[decision.AnnotationRule]);
+                    pAnnotationCache->Add(pInput->FrameBase, decision.AnnotationRule, pAnnotationFrame);
+                }
+
+                pResult->push_back(std::move(pAnnotationFrame));
+            }
+
+            pResult->push_back(pInput);
+            pDataItem->Filter.OnFramesAdded();
+        }
+
+    private:
+        // Mirrors CHelloWorldDataItem::GetInstance, which starts a walk of the thread's
+        // annotation cache
+        static ReplayDataItem* GetDataItem(ReplayStackContext* pStackContext)
+        {
+            if (!pStackContext->pDataItem)
+            {
+                pStackContext->pDataItem.reset(new ReplayDataItem());
+                pStackContext->pDataItem->pAnnotationCache = &pStackContext->pThread->Cache;
+                pStackContext->pThread->Cache.BeginWalk();
+            }
+            return pStackContext->pDataItem.get();
+        }
+
+        // Mirrors CModuleAnnotationDataItem::GetRule. m_moduleRules stands in for the data items
+        // of the modules, which DkmModuleInstance::GetDataItem looks up.
+        int GetRule(const ReplayModule* pModule)
+        {
+            auto it = m_moduleRules.find(pModule);
+            if (it == m_moduleRules.end())
+            {
+                int rule = m_matcher.Match(pModule->Name.c_str(), pModule->Name.size());
+                it = m_moduleRules.emplace(pModule, rule).first;
+            }
+            return it->second;
+        }
+
+        static FramePtr CreateAnnotationFrame(uint64_t frameBase, const std::shared_ptr<const std::wstring>& pDescription)
+        {
+            FramePtr pFrame = std::make_shared<ReplayFrame>();
+            pFrame->InstructionPointer = 0;
+            pFrame->FrameBase = frameBase;
+            pFrame->Flags = 0;
+            pFrame->pDescription = pDescription;
+            return pFrame;
+        }
+
+        static void AddReleasedFrames(const FrameFilter::Released& released, std::vector<FramePtr>* pResult)
+        {
+            if (released.CollapsedCount != 0)
+            {
+                wchar_t text[64];
+                swprintf(text, 64, L"[%u recursive frames collapsed]", released.CollapsedCount);
+                pResult->push_back(CreateAnnotationFrame(released.CollapsedFrameBase, std::make_shared<const std::wstring>(text)));
+            }
+
+            pResult->insert(pResult->end(), released.Frames.begin(), released.Frames.end());
+        }
+
+        AnnotationMatcher m_matcher;
+        std::vector<std::shared_ptr<const std::wstring>> m_annotations;
+        std::unordered_map<uint64_t, ReplayModule> m_modules;
+        std::unordered_map<const ReplayModule*, int> m_moduleRules;
+        std::map<uint32_t, std::unique_ptr<ReplayThread>> m_threads;
+    };
+
+    // Mirrors the FilterNextFrame of the original sample, which puts '[Hello World]' above the
+    // top frame and returns every other frame in a one element array
+    class BaselineFilter
+    {
+    public:
+        void AddModules(const std::vector<FramePtr>&)
+        {
+        }
+
+        ReplayThread* GetThread(uint32_t)
+        {
+            return nullptr;
+        }
+
+        void FilterNextFrame(ReplayStackContext* pStackContext, const FramePtr& pInput, std::vector<FramePtr>* pResult)
+        {
+            if (!pInput)
+            {
+                return;
+            }
+
+            if (!pStackContext->pBaselineDataItem)
+            {
+                pStackContext->pBaselineDataItem.reset(new BaselineDataItem());
+            }
+            BaselineDataItem* pDataItem = pStackContext->pBaselineDataItem.get();
+
+            if (pDataItem->HelloWorldFrameAdded)
+            {
+                pResult->reserve(1);
+                pResult->push_back(pInput);
+                return;
+            }
+
+            pResult->reserve(2);
+            FramePtr pFrame = std::make_shared<ReplayFrame>();
+            pFrame->InstructionPointer = 0;
+            pFrame->FrameBase = pInput->FrameBase;
+            pFrame->Flags = 0;
+            pFrame->pDescription = std::make_shared<const std::wstring>(L"[Hello World]");
+            pResult->push_back(pFrame);
+            pResult->push_back(pInput);
+            pDataItem->HelloWorldFrameAdded = true;
+        }
+    };
+
+    struct ReplayWalk
+    {
+        uint32_t ThreadId;
+        uint32_t FilterOptions;
+        std::vector<FramePtr> Frames;
+    };
+
+    // What a set of walks cost, per call to the filter. The call for the end of the stack counts
+    // as a call too.
+    struct ReplayStatistics
+    {
+        std::vector<double> CallNanoseconds;
+        // The calls which returned the input frame unchanged
+        std::vector<double> PassThroughNanoseconds;
+        uint64_t Allocations;
+        uint64_t AllocatedBytes;
+        uint64_t FramesOut;
+        double FirstWalkMicroseconds;
+        double LaterWalkMicroseconds;
+
+        ReplayStatistics() :
+            Allocations(0),
+            AllocatedBytes(0),
+            FramesOut(0),
+            FirstWalkMicroseconds(0),
+            LaterWalkMicroseconds(0)
+        {
+        }
+    };
+
+    template <class TFilter>
+    void ReplayWalks(TFilter& filter, const std::vector<ReplayWalk>& walks, ReplayStatistics* pStatistics)
+    {
+        typedef std::chrono::steady_clock Clock;
+
+        for (size_t i = 0; i < walks.size(); i++)
+        {
+            const ReplayWalk& walk = walks[i];
+            ReplayStackContext context;
+            context.pThread = filter.GetThread(walk.ThreadId);
+            context.FilterOptions = walk.FilterOptions;
+
+            double walkNanoseconds = 0;
+            for (size_t frame = 0; frame <= walk.Frames.size(); frame++)
+            {
+                static const FramePtr EndOfStack;
+                const FramePtr& pInput = (frame < walk.Frames.size()) ? walk.Frames[frame] : EndOfStack;
+
+                std::vector<FramePtr> result;
+                uint64_t allocations = g_allocations;
+                uint64_t allocatedBytes = g_allocatedBytes;
+                Clock::time_point start = Clock::now();
+                filter.FilterNextFrame(&context, pInput, &result);
+                double nanoseconds = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+
+                pStatistics->Allocations += g_allocations - allocations;
+                pStatistics->AllocatedBytes += g_allocatedBytes - allocatedBytes;
+                pStatistics->CallNanoseconds.push_back(nanoseconds);
+                if (result.size() == 1 && result[0] == pInput)
+                {
+                    pStatistics->PassThroughNanoseconds.push_back(nanoseconds);
+                }
+                pStatistics->FramesOut += result.size();
+                walkNanoseconds += nanoseconds;
+            }
+
+            if (i == 0)
+            {
+                pStatistics->FirstWalkMicroseconds = walkNanoseconds / 1000;
+            }
+            else
+            {
+                pStatistics->LaterWalkMicroseconds += walkNanoseconds / 1000 / (walks.size() - 1);
+            }
+        }
+    }
+
+    // Replays 'walks' through a new filter: the one of the original sample if 'baseline' is set,
+    // and otherwise the HelloWorld filter with the given rules
+    void ReplayWalks(
+        bool baseline,
+        const std::vector<std::wstring>& patterns,
+        const std::vector<std::wstring>& annotations,
+        const std::vector<ReplayWalk>& walks,
+        ReplayStatistics* pStatistics)
+    {
+        if (baseline)
+        {
+            BaselineFilter filter;
+            ReplayWalks(filter, walks, pStatistics);
+            return;
+        }
+
+        ReplayFilter filter(patterns, annotations);
+        for (const ReplayWalk& walk : walks)
+        {
+            filter.AddModules(walk.Frames);
+        }
+        ReplayWalks(filter, walks, pStatistics);
+    }
+
+    double Percentile(const std::vector<double>& sorted, double fraction)
+    {
+        if (sorted.empty())
+        {
+            return 0;
+        }
+        return sorted[std::min(sorted.size() - 1, (size_t)(fraction * sorted.size()))];
+    }
+
+    void PrintStatistics(const char* name, size_t walkCount, ReplayStatistics* pStatistics)
+    {
+        std::vector<double>& sorted = pStatistics->CallNanoseconds;
+        std::sort(sorted.begin(), sorted.end());
+        std::vector<double>& passThrough = pStatistics->PassThroughNanoseconds;
+        std::sort(passThrough.begin(), passThrough.end());
+        double calls = sorted.empty() ? 1.0 : (double)sorted.size();
+
+        printf("%-8s %6zu %9zu %7.0f %7.0f %7.0f %8.0f %7.0f %7.2f %8.1f %9.0f %9.0f %10llu\n",
+            name, walkCount, sorted.size(),
+            Percentile(sorted, 0.5), Percentile(sorted, 0.9), Percentile(sorted, 0.99), sorted.empty() ? 0.0 : sorted.back(),
+            Percentile(passThrough, 0.5),
+            pStatistics->Allocations / calls, pStatistics->AllocatedBytes / calls,
+            pStatistics->FirstWalkMicroseconds, pStatistics->LaterWalkMicroseconds,
+            (unsigned long long)pStatistics->FramesOut);
+    }
+
+    void PrintStatisticsHeader()
+    {
+        printf("%-8s %6s %9s %7s %7s %7s %8s %7s %7s %8s %9s %9s %10s\n",
+            "Frames", "Walks", "Calls", "p50 ns", "p90 ns", "p99 ns", "max ns", "pass ns", "allocs", "bytes", "first us", "later us", "frames out");
+    }
+
+    // A stack of 'frameCount' frames, from the top, as the walk numbered 'walk' of it sees it.
+    // Most frames are in app.exe, every seventh calls into ucrtbase.dll, and the bottom of the
+    // stack is the thread start in kernel32.dll and ntdll.dll. Stacks of at least 100 frames
+    // recurse through parser.dll with a period of 3 frames in their middle half.
+    std::vector<FramePtr> CreateSyntheticStack(uint32_t frameCount, uint32_t walk)
+    {
+        const uint64_t ModuleBase = 0x7ff000ull << ModuleShift;
+        const uint64_t StackBase = 0x000000e8f5000000ull;
+
+        std::vector<FramePtr> frames;
+        for (uint32_t i = 0; i < frameCount; i++)
+        {
+            uint64_t module;
+            uint64_t offset;
+            if (i == frameCount - 1)
+            {
+                module = 1;
+                offset = 0x1000;
+            }
+            else if (i == frameCount - 2)
+            {
+                module = 3;
+                offset = 0x2000;
+            }
+            else if (frameCount >= 100 && i >= frameCount / 4 && i < frameCount * 3 / 4)
+            {
+                module = 7;
+                offset = 0x3000 + (i % 3) * 0x40;
+            }
+            else if (i % 7 == 6)
+            {
+                module = 4;
+                offset = 0x4000 + i * 0x10;
+            }
+            else
+            {
+                module = 0;
+                offset = 0x100000 + i * 0x10;
+            }
+
+            // Stepping moves the top frame
+            if (i == 0)
+            {
+                offset += walk * 4;
+            }
+
+            FramePtr pFrame = std::make_shared<ReplayFrame>();
+            pFrame->InstructionPointer = ModuleBase + (module << ModuleShift) + offset;
+            pFrame->FrameBase = StackBase + (uint64_t)i * 0x40;
+            pFrame->Flags = 0;
+            frames.push_back(pFrame);
+        }
+        return frames;
+    }
+
+    bool ReadFile(const char* path, std::vector<uint8_t>* pBytes)
+    {
+        std::ifstream file(path, std::ios::binary);
+        pBytes->assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+        return !file.bad() && file.is_open();
+    }
+
+    bool LoadRules(const char* path, std::vector<std::wstring>* pPatterns, std::vector<std::wstring>* pAnnotations)
+    {
+        std::vector<uint8_t> bytes;
+        if (!ReadFile(path, &bytes))
+        {
+            return false;
+        }
+
+        // The rules which ship with the filter are ASCII, possibly with a UTF-8 byte order mark
+        size_t offset = (bytes.size() >= 3 && bytes[0] == 0xEF && bytes[1] == 0xBB && bytes[2] == 0xBF) ? 3 : 0;
+        std::wstring text(bytes.begin() + offset, bytes.end());
+        ParseAnnotationRules(text, pPatterns, pAnnotations);
+        return true;
+    }
+
+    bool ReadTrace(const char* path, std::vector<ReplayWalk>* pWalks)
+    {
+        std::vector<uint8_t> trace;
+        if (!ReadFile(path, &trace))
+        {
+            return false;
+        }
+
+        StackWalkTraceDecoder decoder(trace.data(), trace.size());
+        if (!decoder.ReadHeader())
+        {
+            return false;
+        }
+
+        ReplayWalk walk;
+        std::vector<StackWalkTraceFrame> frames;
+        while (decoder.ReadWalk(&walk.ThreadId, &walk.FilterOptions, &frames))
+        {
+            walk.Frames.clear();
+            for (const StackWalkTraceFrame& frame : frames)
+            {
+                FramePtr pFrame = std::make_shared<ReplayFrame>();
+                pFrame->InstructionPointer = frame.InstructionPointer;
+                pFrame->FrameBase = frame.FrameBase;
+                pFrame->Flags = frame.Flags;
+                walk.Frames.push_back(pFrame);
+            }
+            pWalks->push_back(walk);
+        }
+        return true;
+    }
+
+    bool WriteTrace(const char* path, const std::vector<std::vector<ReplayWalk>>& walkSets)
+    {
+        StackWalkTraceEncoder encoder;
+        encoder.AddHeader();
+        for (const std::vector<ReplayWalk>& walks : walkSets)
+        {
+            for (const ReplayWalk& walk : walks)
+            {
+                encoder.BeginWalk(walk.ThreadId, walk.FilterOptions);
+                for (const FramePtr& pFrame : walk.Frames)
+                {
+                    StackWalkTraceFrame frame;
+                    frame.InstructionPointer = pFrame->InstructionPointer;
+                    frame.FrameBase = pFrame->FrameBase;
+                    frame.Flags = pFrame->Flags;
+                    encoder.AddFrame(frame);
+                }
+                encoder.EndWalk();
+            }
+        }
+
+        FILE* pFile = fopen(path, "wb");
+        if (pFile == nullptr)
+        {
+            return false;
+        }
+        bool written = fwrite(encoder.Buffer().data(), 1, encoder.Buffer().size(), pFile) == encoder.Buffer().size();
+        return (fclose(pFile) == 0) && written;
+    }
+
+    struct Options
+    {
+        const char* TracePath;
+        const char* WriteTracePath;
+        const char* RulesPath;
+        uint32_t Walks;
+        uint32_t FilterOptions;
+        bool Baseline;
+    };
+
+    bool ParseOptions(int argc, char** argv, Options* pOptions)
+    {
+        pOptions->TracePath = nullptr;
+        pOptions->WriteTracePath = nullptr;
+        pOptions->RulesPath = HELLOWORLD_RULES_PATH;
+        pOptions->Walks = 10;
+        pOptions->FilterOptions = 0;
+        pOptions->Baseline = false;
+        for (int i = 1; i < argc; i++)
+        {
+            std::string option(argv[i]);
+            bool hasValue = i + 1 < argc;
+            if (option == "-trace" && hasValue)
+            {
+                pOptions->TracePath = argv[++i];
+            }
+            else if (option == "-writetrace" && hasValue)
+            {
+                pOptions->WriteTracePath = argv[++i];
+            }
+            else if (option == "-rules" && hasValue)
+            {
+                pOptions->RulesPath = argv[++i];
+            }
+            else if (option == "-walks" && hasValue)
+            {
+                pOptions->Walks = (uint32_t)atoi(argv[++i]);
+            }
+            else if (option == "-showexternal")
+            {
+                pOptions->FilterOptions |= ShowNonUserCode;
+            }
+            else if (option == "-baseline")
+            {
+                pOptions->Baseline = true;
+            }
+            else
+            {
+                return false;
+            }
+        }
+
+        return pOptions->Walks != 0 && (pOptions->TracePath == nullptr || pOptions->WriteTracePath == nullptr);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    Options options;
+    if (!ParseOptions(argc, argv, &options))
+    {
+        fprintf(stderr, "Usage: StackFilterReplay [-trace <file> | -writetrace <file>] [-walks N] [-showexternal] [-baseline] [-rules <file>]\n");
+        return 2;
+    }
+
+    std::vector<std::wstring> patterns;
+    std::vector<std::wstring> annotations;
+    if (!LoadRules(options.RulesPath, &patterns, &annotations))
+    {
+        fprintf(stderr, "Can't read the rules in %s\n", options.RulesPath);
+        return 1;
+    }
+    printf("Rules: %zu from %s\n", patterns.size(), options.RulesPath);
+    if (options.Baseline)
+    {
+        printf("Baseline: the filter of the original sample, which ignores the rules\n");
+    }
+    printf("Per call to the filter: latency percentiles, median of the calls which return the frame unchanged,\n");
+    printf("allocations and bytes allocated. Per walk: time in the filter.\n");
+
+    if (options.TracePath != nullptr)
+    {
+        std::vector<ReplayWalk> walks;
+        if (!ReadTrace(options.TracePath, &walks))
+        {
+            fprintf(stderr, "%s is not a stack walk trace\n", options.TracePath);
+            return 1;
+        }
+
+        size_t frameCount = 0;
+        for (const ReplayWalk& walk : walks)
+        {
+            frameCount += walk.Frames.size();
+        }
+        printf("Trace: %zu walks, %zu frames\n", walks.size(), frameCount);
+
+        ReplayStatistics statistics;
+        ReplayWalks(options.Baseline, patterns, annotations, walks, &statistics);
+        PrintStatisticsHeader();
+        PrintStatistics("trace", walks.size(), &statistics);
+        printf("Total frames out: %llu\n", (unsigned long long)statistics.FramesOut);
+        return 0;
+    }
+
+    // Every stack size is walked on its own thread, as in a process with threads that deep
+    const uint32_t FrameCounts[] = { 10, 100, 1000, 10000, 100000 };
+    std::vector<std::vector<ReplayWalk>> walkSets;
+    for (uint32_t frameCount : FrameCounts)
+    {
+        std::vector<ReplayWalk> walks(options.Walks);
+        for (uint32_t walk = 0; walk < options.Walks; walk++)
+        {
+            walks[walk].ThreadId = frameCount;
+            walks[walk].FilterOptions = options.FilterOptions;
+            walks[walk].Frames = CreateSyntheticStack(frameCount, walk);
+        }
+        walkSets.push_back(std::move(walks));
+    }
+
+    if (options.WriteTracePath != nullptr && !WriteTrace(options.WriteTracePath, walkSets))
+    {
+        fprintf(stderr, "Can't write %s\n", options.WriteTracePath);
+        return 1;
+    }
+
+    PrintStatisticsHeader();
+    uint64_t framesOut = 0;
+    for (const std::vector<ReplayWalk>& walks : walkSets)
+    {
+        ReplayStatistics statistics;
+        ReplayWalks(options.Baseline, patterns, annotations, walks, &statistics);
+        PrintStatistics(std::to_string(walks[0].Frames.size()).c_str(), walks.size(), &statistics);
+        framesOut += statistics.FramesOut;
+    }
+    printf("Total frames out: %llu\n", (unsigned long long)framesOut);
+    return 0;
+}
@@ -0,0 +1,36 @@
+// Copyright (c) Microsoft. All rights reserved.
+// Licensed under the MIT license. See LICENSE file in the project root for full license information.
+#pragma once
+
+// A check macro for the tests in this directory which also works in release builds. Only the
+// first few failures are printed.
+
+#include <stdio.h>
+
+static int g_failures = 0;
+
+#define CHECK(condition) \
+    do \
+    { \
+        if (!(condition)) \
+        { \
+            if (g_failures < 20) \
+            { \
+                fprintf(stderr, "%s(%d): CHECK(%s) failed\n", __FILE__, __LINE__, #condition); \
+            } \
+            g_failures++; \
+        } \
+    } while (0)
+
+// Prints the result of the checks and returns the exit code of the test
+inline int ReportChecks()
+{
+    if (g_failures != 0)
+    {
+        fprintf(stderr, "%d checks failed\n", g_failures);
+        return 1;
+    }
+
+    printf("All checks passed\n");
+    return 0;
+}